@@ -0,0 +1,165 @@
+// alloctrack.h : counts heap allocations, per thread and for the whole process.
+//
+// Build with RENDERLITE_TRACK_ALLOCS defined to replace the global operator new / delete
+// with versions that count every allocation and its size before calling malloc, the
+// over-aligned (std::align_val_t) forms included, so nothing bypasses the count. The
+// replacements are ordinary (non-inline) definitions, so define it only in the
+// translation unit that holds main, as every renderlite program is a single one.
+//
+// Without it the counters exist but stay at 0, and allocTrackEnabled() is false.
+//
+// With RENDERLITE_PROFILE as well, every PROFILE_SCOPE records how many allocations
+// (and bytes) the calling thread made inside it, so allocations show up per stage and
+// per frame next to the timings (see Profiler::LastFrameAllocs).
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+struct allocCount
+{
+    uint64_t nAllocs = 0;
+    uint64_t nBytes = 0;
+};
+
+// the calling thread's running totals
+inline allocCount& allocThreadCount()
+{
+    thread_local allocCount count;
+    return count;
+}
+
+// every thread's allocations since the start
+inline std::atomic<uint64_t>& allocProcessCount()
+{
+    static std::atomic<uint64_t> nAllocs{ 0 };
+    return nAllocs;
+}
+
+#ifdef RENDERLITE_TRACK_ALLOCS
+
+inline bool allocTrackEnabled()
+{
+    return true;
+}
+
+inline void allocCounted(size_t n)
+{
+    allocCount& count = allocThreadCount();
+    count.nAllocs++;
+    count.nBytes += n;
+    allocProcessCount().fetch_add(1, std::memory_order_relaxed);
+}
+
+inline void* allocTracked(size_t n)
+{
+    allocCounted(n);
+    return malloc(n ? n : 1);
+}
+
+// over-aligned types (alignas above the default new alignment) come through here
+inline void* allocTrackedAligned(size_t n, std::align_val_t al)
+{
+    allocCounted(n);
+    size_t nAlign = (size_t)al;
+#ifdef _WIN32
+    return _aligned_malloc(n ? n : 1, nAlign);
+#else
+    void* p = nullptr;
+    if (posix_memalign(&p, nAlign < sizeof(void*) ? sizeof(void*) : nAlign, n ? n : 1) != 0)
+        return nullptr;
+    return p;
+#endif
+}
+
+inline void allocFreeAligned(void* p)
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+void* operator new(size_t n)
+{
+    if (void* p = allocTracked(n))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t n)
+{
+    if (void* p = allocTracked(n))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t n, const std::nothrow_t&) noexcept
+{
+    return allocTracked(n);
+}
+
+void* operator new[](size_t n, const std::nothrow_t&) noexcept
+{
+    return allocTracked(n);
+}
+
+void* operator new(size_t n, std::align_val_t al)
+{
+    if (void* p = allocTrackedAligned(n, al))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t n, std::align_val_t al)
+{
+    if (void* p = allocTrackedAligned(n, al))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t n, std::align_val_t al, const std::nothrow_t&) noexcept
+{
+    return allocTrackedAligned(n, al);
+}
+
+void* operator new[](size_t n, std::align_val_t al, const std::nothrow_t&) noexcept
+{
+    return allocTrackedAligned(n, al);
+}
+
+// GCC sees these free() what operator new returned once they are inlined into their
+// callers, and warns of a mismatch; they are the replacements, so the pairs do match
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { allocFreeAligned(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { allocFreeAligned(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { allocFreeAligned(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { allocFreeAligned(p); }
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#else
+
+inline bool allocTrackEnabled()
+{
+    return false;
+}
+
+#endif
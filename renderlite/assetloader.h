@@ -0,0 +1,274 @@
+// assetloader.h : OBJ assets read and prepared on a worker thread while frames keep drawing.
+//
+// Load() queues a file and hands back an assetTicket at once. The loader thread parses
+// it (mesh::loadObj), builds its chain of levels of detail (lodChain) and measures the
+// bounds of each level, then publishes the finished asset by exchanging a pointer into
+// a one-slot mailbox. With bReorder (see Start) each level also has its triangles and
+// vertices put in cache-friendly order (vcacheOptimize), and with bPack is packed
+// (mesh::Pack). The game thread collects it with Take() at the top of a frame,
+// which is one atomic exchange, and null on every frame with nothing new, so a frame
+// waiting on a load costs nothing more than any other.
+//
+// The renderer puts the new geometry into the scene in place of the old between two
+// frames (Scene::ReplaceMesh), so no frame draws a mix of the two, and gives the old
+// geometry back through Retire(): no frame can use it once the swap is made, and the
+// loader thread frees it, as handing a few hundred megabytes back to the system is slow
+// enough to be a hitch of its own. A result still untaken when a newer one is published
+// is superseded and freed by the loader too, and of several loads queued before the
+// thread gets to them only the newest is read.
+//
+// The thread runs below normal scheduling priority (nLoaderNice, see Start), so where
+// there are fewer cores than busy threads it takes the time frames leave rather than
+// time from them. Stop() waits for a load already under way to finish.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bvh.h"
+#include "lod.h"
+#include "mesh.h"
+#include "vcache.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+typedef int assetTicket;
+
+struct loadedAsset
+{
+    assetTicket nTicket = 0;
+    std::string sPath;
+    // false if the file could not be opened; nothing else is set then
+    bool bOk = false;
+    // the mesh as levels[0] and its simplified versions after it, as lodChain makes them,
+    // and the bounds of each, so the game thread need not walk their triangles
+    std::vector<lodLevel> levels;
+    std::vector<aabb> vecBounds;
+    // time spent reading the file, building the levels and reordering (and packing) them
+    double fParseMs = 0.0;
+    double fLodMs = 0.0;
+    double fReorderMs = 0.0;
+};
+
+struct loaderStats
+{
+    uint64_t nLoaded = 0;
+    uint64_t nFailed = 0;
+    // finished but replaced by a newer load before being taken, or never started
+    uint64_t nSuperseded = 0;
+    // meshes given back through Retire and freed
+    uint64_t nRetired = 0;
+};
+
+class AssetLoader
+{
+public:
+    ~AssetLoader()
+    {
+        Stop();
+    }
+
+    // start the loader thread; every asset gets up to nLodLevels levels of detail, each
+    // reordered for the vertex cache if bReorder and packed if bPack, and the thread runs
+    // nLoaderNice steps below normal priority (0 = normal)
+    void Start(int nLodLevels, int nLoaderNice = 10, bool bReorder = true, bool bPack = false)
+    {
+        Stop();
+        nLevels = nLodLevels;
+        nNice = nLoaderNice;
+        bOrder = bReorder;
+        bPacked = bPack;
+        stats = loaderStats();
+        bActive = true;
+        worker = std::thread(&AssetLoader::LoadThread, this);
+    }
+
+    // stop the thread once the load under way, if any, is done; queued loads are dropped
+    void Stop()
+    {
+        if (!bActive)
+            return;
+        {
+            std::unique_lock<std::mutex> lm(mux);
+            bActive = false;
+        }
+        cvWork.notify_one();
+        worker.join();
+        delete pReady.exchange(nullptr);
+        vecQueue.clear();
+        vecRetired.clear();
+    }
+
+    bool Active() const { return bActive; }
+
+    assetTicket Load(const std::string& sPath)
+    {
+        std::unique_lock<std::mutex> lm(mux);
+        vecQueue.push_back({ ++nTicket, sPath });
+        cvWork.notify_one();
+        return nTicket;
+    }
+
+    // the newest load finished since the last call, or null; on the game thread, between
+    // frames
+    std::unique_ptr<loadedAsset> Take()
+    {
+        if (pReady.load(std::memory_order_relaxed) == nullptr)
+            return nullptr;
+        return std::unique_ptr<loadedAsset>(pReady.exchange(nullptr, std::memory_order_acquire));
+    }
+
+    // block until every load queued so far is finished, then Take()
+    std::unique_ptr<loadedAsset> Wait()
+    {
+        {
+            std::unique_lock<std::mutex> lm(mux);
+            cvDone.wait(lm, [&] { return nFinished >= nTicket || !bActive; });
+        }
+        return Take();
+    }
+
+    // meshes no frame will draw again, for the loader thread to free
+    void Retire(std::vector<mesh> vecOld)
+    {
+        if (vecOld.empty())
+            return;
+        std::unique_lock<std::mutex> lm(mux);
+        for (mesh& m : vecOld)
+            vecRetired.push_back(std::move(m));
+        cvWork.notify_one();
+    }
+
+    // loads queued or under way
+    int Pending()
+    {
+        std::unique_lock<std::mutex> lm(mux);
+        return nTicket - nFinished;
+    }
+
+    loaderStats Stats()
+    {
+        std::unique_lock<std::mutex> lm(mux);
+        return stats;
+    }
+
+private:
+    struct request
+    {
+        assetTicket nTicket;
+        std::string sPath;
+    };
+
+    int nLevels = 0;
+    int nNice = 0;
+    bool bOrder = true;
+    bool bPacked = false;
+    std::thread worker;
+    std::mutex mux;
+    std::condition_variable cvWork;
+    std::condition_variable cvDone;
+    bool bActive = false;
+    std::vector<request> vecQueue;
+    std::vector<mesh> vecRetired;
+    // last ticket handed out, and the newest one finished (loaded, failed or skipped)
+    assetTicket nTicket = 0;
+    assetTicket nFinished = 0;
+    loaderStats stats;
+    // the mailbox: written by the loader thread, emptied by Take
+    std::atomic<loadedAsset*> pReady{ nullptr };
+
+    void LoadThread()
+    {
+#ifdef _WIN32
+        if (nNice > 0)
+            SetThreadPriority(GetCurrentThread(), nNice >= 10 ? THREAD_PRIORITY_LOWEST : THREAD_PRIORITY_BELOW_NORMAL);
+#else
+        // on Linux a nice value set on a thread's id applies to that thread alone
+        if (nNice > 0)
+            setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), nNice);
+#endif
+        while (true)
+        {
+            request req;
+            {
+                std::unique_lock<std::mutex> lm(mux);
+                cvWork.wait(lm, [&] { return !vecQueue.empty() || !vecRetired.empty() || !bActive; });
+                if (!bActive)
+                    return;
+                if (!vecRetired.empty())
+                {
+                    // freed once the lock is released, as this block ends
+                    std::vector<mesh> vecFree;
+                    vecFree.swap(vecRetired);
+                    stats.nRetired += vecFree.size();
+                    lm.unlock();
+                    continue;
+                }
+                // only the newest request matters, the ones before it would be superseded
+                req = std::move(vecQueue.back());
+                stats.nSuperseded += vecQueue.size() - 1;
+                vecQueue.clear();
+            }
+
+            loadedAsset* p = new loadedAsset();
+            p->nTicket = req.nTicket;
+            p->sPath = req.sPath;
+            auto t0 = std::chrono::steady_clock::now();
+            mesh m;
+            p->bOk = m.loadObj(req.sPath);
+            auto t1 = std::chrono::steady_clock::now();
+            if (p->bOk)
+            {
+                if (nLevels > 0)
+                    p->levels = lodChain(m, nLevels);
+                else
+                    p->levels.push_back({ std::move(m), 0.0f });
+                for (const lodLevel& lv : p->levels)
+                {
+                    aabb box;
+                    lv.m.bounds(box.vMin, box.vMax);
+                    p->vecBounds.push_back(box);
+                }
+            }
+            auto t2 = std::chrono::steady_clock::now();
+            for (lodLevel& lv : p->levels)
+            {
+                if (bOrder)
+                    vcacheOptimize(lv.m);
+                if (bPacked)
+                    lv.m.Pack();
+            }
+            auto t3 = std::chrono::steady_clock::now();
+            p->fParseMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+            p->fLodMs = std::chrono::duration<double, std::milli>(t2 - t1).count();
+            p->fReorderMs = std::chrono::duration<double, std::milli>(t3 - t2).count();
+            // the copy lodChain made is levels[0]; free the original before publishing
+            m = mesh();
+
+            // p belongs to the game thread from the moment it is in the mailbox
+            bool bOk = p->bOk;
+            loadedAsset* pOld = pReady.exchange(p, std::memory_order_acq_rel);
+            delete pOld;
+            {
+                std::unique_lock<std::mutex> lm(mux);
+                stats.nLoaded += bOk;
+                stats.nFailed += !bOk;
+                stats.nSuperseded += pOld != nullptr;
+                nFinished = req.nTicket;
+            }
+            cvDone.notify_all();
+        }
+    }
+};
@@ -0,0 +1,294 @@
+// bvh.h : bounding-volume hierarchy over scene objects, for skipping whole objects off camera.
+//
+// SceneBVH is a binary tree of axis-aligned boxes with one object per leaf, built top
+// down by splitting the objects at the median of their centres along the widest axis.
+// Moving an object refits the tree rather than rebuilding it: Update() sets the leaf's
+// box and marks its ancestors, and the next Refit() recomputes just the marked nodes,
+// children before parents. Refitting loosens the tree as objects drift apart, so once the
+// total surface area of its nodes has doubled since the last build it is built again.
+//
+// Cull() walks the tree against a set of planes (see frustumPlanes) and returns the
+// objects whose boxes are not wholly outside one of them. A node wholly inside a plane
+// drops that plane for its whole subtree, so deep nodes of a tree mostly in view are
+// tested against few planes or none.
+
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "mesh.h"
+
+struct aabb
+{
+    vec3d vMin;
+    vec3d vMax;
+};
+
+// a box with nothing inside it, for a slot that holds no object (Build leaves it out)
+inline aabb aabbEmpty()
+{
+    return { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+}
+
+inline bool aabbIsEmpty(const aabb& a)
+{
+    return a.vMin.x > a.vMax.x;
+}
+
+inline aabb aabbUnion(const aabb& a, const aabb& b)
+{
+    return { { std::min(a.vMin.x, b.vMin.x), std::min(a.vMin.y, b.vMin.y), std::min(a.vMin.z, b.vMin.z) },
+             { std::max(a.vMax.x, b.vMax.x), std::max(a.vMax.y, b.vMax.y), std::max(a.vMax.z, b.vMax.z) } };
+}
+
+inline float aabbArea(const aabb& a)
+{
+    float dx = a.vMax.x - a.vMin.x, dy = a.vMax.y - a.vMin.y, dz = a.vMax.z - a.vMin.z;
+    return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+// the box around box a after the affine transform m (row vectors, as matvecMult): the
+// centre moves with m and each half extent becomes the sum of the old ones weighted by
+// the magnitudes of m's rotation / scale part
+inline aabb aabbTransform(const aabb& a, const mat4x4& m)
+{
+    float c[3] = { (a.vMin.x + a.vMax.x) * 0.5f, (a.vMin.y + a.vMax.y) * 0.5f, (a.vMin.z + a.vMax.z) * 0.5f };
+    float e[3] = { (a.vMax.x - a.vMin.x) * 0.5f, (a.vMax.y - a.vMin.y) * 0.5f, (a.vMax.z - a.vMin.z) * 0.5f };
+    float cw[3], ew[3];
+    for (int j = 0; j < 3; j++)
+    {
+        cw[j] = c[0] * m.m[0][j] + c[1] * m.m[1][j] + c[2] * m.m[2][j] + m.m[3][j];
+        ew[j] = e[0] * fabsf(m.m[0][j]) + e[1] * fabsf(m.m[1][j]) + e[2] * fabsf(m.m[2][j]);
+    }
+    return { { cw[0] - ew[0], cw[1] - ew[1], cw[2] - ew[2] }, { cw[0] + ew[0], cw[1] + ew[1], cw[2] + ew[2] } };
+}
+
+// a x + b y + c z + d >= 0 on the inside
+struct plane
+{
+    float a, b, c, d;
+};
+
+static const int FRUSTUM_PLANES = 5;
+// how much wider than the view the planes are, relative, so rounding in a box can never
+// cull something whose triangles would have reached the screen
+static const float FRUSTUM_SLACK = 1e-3f;
+
+// the four side planes and the near plane of the view in world space, from the
+// renderer's view and projection matrices multiplied together. With row vectors the clip
+// coordinates are p * matViewProj, so -w <= x <= w and -w <= y <= w are sums of its
+// columns. The projection puts view-space z in w, which is what the near plane at fNear
+// tests. There is no far plane, as the renderer does not clip against one
+inline void frustumPlanes(const mat4x4& matViewProj, float fNear, plane planes[FRUSTUM_PLANES])
+{
+    const float (*m)[4] = matViewProj.m;
+    const float k = 1.0f + FRUSTUM_SLACK;
+    // k w + s * (column j)
+    auto side = [&](int j, float s) -> plane
+        {
+            return { k * m[0][3] + s * m[0][j], k * m[1][3] + s * m[1][j], k * m[2][3] + s * m[2][j], k * m[3][3] + s * m[3][j] };
+        };
+    planes[0] = side(0, 1.0f);
+    planes[1] = side(0, -1.0f);
+    planes[2] = side(1, 1.0f);
+    planes[3] = side(1, -1.0f);
+    planes[4] = { m[0][3], m[1][3], m[2][3], m[3][3] - fNear * (1.0f - FRUSTUM_SLACK) };
+}
+
+class SceneBVH
+{
+public:
+    // a new tree over every object's box; object i has box vecBoxes[i], and objects
+    // with an empty box (aabbEmpty) are left out
+    void Build(const std::vector<aabb>& vecBoxes)
+    {
+        nodes.clear();
+        vecLeaf.assign(vecBoxes.size(), -1);
+        vecItems.clear();
+        for (size_t i = 0; i < vecBoxes.size(); i++)
+            if (!aabbIsEmpty(vecBoxes[i]))
+                vecItems.push_back((int)i);
+        fBuiltArea = fArea = 0.0f;
+        bDirty = false;
+        if (vecItems.empty())
+            return;
+        nodes.reserve(vecItems.size() * 2 - 1);
+        BuildNode(vecBoxes, vecItems.data(), (int)vecItems.size(), -1);
+        fBuiltArea = fArea = TotalArea();
+        bDirty = false;
+    }
+
+    // object i has moved to box; takes effect at the next Refit
+    void Update(int i, const aabb& box)
+    {
+        int n = vecLeaf[i];
+        if (n < 0)
+            return;
+        nodes[n].box = box;
+        for (n = nodes[n].nParent; n >= 0 && !nodes[n].bDirty; n = nodes[n].nParent)
+            nodes[n].bDirty = true;
+        bDirty = true;
+    }
+
+    // bring the boxes above moved objects up to date; false if the tree has loosened
+    // enough that it should be built again
+    bool Refit()
+    {
+        if (!bDirty)
+            return true;
+        // children are always stored after their parent
+        for (int n = (int)nodes.size() - 1; n >= 0; n--)
+        {
+            node& nd = nodes[n];
+            if (!nd.bDirty)
+                continue;
+            nd.box = aabbUnion(nodes[nd.nLeft].box, nodes[nd.nRight].box);
+            nd.bDirty = false;
+        }
+        bDirty = false;
+        fArea = TotalArea();
+        return fArea <= fBuiltArea * 2.0f;
+    }
+
+    // append the objects not wholly outside any of the planes to vecOut, and count the
+    // nodes visited
+    template <typename V>
+    void Cull(const plane* planes, int nPlanes, V& vecOut, int* pVisited = nullptr) const
+    {
+        if (nodes.empty())
+            return;
+        // (node, planes still to test as a bit mask)
+        std::pair<int, uint32_t> stack[64];
+        int nStack = 0;
+        int nVisited = 0;
+        stack[nStack++] = { 0, (1u << nPlanes) - 1 };
+        while (nStack > 0)
+        {
+            int n = stack[--nStack].first;
+            uint32_t nMask = stack[nStack].second;
+            const node& nd = nodes[n];
+            nVisited++;
+
+            bool bOutside = false;
+            for (int p = 0; p < nPlanes && !bOutside; p++)
+            {
+                if (!(nMask & (1u << p)))
+                    continue;
+                const plane& pl = planes[p];
+                // the corners farthest along and against the normal
+                float fFar = pl.a * (pl.a > 0.0f ? nd.box.vMax.x : nd.box.vMin.x) +
+                    pl.b * (pl.b > 0.0f ? nd.box.vMax.y : nd.box.vMin.y) +
+                    pl.c * (pl.c > 0.0f ? nd.box.vMax.z : nd.box.vMin.z) + pl.d;
+                float fNear = pl.a * (pl.a > 0.0f ? nd.box.vMin.x : nd.box.vMax.x) +
+                    pl.b * (pl.b > 0.0f ? nd.box.vMin.y : nd.box.vMax.y) +
+                    pl.c * (pl.c > 0.0f ? nd.box.vMin.z : nd.box.vMax.z) + pl.d;
+                if (fFar < 0.0f)
+                    bOutside = true;
+                else if (fNear >= 0.0f)
+                    nMask &= ~(1u << p);
+            }
+            if (bOutside)
+                continue;
+
+            if (nd.nItem >= 0)
+                vecOut.push_back(nd.nItem);
+            else
+            {
+                // right first, so objects come out in tree order, left to right
+                stack[nStack++] = { nd.nRight, nMask };
+                stack[nStack++] = { nd.nLeft, nMask };
+            }
+        }
+        if (pVisited != nullptr)
+            *pVisited = nVisited;
+    }
+
+    // room for nObjects without allocating, for a scene whose objects come and go
+    void Reserve(size_t nObjects)
+    {
+        nodes.reserve(nObjects * 2);
+        vecLeaf.reserve(nObjects);
+        vecItems.reserve(nObjects);
+    }
+
+    int Nodes() const { return (int)nodes.size(); }
+    // total surface area of the nodes, now and right after the last build
+    float Area() const { return fArea; }
+    float BuiltArea() const { return fBuiltArea; }
+
+private:
+    struct node
+    {
+        aabb box;
+        int nParent;
+        int nLeft;
+        int nRight;
+        // the object of a leaf, -1 for an inner node
+        int nItem;
+        bool bDirty;
+    };
+
+    std::vector<node> nodes;
+    // the leaf holding each object
+    std::vector<int> vecLeaf;
+    // objects being partitioned by Build, kept so a rebuild does not allocate
+    std::vector<int> vecItems;
+    float fArea = 0.0f;
+    float fBuiltArea = 0.0f;
+    bool bDirty = false;
+
+    int BuildNode(const std::vector<aabb>& vecBoxes, int* pItems, int nItems, int nParent)
+    {
+        int n = (int)nodes.size();
+        nodes.push_back({ vecBoxes[pItems[0]], nParent, -1, -1, -1, false });
+        if (nItems == 1)
+        {
+            nodes[n].nItem = pItems[0];
+            vecLeaf[pItems[0]] = n;
+            return n;
+        }
+
+        // split at the median centre along the axis the centres spread widest over
+        aabb centres = { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+        for (int i = 0; i < nItems; i++)
+        {
+            vec3d c = Centre(vecBoxes[pItems[i]]);
+            centres = aabbUnion(centres, { c, c });
+        }
+        vec3d vSpread = { centres.vMax.x - centres.vMin.x, centres.vMax.y - centres.vMin.y, centres.vMax.z - centres.vMin.z };
+        int nAxis = vSpread.x >= vSpread.y && vSpread.x >= vSpread.z ? 0 : vSpread.y >= vSpread.z ? 1 : 2;
+        int nHalf = nItems / 2;
+        std::nth_element(pItems, pItems + nHalf, pItems + nItems, [&](int i, int j)
+            {
+                return Axis(Centre(vecBoxes[i]), nAxis) < Axis(Centre(vecBoxes[j]), nAxis);
+            });
+
+        int nLeft = BuildNode(vecBoxes, pItems, nHalf, n);
+        int nRight = BuildNode(vecBoxes, pItems + nHalf, nItems - nHalf, n);
+        nodes[n].nLeft = nLeft;
+        nodes[n].nRight = nRight;
+        nodes[n].box = aabbUnion(nodes[nLeft].box, nodes[nRight].box);
+        return n;
+    }
+
+    static vec3d Centre(const aabb& a)
+    {
+        return { (a.vMin.x + a.vMax.x) * 0.5f, (a.vMin.y + a.vMax.y) * 0.5f, (a.vMin.z + a.vMax.z) * 0.5f };
+    }
+
+    static float Axis(const vec3d& v, int nAxis)
+    {
+        return nAxis == 0 ? v.x : nAxis == 1 ? v.y : v.z;
+    }
+
+    float TotalArea() const
+    {
+        float f = 0.0f;
+        for (const node& nd : nodes)
+            f += aabbArea(nd.box);
+        return f;
+    }
+};
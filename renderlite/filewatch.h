@@ -0,0 +1,142 @@
+// filewatch.h : notices files in a directory being rewritten, so assets reload as they are exported.
+//
+// DirWatcher has Linux's inotify report files in one directory being created, written
+// to, or moved in over an older one. Poll() runs once a frame on the game thread: it
+// reads whatever has arrived without blocking, and hands back each file that has been
+// quiet for nQuietMs since its last event, once. An exporter writing a file in many
+// pieces, or writing a temporary and renaming it over the old file, is then a single
+// change, reported when it is finished. A frame with nothing new costs one read() that
+// finds nothing, and allocates nothing.
+//
+// On other systems Watch() fails and there is nothing to poll.
+
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+
+#include <sys/inotify.h>
+#include <unistd.h>
+
+class DirWatcher
+{
+public:
+    ~DirWatcher()
+    {
+        Close();
+    }
+
+    // watch the directory sDirectory ("" for the current one), in place of any before it
+    bool Watch(const std::string& sDirectory, int nQuietMs = 250)
+    {
+        Close();
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0)
+            return false;
+        sDir = sDirectory;
+        if (inotify_add_watch(fd, sDir.empty() ? "." : sDir.c_str(), IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+        {
+            Close();
+            return false;
+        }
+        nQuiet = std::chrono::milliseconds(nQuietMs);
+        return true;
+    }
+
+    void Close()
+    {
+        if (fd >= 0)
+            close(fd);
+        fd = -1;
+        sDir.clear();
+        vecPending.clear();
+    }
+
+    bool Active() const { return fd >= 0; }
+    const std::string& Dir() const { return sDir; }
+
+    // names within the directory of the files that have settled since the last call
+    const std::vector<std::string>& Poll()
+    {
+        vecSettled.clear();
+        if (fd < 0)
+            return vecSettled;
+        auto tNow = std::chrono::steady_clock::now();
+
+        while (true)
+        {
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n <= 0)
+                break;
+            for (ssize_t i = 0; i < n; )
+            {
+                const inotify_event* ev = (const inotify_event*)(buf + i);
+                i += sizeof(inotify_event) + ev->len;
+                if (ev->len == 0 || (ev->mask & IN_ISDIR))
+                    continue;
+                // the name is padded with zeros to the length given
+                std::string sName = ev->name;
+                bool bFound = false;
+                for (pending& p : vecPending)
+                    if (p.sName == sName)
+                    {
+                        p.tLast = tNow;
+                        bFound = true;
+                    }
+                if (!bFound)
+                    vecPending.push_back({ sName, tNow });
+            }
+        }
+
+        for (size_t i = 0; i < vecPending.size(); )
+        {
+            if (tNow - vecPending[i].tLast < nQuiet)
+            {
+                i++;
+                continue;
+            }
+            vecSettled.push_back(std::move(vecPending[i].sName));
+            vecPending.erase(vecPending.begin() + i);
+        }
+        return vecSettled;
+    }
+
+private:
+    struct pending
+    {
+        std::string sName;
+        std::chrono::steady_clock::time_point tLast;
+    };
+
+    int fd = -1;
+    std::string sDir;
+    std::chrono::steady_clock::duration nQuiet{};
+    // files with events still coming in, and those settled this Poll
+    std::vector<pending> vecPending;
+    std::vector<std::string> vecSettled;
+    alignas(inotify_event) char buf[4096];
+};
+
+#else
+
+class DirWatcher
+{
+public:
+    bool Watch(const std::string& sDirectory, int nQuietMs = 250)
+    {
+        return false;
+    }
+    void Close() {}
+    bool Active() const { return false; }
+    const std::string& Dir() const { return sDir; }
+    const std::vector<std::string>& Poll() { return vecSettled; }
+
+private:
+    std::string sDir;
+    std::vector<std::string> vecSettled;
+};
+
+#endif
@@ -0,0 +1,148 @@
+// framearena.h : bump-pointer arena for data that only lives for one frame.
+//
+// Alloc() hands out the next aligned slice of one big block, and Reset() at the start of
+// the next frame takes it all back at once; nothing is freed individually. If a frame
+// needs more than the block holds the extra requests are served from malloc'd overflow
+// blocks, and the next Reset() replaces the block with one as big as the frame needed,
+// so the arena settles at the high-water mark after the first heavy frame. HighWater()
+// reports that mark so the arena can be given the right size up front.
+//
+// arenaAllocator adapts it for standard containers:
+//
+//   arenaVector<triangle> vecTris(arenaAllocator<triangle>(arena));
+//
+// Deallocation is a no-op, so a container on the arena must not outlive the frame, and
+// growing one abandons its old storage until the reset (reserve what is known).
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+class FrameArena
+{
+public:
+    explicit FrameArena(size_t nBytes = 0)
+    {
+        Reserve(nBytes);
+    }
+
+    ~FrameArena()
+    {
+        FreeOverflow();
+        free(pBase);
+    }
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // make the block at least nBytes; only between frames, it discards the contents.
+    // The pages are touched here so the first frames do not fault them in
+    void Reserve(size_t nBytes)
+    {
+        if (nBytes <= nSize)
+            return;
+        free(pBase);
+        pBase = (uint8_t*)malloc(nBytes);
+        if (pBase == nullptr)
+            throw std::bad_alloc();
+        memset(pBase, 0, nBytes);
+        nSize = nBytes;
+        nUsed = 0;
+    }
+
+    void* Alloc(size_t nBytes, size_t nAlign = alignof(std::max_align_t))
+    {
+        size_t nAt = (nUsed + nAlign - 1) & ~(nAlign - 1);
+        if (nAt + nBytes <= nSize)
+        {
+            nFrameBytes += nAt + nBytes - nUsed;
+            nUsed = nAt + nBytes;
+            return pBase + nAt;
+        }
+        return Overflow(nBytes, nAlign);
+    }
+
+    // start a new frame: everything allocated so far is gone
+    void Reset()
+    {
+        if (nFrameBytes > nHighWater)
+            nHighWater = nFrameBytes;
+        if (!vecOverflow.empty())
+        {
+            FreeOverflow();
+            nGrows++;
+            // a quarter extra so a slowly growing load does not grow it every frame
+            Reserve(nHighWater + nHighWater / 4);
+        }
+        nUsed = 0;
+        nFrameBytes = 0;
+    }
+
+    // most bytes any frame has asked for (including alignment), as of the last Reset
+    size_t HighWater() const { return nHighWater; }
+    // bytes the block holds
+    size_t Capacity() const { return nSize; }
+    // bytes handed out so far this frame
+    size_t Used() const { return nFrameBytes; }
+    // frames that did not fit and made the block grow
+    uint32_t Grows() const { return nGrows; }
+
+private:
+    uint8_t* pBase = nullptr;
+    size_t nSize = 0;
+    size_t nUsed = 0;
+    size_t nFrameBytes = 0;
+    size_t nHighWater = 0;
+    uint32_t nGrows = 0;
+    std::vector<void*> vecOverflow;
+
+    void* Overflow(size_t nBytes, size_t nAlign)
+    {
+        void* p = malloc(nBytes + nAlign);
+        if (p == nullptr)
+            throw std::bad_alloc();
+        vecOverflow.push_back(p);
+        nFrameBytes += nBytes + nAlign;
+        uintptr_t n = ((uintptr_t)p + nAlign - 1) & ~(uintptr_t)(nAlign - 1);
+        return (void*)n;
+    }
+
+    void FreeOverflow()
+    {
+        for (void* p : vecOverflow)
+            free(p);
+        vecOverflow.clear();
+    }
+};
+
+template <typename T>
+struct arenaAllocator
+{
+    using value_type = T;
+
+    FrameArena* pArena;
+
+    explicit arenaAllocator(FrameArena& arena) : pArena(&arena) {}
+    template <typename U>
+    arenaAllocator(const arenaAllocator<U>& other) : pArena(other.pArena) {}
+
+    T* allocate(size_t n)
+    {
+        return (T*)pArena->Alloc(n * sizeof(T), alignof(T));
+    }
+
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const arenaAllocator<U>& other) const { return pArena == other.pArena; }
+    template <typename U>
+    bool operator!=(const arenaAllocator<U>& other) const { return pArena != other.pArena; }
+};
+
+template <typename T>
+using arenaVector = std::vector<T, arenaAllocator<T>>;
@@ -0,0 +1,133 @@
+// framedecode.cpp : standalone decoder for renderlite frame streams (see framestream.h).
+//
+// Rebuilds the framebuffer frame by frame from a stream file or stdin and, depending on
+// the options, draws it to this terminal, dumps one frame as PPM, or prints per-frame
+// sizes and the overall compression ratio.
+//
+//   framedecode [file | -] [--play] [--ppm out.ppm [--frame N]] [--stats]
+//
+// e.g. over SSH:  ssh host 'cat /tmp/renderlite.rlfs' | framedecode - --play
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include "framestream.h"
+
+// displayed colour of a decoded cell
+static uint32_t cellColour(const FrameStreamReader& reader, uint32_t cell)
+{
+    if (reader.nFormat == FRAMESTREAM_RGBX)
+        return cell;
+    return resolveRGB(cell, 0, 0, OUTPUT_LEGACY16);
+}
+
+static void drawToTerminal(const FrameStreamReader& reader, std::string& out)
+{
+    out.assign("\x1b[H");
+    char buf[32];
+    uint32_t last = 0xFFFFFFFF;
+    const std::vector<uint32_t>& cells = reader.Cells();
+
+    for (int y = 0; y < reader.nHeight; y++)
+    {
+        snprintf(buf, sizeof(buf), "\x1b[%d;1H", y + 1);
+        out += buf;
+        for (int x = 0; x < reader.nWidth; x++)
+        {
+            uint32_t c = cellColour(reader, cells[y * reader.nWidth + x]) & 0xFFFFFF;
+            if (c != last)
+            {
+                snprintf(buf, sizeof(buf), "\x1b[48;2;%d;%d;%dm", shadeR(c), shadeG(c), shadeB(c));
+                out += buf;
+                last = c;
+            }
+            out += ' ';
+        }
+    }
+    fwrite(out.data(), 1, out.size(), stdout);
+    fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+    const char* sPath = "-";
+    const char* sPpm = nullptr;
+    long nPpmFrame = -1;
+    bool bPlay = false, bStats = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string a = argv[i];
+        if (a == "--play") bPlay = true;
+        else if (a == "--stats") bStats = true;
+        else if (a == "--ppm" && i + 1 < argc) sPpm = argv[++i];
+        else if (a == "--frame" && i + 1 < argc) nPpmFrame = atol(argv[++i]);
+        else sPath = argv[i];
+    }
+
+    FILE* f = (sPath[0] == '-' && sPath[1] == 0) ? stdin : fopen(sPath, "rb");
+    FrameStreamReader reader;
+    if (f == nullptr || !reader.Open(f))
+    {
+        fprintf(stderr, "framedecode: %s is not a renderlite frame stream\n", sPath);
+        return 1;
+    }
+
+    if (bPlay)
+        fputs("\x1b[?1049h\x1b[?25l", stdout);
+
+    uint64_t nFrames = 0, nKeys = 0, nBad = 0, nBytes = 0;
+    uint32_t nFrame;
+    FRAMESTREAM_KIND kind;
+    size_t nPayload;
+    std::string screen;
+    std::vector<uint32_t> snapshot;
+
+    while (reader.Next(nFrame, kind, nPayload))
+    {
+        nFrames++;
+        nKeys += kind == FRAMESTREAM_KEY;
+        nBytes += nPayload + 9;
+
+        if (!reader.LastDecoded())
+        {
+            // corrupt data, and deltas before the first keyframe (joined mid-stream) or
+            // after corrupt data, until the next keyframe resyncs
+            nBad++;
+            continue;
+        }
+
+        if (bStats)
+            fprintf(stderr, "frame %u %s %zu bytes (%.1fx)\n", nFrame, kind == FRAMESTREAM_KEY ? "key  " : "delta",
+                nPayload, (double)reader.nWidth * reader.nHeight * 4 / (nPayload + 9));
+        if (bPlay)
+            drawToTerminal(reader, screen);
+        if (sPpm != nullptr && (nPpmFrame < 0 || (long)nFrame == nPpmFrame))
+            snapshot = reader.Cells();
+    }
+
+    if (bPlay)
+        fputs("\x1b[0m\x1b[?25h\x1b[?1049l", stdout);
+
+    double nRaw = (double)nFrames * reader.nWidth * reader.nHeight * 4;
+    fprintf(stderr, "%llu frames (%llu key, %llu undecodable), %dx%d, %llu bytes, ratio %.1f:1\n",
+        (unsigned long long)nFrames, (unsigned long long)nKeys, (unsigned long long)nBad,
+        reader.nWidth, reader.nHeight, (unsigned long long)nBytes, nBytes ? nRaw / nBytes : 0.0);
+
+    if (sPpm != nullptr && !snapshot.empty())
+    {
+        FILE* o = fopen(sPpm, "wb");
+        if (o == nullptr)
+            return 1;
+        fprintf(o, "P6\n%d %d\n255\n", reader.nWidth, reader.nHeight);
+        for (uint32_t cell : snapshot)
+        {
+            uint32_t c = cellColour(reader, cell);
+            uint8_t rgb[3] = { shadeR(c), shadeG(c), shadeB(c) };
+            fwrite(rgb, 1, 3, o);
+        }
+        fclose(o);
+    }
+
+    return 0;
+}
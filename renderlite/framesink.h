@@ -0,0 +1,351 @@
+// framesink.h : streams presented frames to a file or pipe for offline renders.
+//
+// FrameSink is an olcFrameOutput. On the game thread it only converts the frame into
+// the next free slot of a bounded ring (raw RGB24, Y4M 4:2:0 or PPM). A writer thread
+// drains the ring through a large stdio buffer, so rendering only waits on I/O when every
+// slot is full, e.g. when the disk or the consumer on the other end of the pipe cannot
+// keep up. The ring (AsyncWriteRing) takes any records, and the frame stream
+// (framestream.h) writes through one too.
+//
+//   FrameSink sink;
+//   sink.Open("out.y4m", SINK_Y4M, ScreenWidth(), ScreenHeight());   // "-" for stdout
+//   AddFrameOutput(&sink);
+//   ...
+//   sink.Close();   // drains the ring, joins the writer
+
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "olcConsoleGameEngine.h"
+
+struct writeRingStats
+{
+    uint64_t nRecords = 0;
+    uint64_t nBytes = 0;
+    // records lost to a write error: stdio drops what it had buffered when a write or
+    // flush fails, so every record from the first error on counts. A failed final flush
+    // only sets bError
+    uint64_t nFailed = 0;
+    bool bError = false;
+    // time the producer spent waiting for a free slot
+    double fStallSeconds = 0.0;
+    // when the last record finished writing
+    std::chrono::steady_clock::time_point tLastWrite;
+};
+
+// Bounded ring of byte records written to a FILE by a thread of its own. The producer
+// fills the slot Acquire() hands it and queues it with Publish(); it only waits when
+// every slot is still queued. Slots keep their capacity, so once each has held the
+// largest record a steady stream allocates nothing.
+class AsyncWriteRing
+{
+public:
+    ~AsyncWriteRing()
+    {
+        Close();
+    }
+
+    // write to file through nSlots slots of nReserve bytes to start with. With
+    // bFlushIdle the file is flushed whenever the ring runs dry, so a reader at the other
+    // end of a pipe gets each record once it is written, not once the stdio buffer fills
+    void Start(FILE* file, size_t nSlots, size_t nReserve = 0, bool bFlushIdle = false)
+    {
+        Close();
+        f = file;
+        bFlush = bFlushIdle;
+        slots.assign(nSlots, std::vector<uint8_t>());
+        for (std::vector<uint8_t>& slot : slots)
+            slot.reserve(nReserve);
+        nHead = nTail = 0;
+        stats = writeRingStats();
+        bActive = true;
+        writer = std::thread(&AsyncWriteRing::WriterThread, this);
+    }
+
+    // write everything queued and stop the writer; the file stays open
+    void Close()
+    {
+        if (!bActive)
+            return;
+        {
+            std::unique_lock<std::mutex> lm(mux);
+            bActive = false;
+        }
+        cvFilled.notify_one();
+        writer.join();
+        if (fflush(f) != 0)
+            stats.bError = true;
+    }
+
+    bool Active() const { return bActive; }
+
+    // the next free slot, waiting for the writer if the ring is full. It holds the record
+    // last written from it, for the caller to overwrite or clear, and is the caller's
+    // until Publish
+    std::vector<uint8_t>& Acquire()
+    {
+        std::unique_lock<std::mutex> lm(mux);
+        if (nHead - nTail == slots.size())
+        {
+            auto t0 = std::chrono::steady_clock::now();
+            cvFree.wait(lm, [&] { return nHead - nTail < slots.size(); });
+            stats.fStallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        }
+        return slots[nHead % slots.size()];
+    }
+
+    // queue the slot Acquire handed out
+    void Publish()
+    {
+        {
+            std::unique_lock<std::mutex> lm(mux);
+            nHead++;
+        }
+        cvFilled.notify_one();
+    }
+
+    writeRingStats Stats()
+    {
+        std::unique_lock<std::mutex> lm(mux);
+        return stats;
+    }
+
+private:
+    FILE* f = nullptr;
+    bool bFlush = false;
+    // [nTail, nHead) are waiting to be written
+    std::vector<std::vector<uint8_t>> slots;
+    size_t nHead = 0;
+    size_t nTail = 0;
+    bool bActive = false;
+    std::mutex mux;
+    std::condition_variable cvFilled;
+    std::condition_variable cvFree;
+    std::thread writer;
+    writeRingStats stats;
+
+    void WriterThread()
+    {
+        while (true)
+        {
+            size_t nRecord;
+            {
+                std::unique_lock<std::mutex> lm(mux);
+                if (bFlush && nHead == nTail && bActive)
+                {
+                    // nothing queued: send what has been written on its way
+                    lm.unlock();
+                    bool bFlushed = fflush(f) == 0;
+                    lm.lock();
+                    if (!bFlushed)
+                        stats.bError = true;
+                }
+                cvFilled.wait(lm, [&] { return nHead != nTail || !bActive; });
+                if (nHead == nTail)
+                    break;
+                nRecord = nTail;
+            }
+
+            std::vector<uint8_t>& slot = slots[nRecord % slots.size()];
+            // a full disk or a closed pipe: count the record as lost and carry on, the
+            // producer must not block on a file that has stopped taking data
+            size_t nWritten = fwrite(slot.data(), 1, slot.size(), f);
+
+            {
+                std::unique_lock<std::mutex> lm(mux);
+                nTail++;
+                stats.nRecords++;
+                stats.nBytes += nWritten;
+                if (nWritten != slot.size())
+                    stats.bError = true;
+                if (stats.bError)
+                    stats.nFailed++;
+                stats.tLastWrite = std::chrono::steady_clock::now();
+            }
+            cvFree.notify_one();
+        }
+    }
+};
+
+enum SINK_FORMAT
+{
+    // packed 8-bit r, g, b per cell, no headers (e.g. ffmpeg -f rawvideo -pix_fmt rgb24)
+    SINK_RAW_RGB,
+    // YUV4MPEG2 stream, 4:2:0 full range
+    SINK_Y4M,
+    // concatenated binary P6 images (e.g. ffmpeg -f image2pipe -c:v ppm)
+    SINK_PPM,
+};
+
+struct sinkStats
+{
+    uint64_t nFrames = 0;
+    uint64_t nBytes = 0;
+    // wall time from the first frame to the last completed write
+    double fSeconds = 0.0;
+    // time the game thread spent waiting for a free slot
+    double fStallSeconds = 0.0;
+    // frames lost to write errors; bWriteError alone means the final flush failed
+    uint64_t nFailed = 0;
+    bool bWriteError = false;
+};
+
+class FrameSink : public olcFrameOutput
+{
+public:
+    ~FrameSink()
+    {
+        Close();
+    }
+
+    // sPath "-" writes to stdout. nSlots frames can be queued before rendering waits
+    bool Open(const char* sPath, SINK_FORMAT format, int width, int height, int nSlots = 8, int nFps = 30)
+    {
+        Close();
+
+        if (format == SINK_Y4M && ((width | height) & 1))
+            return false;
+
+        bStdout = sPath[0] == '-' && sPath[1] == 0;
+        f = bStdout ? stdout : fopen(sPath, "wb");
+        if (f == nullptr)
+            return false;
+
+        // large writes, the ring already decouples us from the renderer
+        ioBuffer.resize(4 << 20);
+        setvbuf(f, ioBuffer.data(), _IOFBF, ioBuffer.size());
+
+        nFormat = format;
+        nWidth = width;
+        nHeight = height;
+
+        char header[128];
+        int n = 0;
+        if (nFormat == SINK_Y4M)
+            n = snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", nWidth, nHeight, nFps);
+        else if (nFormat == SINK_PPM)
+            n = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", nWidth, nHeight);
+        frameHeader.assign(header, header + n);
+
+        // Y4M repeats a short tag per frame, PPM its whole header
+        if (nFormat == SINK_Y4M)
+        {
+            fwrite(frameHeader.data(), 1, frameHeader.size(), f);
+            const char tag[] = "FRAME\n";
+            frameHeader.assign(tag, tag + sizeof(tag) - 1);
+        }
+
+        nPayload = nFormat == SINK_Y4M ? (size_t)nWidth * nHeight * 3 / 2 : (size_t)nWidth * nHeight * 3;
+        nFrames = 0;
+        ring.Start(f, nSlots, frameHeader.size() + nPayload);
+        return true;
+    }
+
+    // flush every queued frame and stop the writer
+    void Close()
+    {
+        if (!ring.Active())
+            return;
+        ring.Close();
+        if (!bStdout)
+            fclose(f);
+        f = nullptr;
+    }
+
+    void OnFrame(const olcFrame& frame) override
+    {
+        if (!ring.Active() || frame.nWidth != nWidth || frame.nHeight != nHeight)
+            return;
+
+        if (nFrames == 0)
+            tStart = std::chrono::steady_clock::now();
+
+        // waits for a free slot only when the writer is behind by the whole ring
+        std::vector<uint8_t>& slot = ring.Acquire();
+        slot.resize(frameHeader.size() + nPayload);
+        std::copy(frameHeader.begin(), frameHeader.end(), slot.begin());
+        if (nFormat == SINK_Y4M)
+            ConvertYUV420(frame, slot.data() + frameHeader.size());
+        else
+            ConvertRGB(frame, slot.data() + frameHeader.size());
+        ring.Publish();
+        nFrames++;
+    }
+
+    sinkStats Stats()
+    {
+        writeRingStats rs = ring.Stats();
+        sinkStats st;
+        st.nFrames = nFrames;
+        st.nBytes = rs.nBytes;
+        if (rs.nRecords > 0)
+            st.fSeconds = std::chrono::duration<double>(rs.tLastWrite - tStart).count();
+        st.fStallSeconds = rs.fStallSeconds;
+        st.nFailed = rs.nFailed;
+        st.bWriteError = rs.bError;
+        return st;
+    }
+
+private:
+    FILE* f = nullptr;
+    bool bStdout = false;
+    std::vector<char> ioBuffer;
+    SINK_FORMAT nFormat = SINK_RAW_RGB;
+    int nWidth = 0;
+    int nHeight = 0;
+    std::vector<uint8_t> frameHeader;
+    size_t nPayload = 0;
+
+    // converted frames on their way to the file
+    AsyncWriteRing ring;
+    uint64_t nFrames = 0;
+    std::chrono::steady_clock::time_point tStart;
+
+    void ConvertRGB(const olcFrame& frame, uint8_t* out)
+    {
+        int nCells = nWidth * nHeight;
+        for (int i = 0; i < nCells; i++)
+        {
+            uint32_t c = frame.CellRGB(i);
+            out[0] = shadeR(c);
+            out[1] = shadeG(c);
+            out[2] = shadeB(c);
+            out += 3;
+        }
+    }
+
+    // BT.601 full range, chroma averaged over each 2x2 block
+    void ConvertYUV420(const olcFrame& frame, uint8_t* out)
+    {
+        uint8_t* pY = out;
+        uint8_t* pU = out + nWidth * nHeight;
+        uint8_t* pV = pU + (nWidth / 2) * (nHeight / 2);
+
+        for (int y = 0; y < nHeight; y += 2)
+            for (int x = 0; x < nWidth; x += 2)
+            {
+                int sr = 0, sg = 0, sb = 0;
+                for (int k = 0; k < 4; k++)
+                {
+                    int i = (y + (k >> 1)) * nWidth + x + (k & 1);
+                    uint32_t c = frame.CellRGB(i);
+                    int r = shadeR(c), g = shadeG(c), b = shadeB(c);
+                    pY[i] = (uint8_t)((77 * r + 150 * g + 29 * b + 128) >> 8);
+                    sr += r; sg += g; sb += b;
+                }
+                sr >>= 2; sg >>= 2; sb >>= 2;
+
+                int ci = (y / 2) * (nWidth / 2) + x / 2;
+                // saturated blue (U) and red (V) round to 256, which must not wrap to 0
+                pU[ci] = (uint8_t)std::min((-43 * sr - 85 * sg + 128 * sb + 32768 + 128) >> 8, 255);
+                pV[ci] = (uint8_t)std::min((128 * sr - 107 * sg - 21 * sb + 32768 + 128) >> 8, 255);
+            }
+    }
+};
@@ -0,0 +1,498 @@
+// framestream.h : compact binary frame stream for slow links (serial, SSH pipes).
+//
+// Every frame is a grid of 32-bit cells: CHAR_INFO (glyph | attr << 16) for the legacy
+// 16 colour target, or resolved colour (see resolveRGB) for the xterm-256 and truecolor
+// targets. A keyframe codes the whole grid; a delta frame codes it against the previous
+// frame, so unchanged spans cost a single op. Both are run-length coded:
+//
+//   stream  := header frame*
+//   header  := "RLFS" u16 version, u16 format, u16 width, u16 height
+//   frame   := u8 kind (0 key, 1 delta), u32 frame number, u32 payload bytes, op*
+//   op      := u8 (type << 6 | min(len - 1, 63)) [varint len - 64 if len > 63] data
+//     SKIP  len cells unchanged from the previous frame (delta frames only), no data
+//     RUN   len cells of one value, data = 4 byte cell
+//     LIT   len literal cells, data = 4 * len bytes
+//
+// All integers are little-endian. The encoder falls back to a keyframe when a delta comes
+// out large and the keyframe would be smaller, and emits one at least every nKeyInterval
+// frames so a decoder joining mid-stream can sync up.
+
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include "olcConsoleGameEngine.h"
+#include "framesink.h"
+
+static const char FRAMESTREAM_MAGIC[4] = { 'R', 'L', 'F', 'S' };
+static const uint16_t FRAMESTREAM_VERSION = 1;
+
+enum FRAMESTREAM_FORMAT
+{
+    FRAMESTREAM_CELLS = 0,
+    FRAMESTREAM_RGBX = 1,
+};
+
+enum FRAMESTREAM_KIND
+{
+    FRAMESTREAM_KEY = 0,
+    FRAMESTREAM_DELTA = 1,
+};
+
+enum FRAMESTREAM_OP
+{
+    FRAMESTREAM_SKIP = 0,
+    FRAMESTREAM_RUN = 1,
+    FRAMESTREAM_LIT = 2,
+};
+
+inline void streamPut16(std::vector<uint8_t>& out, uint32_t v)
+{
+    out.push_back((uint8_t)v);
+    out.push_back((uint8_t)(v >> 8));
+}
+
+inline void streamPut32(std::vector<uint8_t>& out, uint32_t v)
+{
+    streamPut16(out, v);
+    streamPut16(out, v >> 16);
+}
+
+inline uint32_t streamGet16(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8);
+}
+
+inline uint32_t streamGet32(const uint8_t* p)
+{
+    return streamGet16(p) | (streamGet16(p + 2) << 16);
+}
+
+
+// Codes one frame at a time against the previous one
+class FrameStreamEncoder
+{
+public:
+    // append the op stream for 'cells' (w * h) to 'out'. Returns the kind that was coded
+    FRAMESTREAM_KIND Encode(const uint32_t* cells, int nCells, bool bForceKey, std::vector<uint8_t>& out)
+    {
+        size_t start = out.size();
+        bool bDelta = !bForceKey && (int)prev.size() == nCells;
+
+        if (bDelta)
+        {
+            encodeOps(cells, nCells, prev.data(), out);
+
+            // a big delta (over 2 of the 4 raw bytes per cell) may lose to a keyframe,
+            // and then is not worth the dependency on the previous frame
+            size_t nDelta = out.size() - start;
+            scratch.clear();
+            if (nDelta > (size_t)nCells * 2)
+                encodeOps(cells, nCells, nullptr, scratch);
+            if (!scratch.empty() && scratch.size() <= nDelta)
+            {
+                out.resize(start);
+                out.insert(out.end(), scratch.begin(), scratch.end());
+                bDelta = false;
+            }
+        }
+        else
+        {
+            encodeOps(cells, nCells, nullptr, out);
+        }
+
+        prev.assign(cells, cells + nCells);
+        return bDelta ? FRAMESTREAM_DELTA : FRAMESTREAM_KEY;
+    }
+
+    void Reset()
+    {
+        prev.clear();
+    }
+
+private:
+    std::vector<uint32_t> prev;
+    std::vector<uint8_t> scratch;
+
+    static void putOp(std::vector<uint8_t>& out, int type, uint32_t len)
+    {
+        uint32_t n = len - 1;
+        out.push_back((uint8_t)((type << 6) | (n < 63 ? n : 63)));
+        if (n >= 63)
+        {
+            // varint continuation for long spans
+            n -= 63;
+            while (n >= 0x80) { out.push_back((uint8_t)(n | 0x80)); n >>= 7; }
+            out.push_back((uint8_t)n);
+        }
+    }
+
+    // prev == nullptr codes a keyframe
+    static void encodeOps(const uint32_t* cur, int n, const uint32_t* prev, std::vector<uint8_t>& out)
+    {
+        int i = 0;
+        while (i < n)
+        {
+            // unchanged span
+            if (prev != nullptr && cur[i] == prev[i])
+            {
+                int j = i + 1;
+                while (j < n && cur[j] == prev[j]) j++;
+                putOp(out, FRAMESTREAM_SKIP, j - i);
+                i = j;
+                continue;
+            }
+
+            // uniform span (may run through unchanged cells, rewriting them is free)
+            int j = i + 1;
+            while (j < n && cur[j] == cur[i]) j++;
+            if (j - i >= 2)
+            {
+                putOp(out, FRAMESTREAM_RUN, j - i);
+                streamPut32(out, cur[i]);
+                i = j;
+                continue;
+            }
+
+            // literals until the next skip or run of 2+ would start
+            j = i + 1;
+            while (j < n)
+            {
+                if (prev != nullptr && cur[j] == prev[j] && (j + 1 >= n || cur[j + 1] == prev[j + 1]))
+                    break;
+                if (j + 1 < n && cur[j] == cur[j + 1])
+                    break;
+                j++;
+            }
+            putOp(out, FRAMESTREAM_LIT, j - i);
+            for (int k = i; k < j; k++)
+                streamPut32(out, cur[k]);
+            i = j;
+        }
+    }
+};
+
+
+// Rebuilds the cell grid from op streams
+class FrameStreamDecoder
+{
+public:
+    void Resize(int nCells)
+    {
+        cells.assign(nCells, 0);
+        bHaveKey = false;
+    }
+
+    // apply one frame's ops. Returns false on corrupt input, or for a delta that
+    // arrives before any keyframe (nothing to apply it to). Corrupt input leaves the grid
+    // part written, so deltas are refused again until the next keyframe
+    bool Decode(FRAMESTREAM_KIND kind, const uint8_t* p, size_t nBytes)
+    {
+        if (kind == FRAMESTREAM_DELTA && !bHaveKey)
+            return false;
+        if (!Apply(kind, p, nBytes))
+        {
+            bHaveKey = false;
+            return false;
+        }
+        if (kind == FRAMESTREAM_KEY)
+            bHaveKey = true;
+        return true;
+    }
+
+    // a frame went missing (e.g. its record was unreadable): refuse deltas until the
+    // next keyframe
+    void DropKey()
+    {
+        bHaveKey = false;
+    }
+
+    const std::vector<uint32_t>& Cells() const
+    {
+        return cells;
+    }
+
+    // the largest op stream the encoder writes for nCells: at worst every op is a
+    // one-cell literal, 5 bytes a cell. Longer ops need varint bytes but cover 64+ cells
+    static size_t MaxPayload(int nCells)
+    {
+        return (size_t)nCells * 5;
+    }
+
+private:
+    std::vector<uint32_t> cells;
+    bool bHaveKey = false;
+
+    bool Apply(FRAMESTREAM_KIND kind, const uint8_t* p, size_t nBytes)
+    {
+        const uint8_t* end = p + nBytes;
+        size_t i = 0, n = cells.size();
+
+        while (p < end)
+        {
+            int type = *p >> 6;
+            uint32_t len = (*p & 63);
+            p++;
+            if (len == 63)
+            {
+                uint32_t ext = 0;
+                int shift = 0;
+                do
+                {
+                    if (p >= end || shift > 28) return false;
+                    ext |= (uint32_t)(*p & 0x7F) << shift;
+                    shift += 7;
+                } while (*p++ & 0x80);
+                len += ext;
+            }
+            len += 1;
+
+            if (i + len > n)
+                return false;
+
+            switch (type)
+            {
+            case FRAMESTREAM_SKIP:
+                if (kind == FRAMESTREAM_KEY) return false;
+                break;
+            case FRAMESTREAM_RUN:
+            {
+                if (end - p < 4) return false;
+                uint32_t v = streamGet32(p);
+                p += 4;
+                std::fill(cells.begin() + i, cells.begin() + i + len, v);
+                break;
+            }
+            case FRAMESTREAM_LIT:
+                if ((size_t)(end - p) < (size_t)len * 4) return false;
+                for (uint32_t k = 0; k < len; k++, p += 4)
+                    cells[i + k] = streamGet32(p);
+                break;
+            default:
+                return false;
+            }
+            i += len;
+        }
+
+        return i == n;
+    }
+};
+
+
+// Stream reader: parses the header and hands out frame records
+class FrameStreamReader
+{
+public:
+    int nWidth = 0;
+    int nHeight = 0;
+    FRAMESTREAM_FORMAT nFormat = FRAMESTREAM_CELLS;
+
+    bool Open(FILE* file)
+    {
+        f = file;
+        uint8_t h[12];
+        if (fread(h, 1, sizeof(h), f) != sizeof(h) || memcmp(h, FRAMESTREAM_MAGIC, 4) != 0)
+            return false;
+        if (streamGet16(h + 4) != FRAMESTREAM_VERSION)
+            return false;
+        nFormat = (FRAMESTREAM_FORMAT)streamGet16(h + 6);
+        nWidth = (int)streamGet16(h + 8);
+        nHeight = (int)streamGet16(h + 10);
+        decoder.Resize(nWidth * nHeight);
+        return true;
+    }
+
+    // read and decode the next frame. Returns false at end of stream. A record that does
+    // not decode is still returned, with LastDecoded() false
+    bool Next(uint32_t& nFrame, FRAMESTREAM_KIND& kind, size_t& nPayload)
+    {
+        uint8_t h[9];
+        if (fread(h, 1, sizeof(h), f) != sizeof(h))
+            return false;
+        kind = (FRAMESTREAM_KIND)h[0];
+        nFrame = streamGet32(h + 1);
+        nPayload = streamGet32(h + 5);
+
+        // a length no frame of this size can have is a corrupt record, not an allocation
+        // to attempt: skip what it claims through a bounded buffer and wait for a keyframe
+        size_t nMax = FrameStreamDecoder::MaxPayload(nWidth * nHeight);
+        if (nPayload > nMax)
+        {
+            payload.resize(64 << 10);
+            for (size_t nLeft = nPayload; nLeft > 0; )
+            {
+                size_t n = std::min(nLeft, payload.size());
+                if (fread(payload.data(), 1, n, f) != n)
+                    return false;
+                nLeft -= n;
+            }
+            decoder.DropKey();
+            bLastOk = false;
+            return true;
+        }
+
+        payload.resize(nPayload);
+        if (fread(payload.data(), 1, nPayload, f) != nPayload)
+            return false;
+        bLastOk = decoder.Decode(kind, payload.data(), nPayload);
+        return true;
+    }
+
+    // whether the last frame returned by Next decoded cleanly
+    bool LastDecoded() const
+    {
+        return bLastOk;
+    }
+
+    const std::vector<uint32_t>& Cells() const
+    {
+        return decoder.Cells();
+    }
+
+private:
+    FILE* f = nullptr;
+    std::vector<uint8_t> payload;
+    FrameStreamDecoder decoder;
+    bool bLastOk = false;
+};
+
+
+// Frame output that codes every presented frame into a stream file or pipe. The game
+// thread only codes the frame into a slot of a bounded ring (AsyncWriteRing, see
+// framesink.h); a writer thread sends it, so a slow link only holds up rendering once
+// every slot is waiting on it. The writer flushes whenever it has caught up, so a viewer
+// at the other end sees each frame as soon as the link has carried it
+class FrameStreamWriter : public olcFrameOutput
+{
+public:
+    struct stats
+    {
+        uint64_t nFrames = 0;
+        uint64_t nKeyFrames = 0;
+        // uncompressed cell bytes vs bytes written (record headers included)
+        uint64_t nRawBytes = 0;
+        uint64_t nBytes = 0;
+        double fEncodeSeconds = 0.0;
+        // time rendering waited for the writer, with every slot full
+        double fStallSeconds = 0.0;
+        // frames lost to write errors; bWriteError alone means the final flush failed
+        uint64_t nFailed = 0;
+        bool bWriteError = false;
+    };
+
+    ~FrameStreamWriter()
+    {
+        Close();
+    }
+
+    // sPath "-" writes to stdout. nSlots coded frames can be queued before rendering waits
+    bool Open(const char* sPath, int nKeyInterval = 120, int nSlots = 8)
+    {
+        Close();
+        bStdout = sPath[0] == '-' && sPath[1] == 0;
+        f = bStdout ? stdout : fopen(sPath, "wb");
+        if (f == nullptr)
+            return false;
+        nKeyEvery = nKeyInterval;
+        st = stats();
+        encoder.Reset();
+        bHeader = false;
+        ring.Start(f, nSlots, 0, true);
+        return true;
+    }
+
+    // send every queued frame and stop the writer
+    void Close()
+    {
+        if (f == nullptr)
+            return;
+        ring.Close();
+        if (!bStdout)
+            fclose(f);
+        f = nullptr;
+    }
+
+    void OnFrame(const olcFrame& frame) override
+    {
+        if (f == nullptr)
+            return;
+
+        // waits only when the writer is behind by the whole ring
+        std::vector<uint8_t>& record = ring.Acquire();
+        record.clear();
+
+        auto t0 = std::chrono::steady_clock::now();
+
+        int nCells = frame.nWidth * frame.nHeight;
+        FRAMESTREAM_FORMAT format = frame.target == OUTPUT_LEGACY16 ? FRAMESTREAM_CELLS : FRAMESTREAM_RGBX;
+
+        // header goes out ahead of the first frame, once the geometry is known
+        if (!bHeader)
+        {
+            for (char c : FRAMESTREAM_MAGIC)
+                record.push_back((uint8_t)c);
+            streamPut16(record, FRAMESTREAM_VERSION);
+            streamPut16(record, format);
+            streamPut16(record, frame.nWidth);
+            streamPut16(record, frame.nHeight);
+            nStreamFormat = format;
+            bHeader = true;
+        }
+
+        // legacy cells are sent as they are, other targets as the colour they show
+        const uint32_t* pCells = (const uint32_t*)frame.pCells;
+        if (nStreamFormat == FRAMESTREAM_RGBX)
+        {
+            resolved.resize(nCells);
+            for (int i = 0; i < nCells; i++)
+                resolved[i] = frame.CellRGB(i);
+            pCells = resolved.data();
+        }
+
+        // record header, payload size patched in after coding
+        size_t nStart = record.size();
+        record.push_back(0);
+        streamPut32(record, (uint32_t)frame.nFrame);
+        streamPut32(record, 0);
+
+        bool bKey = nKeyEvery > 0 && st.nFrames % nKeyEvery == 0;
+        FRAMESTREAM_KIND kind = encoder.Encode(pCells, nCells, bKey, record);
+        uint32_t nPayload = (uint32_t)(record.size() - nStart - 9);
+        record[nStart] = (uint8_t)kind;
+        for (int b = 0; b < 4; b++)
+            record[nStart + 5 + b] = (uint8_t)(nPayload >> (8 * b));
+
+        st.fEncodeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        st.nFrames++;
+        st.nKeyFrames += kind == FRAMESTREAM_KEY;
+        st.nRawBytes += (uint64_t)nCells * 4;
+        st.nBytes += record.size();
+
+        ring.Publish();
+    }
+
+    stats Stats()
+    {
+        writeRingStats rs = ring.Stats();
+        st.fStallSeconds = rs.fStallSeconds;
+        st.nFailed = rs.nFailed;
+        st.bWriteError = rs.bError;
+        return st;
+    }
+
+private:
+    FILE* f = nullptr;
+    bool bStdout = false;
+    bool bHeader = false;
+    int nKeyEvery = 120;
+    FRAMESTREAM_FORMAT nStreamFormat = FRAMESTREAM_CELLS;
+    FrameStreamEncoder encoder;
+    // coded frames on their way to the file
+    AsyncWriteRing ring;
+    std::vector<uint32_t> resolved;
+    stats st;
+};
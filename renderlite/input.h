@@ -0,0 +1,290 @@
+// input.h : input events and the queue that carries them from the engine's input thread
+// to the game thread.
+//
+// The input thread blocks on the console (ReadConsoleInput on Windows, a raw-mode tty
+// on POSIX), stamps every event with the time it was read and pushes it into an
+// SpscQueue. Once per frame the game thread pops whatever arrived and folds it into
+// m_keys / m_mouse, so a frame only pays for the events that actually happened.
+//
+// TerminalInputDecoder turns the raw bytes a terminal sends into the same events:
+// plain keys, CSI/SS3 cursor keys, SGR mouse reports, focus reports and, where the
+// terminal supports it, kitty keyboard protocol press/repeat/release reports.
+
+#pragma once
+
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <string>
+#include "spscqueue.h"
+
+enum INPUT_EVENT_TYPE : uint8_t
+{
+    INPUT_KEY,
+    INPUT_MOUSE_MOVE,
+    INPUT_MOUSE_BUTTON,
+    INPUT_FOCUS,
+};
+
+struct inputEvent
+{
+    uint8_t type;
+    // key / button went down, or focus was gained
+    uint8_t bDown;
+    // virtual key code (0..255) or mouse button (0..4)
+    uint16_t nCode;
+    int16_t x;
+    int16_t y;
+    // steady_clock time the input thread read the event, for latency accounting
+    int64_t nTimeNs;
+};
+
+inline int64_t inputNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+// Terminals only send bytes when a key goes down (and again on autorepeat), never when
+// it comes up. Unless the terminal speaks the kitty keyboard protocol, a key is held
+// from its first byte until autorepeat stops: long enough to cover the initial repeat
+// delay, then a short window after each repeat.
+static const int64_t TERM_KEY_HOLD_FIRST_NS = 550 * 1000000LL;
+static const int64_t TERM_KEY_HOLD_REPEAT_NS = 100 * 1000000LL;
+// a lone ESC with nothing after it for this long is the Escape key, not a sequence
+static const int64_t TERM_ESC_TIMEOUT_NS = 25 * 1000000LL;
+
+class TerminalInputDecoder
+{
+public:
+    // decode bytes read from the terminal, calling emit(const inputEvent&) per event
+    template <typename F>
+    void Feed(const char* p, size_t n, int64_t now, F&& emit)
+    {
+        pending.append(p, n);
+        tPending = now;
+
+        size_t i = 0;
+        while (i < pending.size())
+        {
+            size_t used = Decode(i, now, emit);
+            if (used == 0)
+                break;  // incomplete sequence, wait for the rest
+            i += used;
+        }
+        pending.erase(0, i);
+    }
+
+    // release keys whose autorepeat has stopped and flush a stale lone ESC
+    template <typename F>
+    void Expire(int64_t now, F&& emit)
+    {
+        if (!pending.empty() && now - tPending > TERM_ESC_TIMEOUT_NS)
+        {
+            if (pending.size() == 1 && pending[0] == 0x1B)
+            {
+                Key(0x1B, 1, now, emit);
+                nDeadline[0x1B] = now;
+            }
+            pending.clear();
+        }
+
+        if (nKeysDown == 0)
+            return;
+        for (int k = 0; k < 256; k++)
+            if (bKeyDown[k] && now >= nDeadline[k])
+                Key(k, 3, now, emit);
+    }
+
+    // true while something is waiting on a timeout, so the caller should poll often
+    bool Busy() const
+    {
+        return nKeysDown > 0 || !pending.empty();
+    }
+
+private:
+    std::string pending;
+    int64_t tPending = 0;
+    bool bKeyDown[256] = { false };
+    int64_t nDeadline[256] = { 0 };
+    int nKeysDown = 0;
+    // set once the terminal has sent a kitty release report: it tells us about key-ups
+    bool bReleaseReports = false;
+
+    // event: 1 press, 2 repeat, 3 release (kitty numbering)
+    template <typename F>
+    void Key(int vk, int event, int64_t now, F&& emit)
+    {
+        if (vk <= 0 || vk > 255)
+            return;
+
+        if (event == 3)
+        {
+            if (!bKeyDown[vk])
+                return;
+            bKeyDown[vk] = false;
+            nKeysDown--;
+            emit(inputEvent{ INPUT_KEY, 0, (uint16_t)vk, 0, 0, now });
+            return;
+        }
+
+        if (!bKeyDown[vk])
+        {
+            bKeyDown[vk] = true;
+            nKeysDown++;
+            nDeadline[vk] = now + TERM_KEY_HOLD_FIRST_NS;
+            emit(inputEvent{ INPUT_KEY, 1, (uint16_t)vk, 0, 0, now });
+        }
+        else
+            nDeadline[vk] = now + TERM_KEY_HOLD_REPEAT_NS;
+
+        if (bReleaseReports)
+            nDeadline[vk] = INT64_MAX;
+    }
+
+    // a character (or kitty key code) to the virtual key it stands for, 0 if none
+    static int CharToVK(uint32_t c)
+    {
+        if (c >= 'a' && c <= 'z') return (int)(c - 'a' + 'A');
+        if (c >= 'A' && c <= 'Z') return (int)c;
+        if (c >= '0' && c <= '9') return (int)c;
+        switch (c)
+        {
+        case ' ': return 0x20;          // VK_SPACE
+        case '\r': case '\n': return 0x0D;  // VK_RETURN
+        case '\t': return 0x09;         // VK_TAB
+        case 0x7F: case 0x08: return 0x08;  // VK_BACK
+        case 0x1B: return 0x1B;         // VK_ESCAPE
+        default: break;
+        }
+        // Ctrl+letter
+        if (c >= 1 && c <= 26) return (int)(c - 1 + 'A');
+        return 0;
+    }
+
+    // cursor key final byte to VK_UP / VK_DOWN / VK_RIGHT / VK_LEFT
+    static int ArrowToVK(char c)
+    {
+        switch (c)
+        {
+        case 'A': return 0x26;
+        case 'B': return 0x28;
+        case 'C': return 0x27;
+        case 'D': return 0x25;
+        default: return 0;
+        }
+    }
+
+    // decode one event starting at pending[i], returns bytes used (0 = incomplete)
+    template <typename F>
+    size_t Decode(size_t i, int64_t now, F&& emit)
+    {
+        unsigned char c = (unsigned char)pending[i];
+        if (c != 0x1B)
+        {
+            // UTF-8 text has no virtual key, skip it a byte at a time
+            if (c < 0x80)
+                Key(CharToVK(c), 1, now, emit);
+            return 1;
+        }
+
+        if (i + 1 >= pending.size())
+            return 0;
+
+        char next = pending[i + 1];
+        if (next == 'O')
+        {
+            // SS3 cursor keys (application cursor mode)
+            if (i + 2 >= pending.size())
+                return 0;
+            Key(ArrowToVK(pending[i + 2]), 1, now, emit);
+            return 3;
+        }
+        if (next != '[')
+        {
+            // Alt+key arrives as ESC key; treat it as Escape followed by the key
+            Key(0x1B, 1, now, emit);
+            return 1;
+        }
+
+        // CSI: parameter bytes up to a final byte in 0x40..0x7E
+        size_t j = i + 2;
+        while (j < pending.size() && !((unsigned char)pending[j] >= 0x40 && (unsigned char)pending[j] <= 0x7E))
+            j++;
+        if (j >= pending.size())
+            return pending.size() - i > 32 ? 1 : 0;
+
+        Csi(pending.data() + i + 2, j - (i + 2), pending[j], now, emit);
+        return j - i + 1;
+    }
+
+    // params is the text between "ESC [" and the final byte
+    template <typename F>
+    void Csi(const char* params, size_t n, char final, int64_t now, F&& emit)
+    {
+        bool bPrivate = n > 0 && params[0] == '<';
+        if (bPrivate)
+        {
+            params++;
+            n--;
+        }
+
+        // up to 4 ';' separated fields, each with an optional ':' sub-field
+        int field[4] = { 0, 0, 0, 0 };
+        int sub[4] = { 0, 0, 0, 0 };
+        int nField = 0;
+        bool bSub = false;
+        for (size_t k = 0; k < n && nField < 4; k++)
+        {
+            char ch = params[k];
+            if (ch == ';') { nField++; bSub = false; }
+            else if (ch == ':') bSub = true;
+            else if (ch >= '0' && ch <= '9')
+            {
+                int& v = bSub ? sub[nField] : field[nField];
+                v = v * 10 + (ch - '0');
+            }
+        }
+
+        // SGR mouse report: ESC [ < b ; x ; y M (press / motion) or m (release)
+        if (bPrivate && (final == 'M' || final == 'm'))
+        {
+            int b = field[0];
+            int16_t x = (int16_t)(field[1] - 1);
+            int16_t y = (int16_t)(field[2] - 1);
+            emit(inputEvent{ INPUT_MOUSE_MOVE, 0, 0, x, y, now });
+
+            // wheel and plain motion carry no button change
+            if (b & (64 | 32))
+                return;
+            // terminal order is left, middle, right; the console's is left, right, middle
+            static const uint16_t button[4] = { 0, 2, 1, 0 };
+            if ((b & 3) != 3)
+                emit(inputEvent{ INPUT_MOUSE_BUTTON, (uint8_t)(final == 'M'), button[b & 3], x, y, now });
+            return;
+        }
+
+        // focus reports
+        if (n == 0 && (final == 'I' || final == 'O'))
+        {
+            emit(inputEvent{ INPUT_FOCUS, (uint8_t)(final == 'I'), 0, 0, 0, now });
+            return;
+        }
+
+        // kitty key event: ESC [ code ; mods : event u, and ESC [ 1 ; mods : event A..D
+        int event = sub[1] ? sub[1] : 1;
+        if (event == 3)
+            bReleaseReports = true;
+
+        // with every key reported as an escape code the tty no longer turns Ctrl+C into
+        // SIGINT, so do it here
+        if (final == 'u' && field[0] == 'c' && field[1] > 0 && ((field[1] - 1) & 4) && event != 3)
+            raise(SIGINT);
+
+        if (final == 'u')
+            Key(CharToVK((uint32_t)field[0]), event, now, emit);
+        else
+            Key(ArrowToVK(final), event, now, emit);
+    }
+};
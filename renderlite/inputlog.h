@@ -0,0 +1,279 @@
+// inputlog.h : records the input and frame time every frame saw, and plays them back.
+//
+// A recording holds, per frame, the fElapsedTime OnUserUpdate was given, the key / mouse
+// state it saw (as changes from the previous frame), and a hash of what it drew.
+// Replaying feeds the same state and time steps back in place of the keyboard and the
+// clock, so the app renders the same frames on any build, and any frame whose hash no
+// longer matches is reported.
+//
+//   log    := "RLIN" u16 version, u16 width, u16 height, frame*
+//   frame  := f32 elapsed time, u8 flags, u16 changes, change*, [i16 x, i16 y], u32 hash
+//   change := u16 (slot << 3 | held << 2 | released << 1 | pressed)
+//   flags  := 1 mouse moved (x, y follow), 2 focus changed, 4 focus (after the change)
+//
+// Slots 0..255 are virtual keys, 256..260 mouse buttons. All integers little-endian.
+// A frame where nothing changed costs 11 bytes.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static const char INPUTLOG_MAGIC[4] = { 'R', 'L', 'I', 'N' };
+static const uint16_t INPUTLOG_VERSION = 1;
+static const int INPUTLOG_SLOTS = 256 + 5;
+
+enum INPUTLOG_BITS : uint8_t
+{
+    INPUTLOG_PRESSED = 1,
+    INPUTLOG_RELEASED = 2,
+    INPUTLOG_HELD = 4,
+};
+
+// everything OnUserUpdate can read about input in one frame
+struct inputLogState
+{
+    // INPUTLOG_* bits per key, then per mouse button
+    uint8_t slot[INPUTLOG_SLOTS] = {};
+    int16_t nMouseX = 0;
+    int16_t nMouseY = 0;
+    bool bFocus = true;
+};
+
+// hash of a frame's buffers, 32-bit words at a time (FNV-1a over words)
+inline uint32_t inputLogHash(const uint32_t* p, size_t nWords, uint32_t h = 2166136261u)
+{
+    for (size_t i = 0; i < nWords; i++)
+        h = (h ^ p[i]) * 16777619u;
+    return h;
+}
+
+inline void inputLogPut16(std::vector<uint8_t>& out, uint32_t v)
+{
+    out.push_back((uint8_t)v);
+    out.push_back((uint8_t)(v >> 8));
+}
+
+inline void inputLogPut32(std::vector<uint8_t>& out, uint32_t v)
+{
+    inputLogPut16(out, v);
+    inputLogPut16(out, v >> 16);
+}
+
+inline uint32_t inputLogGet16(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8);
+}
+
+inline uint32_t inputLogGet32(const uint8_t* p)
+{
+    return inputLogGet16(p) | (inputLogGet16(p + 2) << 16);
+}
+
+
+class InputRecorder
+{
+public:
+    ~InputRecorder()
+    {
+        Close();
+    }
+
+    bool Open(const char* sPath, int width, int height)
+    {
+        Close();
+        f = fopen(sPath, "wb");
+        if (f == nullptr)
+            return false;
+
+        std::vector<uint8_t> header(INPUTLOG_MAGIC, INPUTLOG_MAGIC + 4);
+        inputLogPut16(header, INPUTLOG_VERSION);
+        inputLogPut16(header, width);
+        inputLogPut16(header, height);
+        fwrite(header.data(), 1, header.size(), f);
+
+        last = inputLogState();
+        nFrames = 0;
+        nBytes = header.size();
+        return true;
+    }
+
+    void Close()
+    {
+        if (f == nullptr)
+            return;
+        fclose(f);
+        f = nullptr;
+    }
+
+    bool IsOpen() const
+    {
+        return f != nullptr;
+    }
+
+    // the input state OnUserUpdate is about to see, and its time step
+    void BeginFrame(float fElapsedTime, const inputLogState& state)
+    {
+        record.clear();
+        uint32_t bits;
+        memcpy(&bits, &fElapsedTime, 4);
+        inputLogPut32(record, bits);
+
+        uint8_t flags = 0;
+        if (state.nMouseX != last.nMouseX || state.nMouseY != last.nMouseY)
+            flags |= 1;
+        if (state.bFocus != last.bFocus)
+            flags |= 2;
+        if (state.bFocus)
+            flags |= 4;
+        record.push_back(flags);
+
+        size_t nCountAt = record.size();
+        inputLogPut16(record, 0);
+        uint32_t nChanges = 0;
+        for (int i = 0; i < INPUTLOG_SLOTS; i++)
+            if (state.slot[i] != last.slot[i])
+            {
+                inputLogPut16(record, (uint32_t)i << 3 | state.slot[i]);
+                nChanges++;
+            }
+        record[nCountAt] = (uint8_t)nChanges;
+        record[nCountAt + 1] = (uint8_t)(nChanges >> 8);
+
+        if (flags & 1)
+        {
+            inputLogPut16(record, (uint16_t)state.nMouseX);
+            inputLogPut16(record, (uint16_t)state.nMouseY);
+        }
+        last = state;
+    }
+
+    // hash of what the frame drew, completes the record
+    void EndFrame(uint32_t hash)
+    {
+        inputLogPut32(record, hash);
+        fwrite(record.data(), 1, record.size(), f);
+        nFrames++;
+        nBytes += record.size();
+    }
+
+    uint64_t Frames() const { return nFrames; }
+    uint64_t Bytes() const { return nBytes; }
+
+private:
+    FILE* f = nullptr;
+    inputLogState last;
+    std::vector<uint8_t> record;
+    uint64_t nFrames = 0;
+    uint64_t nBytes = 0;
+};
+
+
+class InputReplayer
+{
+public:
+    int nWidth = 0;
+    int nHeight = 0;
+
+    // reads the whole log, they are small
+    bool Open(const char* sPath)
+    {
+        Close();
+        FILE* f = fopen(sPath, "rb");
+        if (f == nullptr)
+            return false;
+        uint8_t buf[4096];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+            data.insert(data.end(), buf, buf + n);
+        fclose(f);
+
+        if (data.size() < 10 || memcmp(data.data(), INPUTLOG_MAGIC, 4) != 0 || inputLogGet16(&data[4]) != INPUTLOG_VERSION)
+        {
+            data.clear();
+            return false;
+        }
+        nWidth = inputLogGet16(&data[6]);
+        nHeight = inputLogGet16(&data[8]);
+        nPos = 10;
+        state = inputLogState();
+        nFrames = nMismatches = 0;
+        nFirstMismatch = -1;
+        return true;
+    }
+
+    void Close()
+    {
+        data.clear();
+        nPos = 0;
+    }
+
+    bool IsOpen() const
+    {
+        return !data.empty();
+    }
+
+    // the next frame's input state and time step, false at the end of the log
+    bool NextFrame(float& fElapsedTime, inputLogState& out)
+    {
+        if (nPos + 7 > data.size())
+            return false;
+
+        const uint8_t* p = &data[nPos];
+        uint32_t bits = inputLogGet32(p);
+        uint8_t flags = p[4];
+        uint32_t nChanges = inputLogGet16(p + 5);
+        size_t nSize = 7 + nChanges * 2 + ((flags & 1) ? 4 : 0) + 4;
+        if (nPos + nSize > data.size())
+            return false;
+
+        memcpy(&fElapsedTime, &bits, 4);
+        p += 7;
+        for (uint32_t i = 0; i < nChanges; i++, p += 2)
+        {
+            uint32_t change = inputLogGet16(p);
+            if ((change >> 3) < INPUTLOG_SLOTS)
+                state.slot[change >> 3] = change & 7;
+        }
+        if (flags & 1)
+        {
+            state.nMouseX = (int16_t)inputLogGet16(p);
+            state.nMouseY = (int16_t)inputLogGet16(p + 2);
+            p += 4;
+        }
+        state.bFocus = (flags & 4) != 0;
+        expectedHash = inputLogGet32(p);
+
+        nPos += nSize;
+        out = state;
+        return true;
+    }
+
+    // compare what the frame from NextFrame drew against the recording
+    void CheckFrame(uint32_t hash)
+    {
+        if (hash != expectedHash)
+        {
+            if (nFirstMismatch < 0)
+                nFirstMismatch = (int64_t)nFrames;
+            nMismatches++;
+        }
+        nFrames++;
+    }
+
+    uint64_t Frames() const { return nFrames; }
+    uint64_t Mismatches() const { return nMismatches; }
+    // -1 if every checked frame matched
+    int64_t FirstMismatch() const { return nFirstMismatch; }
+
+private:
+    std::vector<uint8_t> data;
+    size_t nPos = 0;
+    inputLogState state;
+    uint32_t expectedHash = 0;
+    uint64_t nFrames = 0;
+    uint64_t nMismatches = 0;
+    int64_t nFirstMismatch = -1;
+};
@@ -0,0 +1,469 @@
+// lod.h : level-of-detail chains made by quadric edge-collapse simplification.
+//
+// lodSimplifier reduces a mesh by collapsing, one at a time, the edge whose removal moves
+// the surface least, measured by the quadric error metric of Garland and Heckbert. Every
+// vertex carries the sum of the squared distances to the planes of the triangles around
+// it, weighted by their area; merging two vertices adds their sums and puts the merged
+// vertex where the total is smallest. Edges on an open boundary (the rim of a terrain)
+// add planes at right angles to their triangle, so the rim holds its shape instead of
+// being eaten inwards; or, for pieces of a larger surface that must keep meeting their
+// neighbours exactly (terrain chunks), the rim can be locked so it never moves at all.
+// A collapse that would fold a triangle over, or join two sheets of the surface, is
+// skipped.
+//
+// lodChain runs one simplifier down through a sequence of triangle counts, each about
+// half the one before, and copies the mesh out at each. Each level records the worst
+// error of any collapse so far: the RMS distance, in model units, from a merged vertex
+// to the planes it stands for. Projecting that to the screen tells a renderer whether a
+// level is good enough at a given distance (see Scene::SelectLods).
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+#include "mesh.h"
+
+// boundary planes count this many times a triangle of the same size, which keeps rims
+// in place until little else is left to collapse
+static const double LOD_BOUNDARY_WEIGHT = 10.0;
+
+// sum over planes of w (n.p + d)^2, stored as the upper triangle of the symmetric 4x4
+// matrix it is a quadratic form of, plus the sum of the weights
+struct quadric
+{
+    double a[10] = {};
+    double w = 0.0;
+
+    void AddPlane(double nx, double ny, double nz, double d, double fWeight)
+    {
+        a[0] += fWeight * nx * nx; a[1] += fWeight * nx * ny; a[2] += fWeight * nx * nz; a[3] += fWeight * nx * d;
+        a[4] += fWeight * ny * ny; a[5] += fWeight * ny * nz; a[6] += fWeight * ny * d;
+        a[7] += fWeight * nz * nz; a[8] += fWeight * nz * d;
+        a[9] += fWeight * d * d;
+        w += fWeight;
+    }
+
+    void Add(const quadric& q)
+    {
+        for (int i = 0; i < 10; i++)
+            a[i] += q.a[i];
+        w += q.w;
+    }
+
+    double Error(double x, double y, double z) const
+    {
+        return a[0] * x * x + 2.0 * a[1] * x * y + 2.0 * a[2] * x * z + 2.0 * a[3] * x +
+            a[4] * y * y + 2.0 * a[5] * y * z + 2.0 * a[6] * y +
+            a[7] * z * z + 2.0 * a[8] * z + a[9];
+    }
+
+    // the point of least error; false where there is no single one (the planes are all
+    // parallel, or meet along a line)
+    bool Optimum(double& x, double& y, double& z) const
+    {
+        // solve [a0 a1 a2; a1 a4 a5; a2 a5 a7] p = -(a3, a6, a8) by Cramer's rule
+        double c0 = a[4] * a[7] - a[5] * a[5];
+        double c1 = a[2] * a[5] - a[1] * a[7];
+        double c2 = a[1] * a[5] - a[2] * a[4];
+        double det = a[0] * c0 + a[1] * c1 + a[2] * c2;
+        double fScale = a[0] + a[4] + a[7];
+        if (fabs(det) <= 1e-6 * fScale * fScale * fScale)
+            return false;
+        double c4 = a[0] * a[7] - a[2] * a[2];
+        double c5 = a[1] * a[2] - a[0] * a[5];
+        double c8 = a[0] * a[4] - a[1] * a[1];
+        x = -(c0 * a[3] + c1 * a[6] + c2 * a[8]) / det;
+        y = -(c1 * a[3] + c4 * a[6] + c5 * a[8]) / det;
+        z = -(c2 * a[3] + c5 * a[6] + c8 * a[8]) / det;
+        return true;
+    }
+};
+
+class lodSimplifier
+{
+public:
+    // start from the triangles of m; corners at the same position become one vertex.
+    // bLockBoundary keeps every vertex on an open edge where it is
+    void Init(const mesh& m, bool bLockBoundary = false)
+    {
+        vecPos.clear();
+        vecFaces.clear();
+        std::unordered_map<uint64_t, std::vector<int>> weld;
+        for (const triangle& t : m.tris)
+        {
+            face f;
+            for (int k = 0; k < 3; k++)
+                f.v[k] = Weld(weld, t.p[k]);
+            f.bDead = f.v[0] == f.v[1] || f.v[1] == f.v[2] || f.v[2] == f.v[0];
+            vecFaces.push_back(f);
+        }
+
+        size_t nVerts = vecPos.size();
+        vecQuadric.assign(nVerts, quadric());
+        vecStamp.assign(nVerts, 0);
+        vecDead.assign(nVerts, false);
+        vecLocked.assign(nVerts, false);
+        vecVertFaces.assign(nVerts, std::vector<int>());
+        nLive = 0;
+        fMaxError = 0.0;
+
+        std::unordered_map<uint64_t, int> edgeFaces;
+        for (int i = 0; i < (int)vecFaces.size(); i++)
+        {
+            const face& f = vecFaces[i];
+            if (f.bDead)
+                continue;
+            nLive++;
+            double n[3];
+            double fArea = Normal(vecPos[f.v[0]], vecPos[f.v[1]], vecPos[f.v[2]], n);
+            double d = -(n[0] * vecPos[f.v[0]].x + n[1] * vecPos[f.v[0]].y + n[2] * vecPos[f.v[0]].z);
+            for (int k = 0; k < 3; k++)
+            {
+                vecQuadric[f.v[k]].AddPlane(n[0], n[1], n[2], d, fArea);
+                vecVertFaces[f.v[k]].push_back(i);
+                edgeFaces[EdgeKey(f.v[k], f.v[(k + 1) % 3])]++;
+            }
+        }
+
+        // a plane through each boundary edge, at right angles to its triangle
+        for (const face& f : vecFaces)
+        {
+            if (f.bDead)
+                continue;
+            double n[3];
+            Normal(vecPos[f.v[0]], vecPos[f.v[1]], vecPos[f.v[2]], n);
+            for (int k = 0; k < 3; k++)
+            {
+                int v0 = f.v[k], v1 = f.v[(k + 1) % 3];
+                if (edgeFaces[EdgeKey(v0, v1)] != 1)
+                    continue;
+                if (bLockBoundary)
+                {
+                    vecLocked[v0] = vecLocked[v1] = true;
+                    continue;
+                }
+                const vec3d& p0 = vecPos[v0];
+                const vec3d& p1 = vecPos[v1];
+                double e[3] = { (double)p1.x - p0.x, (double)p1.y - p0.y, (double)p1.z - p0.z };
+                double fLength2 = e[0] * e[0] + e[1] * e[1] + e[2] * e[2];
+                double b[3] = { e[1] * n[2] - e[2] * n[1], e[2] * n[0] - e[0] * n[2], e[0] * n[1] - e[1] * n[0] };
+                double fLen = sqrt(b[0] * b[0] + b[1] * b[1] + b[2] * b[2]);
+                if (fLen <= 0.0)
+                    continue;
+                for (double& c : b)
+                    c /= fLen;
+                double d = -(b[0] * p0.x + b[1] * p0.y + b[2] * p0.z);
+                vecQuadric[v0].AddPlane(b[0], b[1], b[2], d, LOD_BOUNDARY_WEIGHT * fLength2);
+                vecQuadric[v1].AddPlane(b[0], b[1], b[2], d, LOD_BOUNDARY_WEIGHT * fLength2);
+            }
+        }
+
+        heap = decltype(heap)();
+        for (const auto& e : edgeFaces)
+            Push((int)(e.first >> 32), (int)(e.first & 0xFFFFFFFF));
+    }
+
+    // collapse edges, cheapest first, until at most nTarget triangles are left or no
+    // collapse is allowed; returns the triangles left
+    size_t Simplify(size_t nTarget)
+    {
+        std::vector<int> vecNeighbours;
+        while (nLive > nTarget && !heap.empty())
+        {
+            candidate c = heap.top();
+            heap.pop();
+            if (vecDead[c.v0] || vecDead[c.v1] || vecStamp[c.v0] != c.n0 || vecStamp[c.v1] != c.n1)
+                continue;
+            if (!Allowed(c))
+                continue;
+
+            // v1 goes, v0 moves to the merged position and takes over v1's triangles
+            vec3d& p = vecPos[c.v0];
+            p.x = c.p[0];
+            p.y = c.p[1];
+            p.z = c.p[2];
+            vecQuadric[c.v0].Add(vecQuadric[c.v1]);
+            vecDead[c.v1] = true;
+            vecStamp[c.v0]++;
+            fMaxError = std::max(fMaxError, sqrt(std::max(c.fCost, 0.0) / std::max(vecQuadric[c.v0].w, 1e-30)));
+
+            for (int i : vecVertFaces[c.v1])
+            {
+                face& f = vecFaces[i];
+                if (f.bDead)
+                    continue;
+                if (f.v[0] == c.v0 || f.v[1] == c.v0 || f.v[2] == c.v0)
+                {
+                    f.bDead = true;
+                    nLive--;
+                    continue;
+                }
+                for (int& v : f.v)
+                    if (v == c.v1)
+                        v = c.v0;
+                vecVertFaces[c.v0].push_back(i);
+            }
+            vecVertFaces[c.v1].clear();
+            std::vector<int>& faces = vecVertFaces[c.v0];
+            faces.erase(std::remove_if(faces.begin(), faces.end(), [&](int i) { return vecFaces[i].bDead; }), faces.end());
+
+            // every edge at v0 costs something different now
+            Neighbours(c.v0, vecNeighbours);
+            for (int v : vecNeighbours)
+                Push(c.v0, v);
+        }
+        return nLive;
+    }
+
+    // the mesh as it stands, vertices renumbered in order of first use
+    mesh Extract() const
+    {
+        mesh m;
+        std::vector<int> vecMap(vecPos.size(), -1);
+        for (const face& f : vecFaces)
+        {
+            if (f.bDead)
+                continue;
+            triangle t = {};
+            for (int k = 0; k < 3; k++)
+            {
+                int& n = vecMap[f.v[k]];
+                if (n < 0)
+                {
+                    n = (int)m.verts.size();
+                    m.verts.push_back(vecPos[f.v[k]]);
+                }
+                m.idx.push_back(n);
+                t.p[k] = vecPos[f.v[k]];
+            }
+            m.tris.push_back(t);
+        }
+        return m;
+    }
+
+    // worst error of the collapses so far, as an RMS distance in model units
+    float Error() const { return (float)fMaxError; }
+    size_t Triangles() const { return nLive; }
+
+private:
+    struct face
+    {
+        int v[3];
+        bool bDead;
+    };
+
+    struct candidate
+    {
+        double fCost;
+        int v0, v1;
+        // the vertices' stamps when this was costed; stale once either moves on
+        uint32_t n0, n1;
+        double p[3];
+
+        bool operator>(const candidate& c) const { return fCost > c.fCost; }
+    };
+
+    std::vector<vec3d> vecPos;
+    std::vector<quadric> vecQuadric;
+    std::vector<uint32_t> vecStamp;
+    std::vector<bool> vecDead;
+    std::vector<bool> vecLocked;
+    std::vector<face> vecFaces;
+    std::vector<std::vector<int>> vecVertFaces;
+    std::priority_queue<candidate, std::vector<candidate>, std::greater<candidate>> heap;
+    size_t nLive = 0;
+    double fMaxError = 0.0;
+
+    static uint64_t EdgeKey(int v0, int v1)
+    {
+        return ((uint64_t)std::min(v0, v1) << 32) | (uint32_t)std::max(v0, v1);
+    }
+
+    // unit normal of a triangle in n, returns its area
+    static double Normal(const vec3d& a, const vec3d& b, const vec3d& c, double n[3])
+    {
+        double u[3] = { (double)b.x - a.x, (double)b.y - a.y, (double)b.z - a.z };
+        double v[3] = { (double)c.x - a.x, (double)c.y - a.y, (double)c.z - a.z };
+        n[0] = u[1] * v[2] - u[2] * v[1];
+        n[1] = u[2] * v[0] - u[0] * v[2];
+        n[2] = u[0] * v[1] - u[1] * v[0];
+        double fLen = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (fLen > 0.0)
+            for (int k = 0; k < 3; k++)
+                n[k] /= fLen;
+        return fLen * 0.5;
+    }
+
+    int Weld(std::unordered_map<uint64_t, std::vector<int>>& weld, const vec3d& p)
+    {
+        uint32_t b[3];
+        memcpy(&b[0], &p.x, 4);
+        memcpy(&b[1], &p.y, 4);
+        memcpy(&b[2], &p.z, 4);
+        uint64_t h = (uint64_t)b[0] * 0x9E3779B97F4A7C15ull ^ (uint64_t)b[1] * 0xC2B2AE3D27D4EB4Full ^ b[2];
+        std::vector<int>& bucket = weld[h];
+        for (int v : bucket)
+            if (vecPos[v].x == p.x && vecPos[v].y == p.y && vecPos[v].z == p.z)
+                return v;
+        bucket.push_back((int)vecPos.size());
+        vecPos.push_back({ p.x, p.y, p.z });
+        return bucket.back();
+    }
+
+    void Neighbours(int v, std::vector<int>& vecOut) const
+    {
+        vecOut.clear();
+        for (int i : vecVertFaces[v])
+        {
+            const face& f = vecFaces[i];
+            if (f.bDead)
+                continue;
+            for (int u : f.v)
+                if (u != v && std::find(vecOut.begin(), vecOut.end(), u) == vecOut.end())
+                    vecOut.push_back(u);
+        }
+    }
+
+    // cost the collapse of edge v0-v1 and queue it
+    void Push(int v0, int v1)
+    {
+        if (vecLocked[v0] && vecLocked[v1])
+            return;
+        // a locked end stays, and is the one kept
+        if (vecLocked[v1])
+            std::swap(v0, v1);
+        quadric q = vecQuadric[v0];
+        q.Add(vecQuadric[v1]);
+        const vec3d& p0 = vecPos[v0];
+        const vec3d& p1 = vecPos[v1];
+        double fLength2 = (double)(p1.x - p0.x) * (p1.x - p0.x) + (double)(p1.y - p0.y) * (p1.y - p0.y) + (double)(p1.z - p0.z) * (p1.z - p0.z);
+        double mid[3] = { (p0.x + p1.x) * 0.5, (p0.y + p1.y) * 0.5, (p0.z + p1.z) * 0.5 };
+
+        candidate c;
+        c.v0 = v0;
+        c.v1 = v1;
+        c.n0 = vecStamp[v0];
+        c.n1 = vecStamp[v1];
+        double x, y, z;
+        if (vecLocked[v0])
+        {
+            c.p[0] = p0.x;
+            c.p[1] = p0.y;
+            c.p[2] = p0.z;
+            c.fCost = q.Error(p0.x, p0.y, p0.z);
+        }
+        // take the optimum only if it is near the edge: a nearly flat or nearly straight
+        // patch puts it far off for little gain
+        else if (q.Optimum(x, y, z) &&
+            (x - mid[0]) * (x - mid[0]) + (y - mid[1]) * (y - mid[1]) + (z - mid[2]) * (z - mid[2]) <= fLength2)
+        {
+            c.p[0] = x;
+            c.p[1] = y;
+            c.p[2] = z;
+            c.fCost = q.Error(x, y, z);
+        }
+        else
+        {
+            // otherwise the best of the ends and the middle
+            const double ends[3][3] = { { p0.x, p0.y, p0.z }, { p1.x, p1.y, p1.z }, { mid[0], mid[1], mid[2] } };
+            c.fCost = INFINITY;
+            for (const auto& e : ends)
+            {
+                double fCost = q.Error(e[0], e[1], e[2]);
+                if (fCost < c.fCost)
+                {
+                    c.fCost = fCost;
+                    memcpy(c.p, e, sizeof(c.p));
+                }
+            }
+        }
+        heap.push(c);
+    }
+
+    // whether collapsing c keeps the surface a surface, facing the way it did
+    bool Allowed(const candidate& c) const
+    {
+        // link condition: the ends may share only the vertices across the triangles on
+        // the edge, or the collapse pinches the surface
+        std::vector<int> n0, n1;
+        Neighbours(c.v0, n0);
+        Neighbours(c.v1, n1);
+        int nShared = 0;
+        for (int v : n0)
+            nShared += std::find(n1.begin(), n1.end(), v) != n1.end();
+        int nEdgeFaces = 0;
+        for (int i : vecVertFaces[c.v0])
+        {
+            const face& f = vecFaces[i];
+            nEdgeFaces += !f.bDead && (f.v[0] == c.v1 || f.v[1] == c.v1 || f.v[2] == c.v1);
+        }
+        if (nShared > nEdgeFaces)
+            return false;
+
+        // no triangle that survives may turn over
+        vec3d p = { (float)c.p[0], (float)c.p[1], (float)c.p[2] };
+        for (int v : { c.v0, c.v1 })
+            for (int i : vecVertFaces[v])
+            {
+                const face& f = vecFaces[i];
+                if (f.bDead)
+                    continue;
+                bool bOther = false;
+                vec3d q[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    bool bMoves = f.v[k] == c.v0 || f.v[k] == c.v1;
+                    bOther |= bMoves && f.v[k] != v;
+                    q[k] = bMoves ? p : vecPos[f.v[k]];
+                }
+                // the triangles on the edge go anyway
+                if (bOther)
+                    continue;
+                double nBefore[3], nAfter[3];
+                Normal(vecPos[f.v[0]], vecPos[f.v[1]], vecPos[f.v[2]], nBefore);
+                if (Normal(q[0], q[1], q[2], nAfter) <= 0.0 ||
+                    nBefore[0] * nAfter[0] + nBefore[1] * nAfter[1] + nBefore[2] * nAfter[2] < 0.2)
+                    return false;
+            }
+        return true;
+    }
+};
+
+struct lodLevel
+{
+    mesh m;
+    // worst simplification error, in model units (0 for the original)
+    float fError;
+};
+
+// the mesh and up to nLevels simplified versions of it, each aiming for fRatio times the
+// triangles of the one before, stopping early below nMinTris triangles or when the
+// simplifier can no longer make much progress. bLockBoundary keeps open edges exactly
+// as they are at every level (see lodSimplifier::Init)
+inline std::vector<lodLevel> lodChain(const mesh& m, int nLevels, float fRatio = 0.5f, size_t nMinTris = 32,
+    bool bLockBoundary = false)
+{
+    std::vector<lodLevel> levels;
+    levels.push_back({ m, 0.0f });
+    lodSimplifier simplifier;
+    simplifier.Init(m, bLockBoundary);
+    size_t nTris = m.tris.size();
+    for (int l = 1; l <= nLevels; l++)
+    {
+        size_t nTarget = (size_t)(nTris * fRatio);
+        if (nTarget < nMinTris)
+            break;
+        size_t nLeft = simplifier.Simplify(nTarget);
+        // stuck: a level hardly smaller than the last is not worth its memory
+        if (nLeft > nTris - nTris / 10)
+            break;
+        levels.push_back({ simplifier.Extract(), simplifier.Error() });
+        nTris = nLeft;
+    }
+    return levels;
+}
@@ -0,0 +1,198 @@
+// mesh.h : the renderer's geometry: points, triangles, 4x4 matrices and meshes read from OBJ.
+//
+// A mesh keeps its triangles whole (tris) for code that walks them one by one, and also
+// as shared vertices plus three corner indices per triangle (verts, idx), so a renderer
+// drawing it many times can transform each vertex once and assemble the triangles from
+// the results (see scene.h).
+//
+// Pack() trades both for a compact form (packedMesh) for meshes too big to keep as
+// floats: every position as three 16-bit steps across the mesh's bounds, and the corners
+// as 16-bit indices where there are no more than 65536 vertices, 32-bit where there are.
+// That is 6 bytes a vertex and 6 or 12 a triangle, against 16 a vertex and 64 a
+// triangle unpacked. A renderer decodes the positions as it transforms them (see
+// transformPacked), so they are never floats in memory. Each position moves by at most
+// half a step, 1/131070 of the mesh's extent along each axis.
+
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <strstream>
+#include <vector>
+
+struct vec3d
+{
+    float x = 0;
+    float y = 0;
+    float z = 0;
+    // 4th term for easy matrix-vector multiplication
+    float w = 1;
+};
+
+struct triangle
+{
+    vec3d p[3];
+
+    // triangle shade (packed 8-bit rgb, see shadeRGB)
+    uint32_t col;
+};
+
+struct mat4x4
+{
+    // 4x4 matrix
+    float m[4][4] = { 0 };
+};
+
+struct packedMesh
+{
+    // x, y, z of each vertex in steps of vStep from vOrigin, and one spare entry after
+    // the last, so a SIMD decode can read each vertex as 8 bytes
+    std::vector<uint16_t> pos;
+    vec3d vOrigin;
+    vec3d vStep;
+    // three corners per triangle, in idx16 if every vertex fits 16 bits, else idx32
+    std::vector<uint16_t> idx16;
+    std::vector<uint32_t> idx32;
+    size_t nVerts = 0;
+    size_t nTris = 0;
+};
+
+struct mesh
+{
+    std::vector<triangle> tris;
+    // the same triangles as corners into verts, three per triangle, in the order of tris
+    std::vector<vec3d> verts;
+    std::vector<int> idx;
+    // the mesh once Pack() has been called, with tris, verts and idx empty
+    packedMesh packed;
+
+    bool Packed() const { return packed.nTris > 0; }
+    size_t Triangles() const { return Packed() ? packed.nTris : tris.size(); }
+    size_t Vertices() const { return Packed() ? packed.nVerts : verts.size(); }
+
+    // memory held by the geometry
+    size_t Bytes() const
+    {
+        return tris.capacity() * sizeof(triangle) + verts.capacity() * sizeof(vec3d) + idx.capacity() * sizeof(int) +
+            packed.pos.capacity() * sizeof(uint16_t) + packed.idx16.capacity() * sizeof(uint16_t) +
+            packed.idx32.capacity() * sizeof(uint32_t);
+    }
+
+    bool loadObj(std::string sFilename)
+    {
+        std::ifstream fi(sFilename);
+        if (!fi.is_open())
+            return false;
+
+        // while not at end of file
+        while (!fi.eof())
+        {
+            // assume line length <= 128 characters
+            char line[128];
+            fi.getline(line, 128);
+
+            std::strstream ss;
+            ss << line;
+
+            // store character at start of line
+            char cSol;
+
+            // if 'v', the line is a vertex
+            if (line[0] == 'v')
+            {
+                vec3d vv;
+                ss >> cSol >> vv.x >> vv.y >> vv.z;
+                verts.push_back(vv);
+            }
+
+            // if 'f', the line is a triangle
+            if (line[0] == 'f')
+            {
+                int ff[3];
+                ss >> cSol >> ff[0] >> ff[1] >> ff[2];
+                // a corner with no vertex: a broken file, or one still being written
+                for (int k = 0; k < 3; k++)
+                    if (ff[k] < 1 || ff[k] > (int)verts.size())
+                        return false;
+                // make triangle
+                tris.push_back({ { verts[ff[0] - 1], verts[ff[1] - 1], verts[ff[2] - 1] }, 0 });
+                for (int k = 0; k < 3; k++)
+                    idx.push_back(ff[k] - 1);
+            }
+        }
+
+        return true;
+    }
+
+    // write verts and idx back out as OBJ, which loadObj reads in again
+    bool saveObj(std::string sFilename) const
+    {
+        std::ofstream fo(sFilename);
+        if (!fo.is_open())
+            return false;
+        for (const vec3d& v : verts)
+            fo << "v " << v.x << " " << v.y << " " << v.z << "\n";
+        for (size_t c = 0; c + 2 < idx.size(); c += 3)
+            fo << "f " << idx[c] + 1 << " " << idx[c + 1] + 1 << " " << idx[c + 2] + 1 << "\n";
+        return fo.good();
+    }
+
+    // replace tris, verts and idx with the packed form; a mesh without corner indices, or
+    // without triangles, stays as it is
+    void Pack()
+    {
+        if (tris.empty() || idx.size() != tris.size() * 3)
+            return;
+        vec3d vMin, vMax;
+        bounds(vMin, vMax);
+        packed = packedMesh();
+        packed.vOrigin = vMin;
+        packed.vStep = { (vMax.x - vMin.x) / 65535.0f, (vMax.y - vMin.y) / 65535.0f, (vMax.z - vMin.z) / 65535.0f, 0.0f };
+        auto quantize = [](float f, float fMin, float fStep)
+            {
+                return fStep > 0.0f ? (uint16_t)std::min(65535.0f, std::max(0.0f, (f - fMin) / fStep + 0.5f)) : (uint16_t)0;
+            };
+        packed.pos.reserve(verts.size() * 3 + 1);
+        for (const vec3d& v : verts)
+        {
+            packed.pos.push_back(quantize(v.x, vMin.x, packed.vStep.x));
+            packed.pos.push_back(quantize(v.y, vMin.y, packed.vStep.y));
+            packed.pos.push_back(quantize(v.z, vMin.z, packed.vStep.z));
+        }
+        packed.pos.push_back(0);
+        if (verts.size() <= 65536)
+            packed.idx16.assign(idx.begin(), idx.end());
+        else
+            packed.idx32.assign(idx.begin(), idx.end());
+        packed.nVerts = verts.size();
+        packed.nTris = tris.size();
+        std::vector<triangle>().swap(tris);
+        std::vector<vec3d>().swap(verts);
+        std::vector<int>().swap(idx);
+    }
+
+    // axis-aligned bounds of the triangles
+    void bounds(vec3d& vMin, vec3d& vMax) const
+    {
+        if (Packed())
+        {
+            // the steps span the bounds the mesh was packed with
+            vMin = packed.vOrigin;
+            vMax = { vMin.x + packed.vStep.x * 65535.0f, vMin.y + packed.vStep.y * 65535.0f, vMin.z + packed.vStep.z * 65535.0f };
+            return;
+        }
+        vMin = { FLT_MAX, FLT_MAX, FLT_MAX };
+        vMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        for (const triangle& t : tris)
+            for (const vec3d& p : t.p)
+            {
+                vMin = { std::min(vMin.x, p.x), std::min(vMin.y, p.y), std::min(vMin.z, p.z) };
+                vMax = { std::max(vMax.x, p.x), std::max(vMax.y, p.y), std::max(vMax.z, p.z) };
+            }
+        if (tris.empty())
+            vMin = vMax = vec3d();
+    }
+};
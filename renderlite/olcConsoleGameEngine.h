@@ -69,6 +69,8 @@ blocks - but you can draw any unicode character, using any of the colours listed
 */
 
 #pragma once
+
+#ifdef _WIN32
 #pragma comment(lib, "winmm.lib")
 
 #ifndef UNICODE
@@ -77,6 +79,49 @@ Character Set -> Use Unicode. Thanks! - Javidx9
 #endif
 
 #include <windows.h>
+#else
+// POSIX terminals: no Win32 console, so provide the handful of console types the engine
+// uses and present frames as ANSI escape sequences on stdout instead
+#include <unistd.h>
+#include <termios.h>
+#include <poll.h>
+#include <csignal>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cwchar>
+
+typedef void* HANDLE;
+typedef struct _COORD { short X; short Y; } COORD;
+typedef struct _SMALL_RECT { short Left; short Top; short Right; short Bottom; } SMALL_RECT;
+typedef struct _CHAR_INFO
+{
+	union { unsigned short UnicodeChar; char AsciiChar; } Char;
+	unsigned short Attributes;
+} CHAR_INFO;
+typedef struct _CONSOLE_SCREEN_BUFFER_INFO { COORD dwSize; } CONSOLE_SCREEN_BUFFER_INFO;
+
+#define VK_BACK		0x08
+#define VK_TAB		0x09
+#define VK_RETURN	0x0D
+#define VK_ESCAPE	0x1B
+#define VK_SPACE	0x20
+#define VK_LEFT		0x25
+#define VK_UP		0x26
+#define VK_RIGHT	0x27
+#define VK_DOWN		0x28
+
+#define swprintf_s swprintf
+
+inline int _wfopen_s(FILE** f, const wchar_t* sFile, const wchar_t* sMode)
+{
+	char file[1024], mode[8];
+	wcstombs(file, sFile, sizeof(file));
+	wcstombs(mode, sMode, sizeof(mode));
+	*f = fopen(file, mode);
+	return *f == nullptr ? errno : 0;
+}
+#endif
 
 #include <iostream>
 #include <chrono>
@@ -84,8 +129,22 @@ Character Set -> Use Unicode. Thanks! - Javidx9
 #include <list>
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <string>
+#include <cstring>
+#include <cmath>
+#include <cstdint>
+#include <climits>
+#include <algorithm>
 #include <condition_variable>
 
+#include "quantize.h"
+#include "input.h"
+#include "profiler.h"
+#include "inputlog.h"
+#include "overdraw.h"
+#include "resscale.h"
+
 enum COLOUR
 {
 	FG_BLACK = 0x0000,
@@ -130,6 +189,37 @@ enum PIXEL_TYPE
 	PIXEL_QUARTER = 0x2591,
 };
 
+// A finished, quantized frame as handed to frame outputs. Buffers are only valid for
+// the duration of olcFrameOutput::OnFrame
+struct olcFrame
+{
+	int nWidth = 0;
+	int nHeight = 0;
+	// frame number, counting from 0
+	uint64_t nFrame = 0;
+	OUTPUT_TARGET target = OUTPUT_LEGACY16;
+	const CHAR_INFO* pCells = nullptr;
+	const uint32_t* pShade = nullptr;
+	const uint8_t* pIndex = nullptr;
+
+	// colour of cell i as displayed, packed like a shade cell (see resolveRGB)
+	uint32_t CellRGB(int i) const
+	{
+		uint32_t cell;
+		memcpy(&cell, &pCells[i], sizeof(cell));
+		return resolveRGB(cell, pShade[i], pIndex[i], target);
+	}
+};
+
+// Receives every frame after it has been presented, e.g. to export it somewhere
+// other than the console. Outputs run on the game thread, so they should be quick
+class olcFrameOutput
+{
+public:
+	virtual ~olcFrameOutput() {}
+	virtual void OnFrame(const olcFrame& frame) = 0;
+};
+
 class olcSprite
 {
 public:
@@ -272,12 +362,13 @@ public:
 		m_nScreenWidth = 80;
 		m_nScreenHeight = 30;
 
+#ifdef _WIN32
 		m_hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
 		m_hConsoleIn = GetStdHandle(STD_INPUT_HANDLE);
+#endif
 
-		std::memset(m_keyNewState, 0, 256 * sizeof(short));
-		std::memset(m_keyOldState, 0, 256 * sizeof(short));
 		std::memset(m_keys, 0, 256 * sizeof(sKeyState));
+		std::memset(m_mouse, 0, 5 * sizeof(sKeyState));
 		m_mousePosX = 0;
 		m_mousePosY = 0;
 
@@ -291,6 +382,7 @@ public:
 		m_bEnableSound = true;
 	}
 
+#ifdef _WIN32
 	int ConstructConsole(int width, int height, int fontw, int fonth)
 	{
 		if (m_hConsole == INVALID_HANDLE_VALUE)
@@ -367,13 +459,161 @@ public:
 		if (!SetConsoleMode(m_hConsoleIn, ENABLE_EXTENDED_FLAGS | ENABLE_WINDOW_INPUT | ENABLE_MOUSE_INPUT))
 			return Error(L"SetConsoleMode");
 
-		// Allocate memory for screen buffer
-		m_bufScreen = new CHAR_INFO[m_nScreenWidth * m_nScreenHeight];
-		memset(m_bufScreen, 0, sizeof(CHAR_INFO) * m_nScreenWidth * m_nScreenHeight);
+		AllocateBuffers();
 
 		SetConsoleCtrlHandler((PHANDLER_ROUTINE)CloseHandler, TRUE);
 		return 1;
 	}
+#else
+	int ConstructConsole(int width, int height, int /*fontw*/, int /*fonth*/)
+	{
+		// The terminal owns its font and window size, so only the buffers are sized here.
+		// Frames are written as ANSI escapes, so pick a colour target the terminal can show
+		m_nScreenWidth = width;
+		m_nScreenHeight = height;
+		m_rectWindow = { 0, 0, (short)(m_nScreenWidth - 1), (short)(m_nScreenHeight - 1) };
+
+		if (!isatty(STDOUT_FILENO))
+			return Error(L"stdout is not a terminal");
+
+		// Switch to the alternate screen and hide the cursor until we exit
+		const char init[] = "\x1b[?1049h\x1b[?25l\x1b[2J";
+		if (write(STDOUT_FILENO, init, sizeof(init) - 1) < 0)
+			return Error(L"write");
+		m_bTerminalActive = true;
+
+		// Raw keyboard: bytes arrive as they are typed, unechoed. ISIG stays on so Ctrl+C
+		// still stops the game through CloseHandler
+		if (isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &m_termiosOriginal) == 0)
+		{
+			termios raw = m_termiosOriginal;
+			raw.c_lflag &= ~(ICANON | ECHO | IEXTEN);
+			raw.c_iflag &= ~(IXON | ICRNL);
+			raw.c_cc[VMIN] = 0;
+			raw.c_cc[VTIME] = 0;
+			if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) == 0)
+				m_bStdinRaw = true;
+
+			// Ask for SGR mouse reports (with motion), focus reports, and kitty keyboard
+			// protocol key-up reports; terminals ignore the modes they do not know
+			const char modes[] = "\x1b[?1003h\x1b[?1006h\x1b[?1004h\x1b[>11u";
+			if (write(STDOUT_FILENO, modes, sizeof(modes) - 1) < 0) {}
+		}
+
+		AllocateBuffers();
+
+		signal(SIGINT, CloseHandler);
+		signal(SIGTERM, CloseHandler);
+		return 1;
+	}
+#endif
+
+	// Run without a console: frames are rendered, quantized and handed to the frame
+	// outputs, but never presented and no input is read. For offline renders and benchmarks
+	int ConstructHeadless(int width, int height)
+	{
+		m_nScreenWidth = width;
+		m_nScreenHeight = height;
+		m_rectWindow = { 0, 0, (short)(m_nScreenWidth - 1), (short)(m_nScreenHeight - 1) };
+		m_bHeadless = true;
+
+		AllocateBuffers();
+
+#ifndef _WIN32
+		signal(SIGINT, CloseHandler);
+		signal(SIGTERM, CloseHandler);
+#endif
+		return 1;
+	}
+
+	// Pass a constant fElapsedTime to OnUserUpdate instead of the measured frame time
+	// (0 = use wall-clock time), so offline renders advance the same amount every frame
+	void SetFixedTimestep(float fTimestep)
+	{
+		m_fFixedTimestep = fTimestep;
+	}
+
+	// Write every frame's input state, fElapsedTime and a hash of what it drew to a log
+	// (see inputlog.h). Call after constructing, e.g. from OnUserCreate
+	bool RecordInput(const char* sPath)
+	{
+		return m_inputRecorder.Open(sPath, m_nScreenWidth, m_nScreenHeight);
+	}
+
+	// Play a recorded log back instead of live input: each frame sees the recorded key /
+	// mouse state and time step, its hash is checked against the recording, and the game
+	// stops at the end of the log
+	bool ReplayInput(const char* sPath)
+	{
+		return m_inputReplayer.Open(sPath);
+	}
+
+	// Select how shaded cells are quantized and presented. The legacy 16 colour target
+	// works everywhere, xterm-256 and truecolor need a terminal that understands ANSI colour
+	// escapes (Windows 10 console or any POSIX terminal)
+	bool SetOutputTarget(OUTPUT_TARGET target)
+	{
+#ifdef _WIN32
+		if (target != OUTPUT_LEGACY16)
+		{
+			DWORD mode = 0;
+			GetConsoleMode(m_hConsole, &mode);
+			if (!SetConsoleMode(m_hConsole, mode | ENABLE_PROCESSED_OUTPUT | ENABLE_VIRTUAL_TERMINAL_PROCESSING))
+				return false;
+			SetConsoleOutputCP(CP_UTF8);
+		}
+#endif
+		m_quantizer.SetTarget(target);
+		return true;
+	}
+
+	OUTPUT_TARGET GetOutputTarget()
+	{
+		return m_quantizer.Target();
+	}
+
+	// Count writes per cell (and with OVERDRAW_TILE_TIME, fill time per tile) from the
+	// next frame on; the heatmap modes show them in place of the frame (see overdraw.h)
+	void SetOverdrawMode(OVERDRAW_MODE mode)
+	{
+		if (mode != OVERDRAW_OFF && (m_overdraw.nWidth != m_nScreenWidth || m_overdraw.nHeight != m_nScreenHeight))
+			m_overdraw.Resize(m_nScreenWidth, m_nScreenHeight);
+		m_overdrawMode = mode;
+	}
+
+	OVERDRAW_MODE GetOverdrawMode()
+	{
+		return m_overdrawMode;
+	}
+
+	// Cells written by FillTriangleShade since the start, overlaps counted every time
+	uint64_t GetCellsFilled()
+	{
+		return m_nCellsFilled;
+	}
+
+	// Summary of the last frame drawn with overdraw counting on
+	overdrawStats GetOverdrawStats()
+	{
+		return m_overdrawStats;
+	}
+
+	// The last frame's counts, e.g. to write them out as PGM
+	const OverdrawCounter& GetOverdraw()
+	{
+		return m_overdraw;
+	}
+
+	// Register an output that also receives every presented frame (not owned)
+	void AddFrameOutput(olcFrameOutput* output)
+	{
+		m_vecFrameOutputs.push_back(output);
+	}
+
+	void RemoveFrameOutput(olcFrameOutput* output)
+	{
+		m_vecFrameOutputs.erase(std::remove(m_vecFrameOutputs.begin(), m_vecFrameOutputs.end(), output), m_vecFrameOutputs.end());
+	}
 
 	virtual void Draw(int x, int y, short c = 0x2588, short col = 0x000F)
 	{
@@ -381,9 +621,71 @@ public:
 		{
 			m_bufScreen[y * m_nScreenWidth + x].Char.UnicodeChar = c;
 			m_bufScreen[y * m_nScreenWidth + x].Attributes = col;
+			m_bufShade[y * m_nScreenWidth + x] = 0;
+			if (m_overdrawMode != OVERDRAW_OFF)
+				m_overdraw.Cell(x, y);
 		}
 	}
 
+	// Write a shaded cell, quantized to the output target at present time
+	void DrawShade(int x, int y, uint32_t shade)
+	{
+		if (x >= 0 && x < m_nScreenWidth && y >= 0 && y < m_nScreenHeight)
+		{
+			m_bufShade[y * m_nScreenWidth + x] = shade;
+			if (m_overdrawMode != OVERDRAW_OFF)
+				m_overdraw.Cell(x, y);
+		}
+	}
+
+	// Fill the whole screen with one shade (use shadeRGB to build it)
+	void ClearShade(uint32_t shade)
+	{
+		std::fill(m_bufShade, m_bufShade + m_nScreenWidth * m_nScreenHeight, shade);
+	}
+
+	// As above, but only the top-left w x h cells (a frame rendered below full size)
+	void ClearShade(uint32_t shade, int w, int h)
+	{
+		w = std::min(w, m_nScreenWidth);
+		h = std::min(h, m_nScreenHeight);
+		for (int y = 0; y < h; y++)
+			std::fill(m_bufShade + y * m_nScreenWidth, m_bufShade + y * m_nScreenWidth + w, shade);
+	}
+
+	// Stretch a frame drawn into the top-left w x h cells over the whole screen, shades
+	// and glyphs both (see resscale.h)
+	void UpscaleScreen(int w, int h, RESAMPLE_FILTER filter = RESAMPLE_NEAREST)
+	{
+		w = std::min(w, m_nScreenWidth);
+		h = std::min(h, m_nScreenHeight);
+		if (w <= 0 || h <= 0 || (w == m_nScreenWidth && h == m_nScreenHeight))
+			return;
+
+		if (filter == RESAMPLE_NEAREST)
+		{
+			resampleNearest(m_bufShade, m_bufScreen, w, h, m_nScreenWidth, m_nScreenHeight);
+			return;
+		}
+
+		// bilinear reads around each sample, so the frame is packed into scratch buffers
+		// sized for the whole screen (plus three rows for the filter) once, and every
+		// scale after the first is allocation free
+		size_t nCells = (size_t)m_nScreenWidth * m_nScreenHeight;
+		if (m_vecScaleCells.size() < nCells)
+		{
+			m_vecScaleShade.resize(nCells + 3 * m_nScreenWidth);
+			m_vecScaleCells.resize(nCells);
+		}
+		for (int y = 0; y < h; y++)
+		{
+			memcpy(&m_vecScaleShade[(size_t)y * w], m_bufShade + y * m_nScreenWidth, sizeof(uint32_t) * w);
+			memcpy(&m_vecScaleCells[(size_t)y * w], m_bufScreen + y * m_nScreenWidth, sizeof(CHAR_INFO) * w);
+		}
+		resampleBilinear(m_vecScaleShade.data(), m_vecScaleCells.data(), w, h, m_bufShade, m_bufScreen,
+			m_nScreenWidth, m_nScreenHeight, &m_vecScaleShade[nCells]);
+	}
+
 	void Fill(int x1, int y1, int x2, int y2, short c = 0x2588, short col = 0x000F)
 	{
 		Clip(x1, y1);
@@ -399,6 +701,7 @@ public:
 		{
 			m_bufScreen[y * m_nScreenWidth + x + i].Char.UnicodeChar = c[i];
 			m_bufScreen[y * m_nScreenWidth + x + i].Attributes = col;
+			m_bufShade[y * m_nScreenWidth + x + i] = 0;
 		}
 	}
 
@@ -410,6 +713,7 @@ public:
 			{
 				m_bufScreen[y * m_nScreenWidth + x + i].Char.UnicodeChar = c[i];
 				m_bufScreen[y * m_nScreenWidth + x + i].Attributes = col;
+				m_bufShade[y * m_nScreenWidth + x + i] = 0;
 			}
 		}
 	}
@@ -492,8 +796,76 @@ public:
 	// https://www.avrfreaks.net/sites/default/files/triangles.c
 	void FillTriangle(int x1, int y1, int x2, int y2, int x3, int y3, short c = 0x2588, short col = 0x000F)
 	{
-		auto SWAP = [](int& x, int& y) { int t = x; x = y; y = t; };
 		auto drawline = [&](int sx, int ex, int ny) { for (int i = sx; i <= ex; i++) Draw(i, ny, c, col); };
+		RasterTriangle(x1, y1, x2, y2, x3, y3, drawline);
+	}
+
+	// As FillTriangle, but writes a shaded colour into the shade buffer
+	void FillTriangleShade(int x1, int y1, int x2, int y2, int x3, int y3, uint32_t shade)
+	{
+		auto drawline = [&](int sx, int ex, int ny)
+			{
+				if (ny < 0 || ny >= m_nScreenHeight) return;
+				if (sx < 0) sx = 0;
+				if (ex >= m_nScreenWidth) ex = m_nScreenWidth - 1;
+				ShadeSpan(sx, ex, ny, shade);
+			};
+		if (m_overdrawMode == OVERDRAW_TILE_TIME)
+		{
+			m_overdraw.BeginFill();
+			RasterTriangle(x1, y1, x2, y2, x3, y3, drawline);
+			m_overdraw.EndFill();
+		}
+		else
+			RasterTriangle(x1, y1, x2, y2, x3, y3, drawline);
+	}
+
+	// FillTriangleShade for triangles on screen whose vertices all lie on one row, or
+	// within one 2x2 block of cells. RasterTriangle fills exactly the cells between the
+	// vertices on each row of those, so this fills the same cells without its edge walk
+	// or any clipping. IsSmallTriangle says whether a triangle qualifies
+	void FillSmallTriangleShade(int x1, int y1, int x2, int y2, int x3, int y3, uint32_t shade)
+	{
+		if (m_overdrawMode == OVERDRAW_TILE_TIME)
+			m_overdraw.BeginFill();
+
+		int y0 = std::min(y1, std::min(y2, y3));
+		for (int y = y0; y <= y0 + 1; y++)
+		{
+			// INT_MAX / INT_MIN for vertices on the other row, so they drop out of the span
+			int sx = std::min(y1 == y ? x1 : INT_MAX, std::min(y2 == y ? x2 : INT_MAX, y3 == y ? x3 : INT_MAX));
+			int ex = std::max(y1 == y ? x1 : INT_MIN, std::max(y2 == y ? x2 : INT_MIN, y3 == y ? x3 : INT_MIN));
+			if (sx <= ex)
+				ShadeSpan(sx, ex, y, shade);
+		}
+
+		if (m_overdrawMode == OVERDRAW_TILE_TIME)
+			m_overdraw.EndFill();
+	}
+
+	// Whether FillSmallTriangleShade can draw a triangle
+	bool IsSmallTriangle(int x1, int y1, int x2, int y2, int x3, int y3)
+	{
+		int minx = std::min(x1, std::min(x2, x3)), maxx = std::max(x1, std::max(x2, x3));
+		int miny = std::min(y1, std::min(y2, y3)), maxy = std::max(y1, std::max(y2, y3));
+		return minx >= 0 && maxx < m_nScreenWidth && miny >= 0 && maxy < m_nScreenHeight &&
+			(miny == maxy || (maxy - miny == 1 && maxx - minx <= 1));
+	}
+
+	// One span of a shaded fill, already clipped to the screen
+	void ShadeSpan(int sx, int ex, int y, uint32_t shade)
+	{
+		uint32_t* row = m_bufShade + y * m_nScreenWidth;
+		for (int i = sx; i <= ex; i++) row[i] = shade;
+		if (sx <= ex) m_nCellsFilled += ex - sx + 1;
+		if (m_overdrawMode != OVERDRAW_OFF) m_overdraw.Span(sx, ex, y);
+	}
+
+	// Scanline walk shared by the fill routines, drawline(sx, ex, y) fills one span
+	template <typename SPAN>
+	void RasterTriangle(int x1, int y1, int x2, int y2, int x3, int y3, SPAN& drawline)
+	{
+		auto SWAP = [](int& x, int& y) { int t = x; x = y; y = t; };
 
 		int t1x, t2x, y, minx, maxx, t1xp, t2xp;
 		bool changed1 = false;
@@ -747,8 +1119,14 @@ public:
 
 	~olcConsoleGameEngine()
 	{
+#ifdef _WIN32
 		SetConsoleActiveScreenBuffer(m_hOriginalConsole);
+#else
+		RestoreTerminal();
+#endif
 		delete[] m_bufScreen;
+		delete[] m_bufShade;
+		delete[] m_bufIndex;
 	}
 
 public:
@@ -758,8 +1136,20 @@ public:
 		m_bAtomActive = true;
 		std::thread t = std::thread(&olcConsoleGameEngine::GameThread, this);
 
+		// Input is read on its own thread and queued for the game thread
+		std::thread tInput;
+		if (!m_bHeadless)
+		{
+			m_bInputActive = true;
+			tInput = std::thread(&olcConsoleGameEngine::InputThread, this);
+		}
+
 		// Wait for thread to be exited
 		t.join();
+
+		m_bInputActive = false;
+		if (tInput.joinable())
+			tInput.join();
 	}
 
 	int ScreenWidth()
@@ -780,6 +1170,7 @@ private:
 			m_bAtomActive = false;
 
 		// Check if sound system should be enabled
+#ifdef _WIN32
 		if (m_bEnableSound)
 		{
 			if (!CreateAudio())
@@ -788,6 +1179,9 @@ private:
 				m_bEnableSound = false;
 			}
 		}
+#else
+		m_bEnableSound = false;
+#endif
 
 		auto tp1 = std::chrono::system_clock::now();
 		auto tp2 = std::chrono::system_clock::now();
@@ -797,119 +1191,91 @@ private:
 			// Run as fast as possible
 			while (m_bAtomActive)
 			{
+				// Collect the previous frame's stage timings, then time this one
+				PROFILE_END_FRAME();
+				PROFILE_SCOPE(PROFILE_FRAME);
+
 				// Handle Timing
 				tp2 = std::chrono::system_clock::now();
 				std::chrono::duration<float> elapsedTime = tp2 - tp1;
 				tp1 = tp2;
-				float fElapsedTime = elapsedTime.count();
-
-				// Handle Keyboard Input
-				for (int i = 0; i < 256; i++)
-				{
-					m_keyNewState[i] = GetAsyncKeyState(i);
+				float fElapsedTime = m_fFixedTimestep > 0.0f ? m_fFixedTimestep : elapsedTime.count();
 
-					m_keys[i].bPressed = false;
-					m_keys[i].bReleased = false;
+				// Apply whatever input arrived since the last frame
+				DrainInput();
 
-					if (m_keyNewState[i] != m_keyOldState[i])
+				// A replay overrides both the input and the clock
+				if (m_inputReplayer.IsOpen())
+				{
+					inputLogState state;
+					if (!m_inputReplayer.NextFrame(fElapsedTime, state))
 					{
-						if (m_keyNewState[i] & 0x8000)
-						{
-							m_keys[i].bPressed = !m_keys[i].bHeld;
-							m_keys[i].bHeld = true;
-						}
-						else
-						{
-							m_keys[i].bReleased = true;
-							m_keys[i].bHeld = false;
-						}
+						m_bAtomActive = false;
+						break;
 					}
-
-					m_keyOldState[i] = m_keyNewState[i];
+					SetInputLogState(state);
 				}
+				if (m_inputRecorder.IsOpen())
+					m_inputRecorder.BeginFrame(fElapsedTime, GetInputLogState());
+
+				if (m_overdrawMode != OVERDRAW_OFF)
+					m_overdraw.BeginFrame();
 
-				// Handle Mouse Input - Check for window events
-				INPUT_RECORD inBuf[32];
-				DWORD events = 0;
-				GetNumberOfConsoleInputEvents(m_hConsoleIn, &events);
-				if (events > 0)
-					ReadConsoleInput(m_hConsoleIn, inBuf, events, &events);
+				// Handle Frame Update
+				if (!OnUserUpdate(fElapsedTime))
+					m_bAtomActive = false;
 
-				// Handle events - we only care about mouse clicks and movement
-				// for now
-				for (DWORD i = 0; i < events; i++)
+				// Hash what the app drew, before any overlay
+				if (m_inputRecorder.IsOpen() || m_inputReplayer.IsOpen())
 				{
-					switch (inBuf[i].EventType)
-					{
-					case FOCUS_EVENT:
-					{
-						m_bConsoleInFocus = inBuf[i].Event.FocusEvent.bSetFocus;
-					}
-					break;
+					uint32_t hash = FrameHash();
+					if (m_inputRecorder.IsOpen())
+						m_inputRecorder.EndFrame(hash);
+					if (m_inputReplayer.IsOpen() && m_inputReplayer.nWidth == m_nScreenWidth && m_inputReplayer.nHeight == m_nScreenHeight)
+						m_inputReplayer.CheckFrame(hash);
+				}
 
-					case MOUSE_EVENT:
-					{
-						switch (inBuf[i].Event.MouseEvent.dwEventFlags)
-						{
-						case MOUSE_MOVED:
-						{
-							m_mousePosX = inBuf[i].Event.MouseEvent.dwMousePosition.X;
-							m_mousePosY = inBuf[i].Event.MouseEvent.dwMousePosition.Y;
-						}
-						break;
+				if (m_overdrawMode != OVERDRAW_OFF)
+				{
+					m_overdrawStats = m_overdraw.Stats();
+					if (m_overdrawMode != OVERDRAW_COUNT)
+						DrawOverdrawHeatmap();
+				}
 
-						case 0:
-						{
-							for (int m = 0; m < 5; m++)
-								m_mouseNewState[m] = (inBuf[i].Event.MouseEvent.dwButtonState & (1 << m)) > 0;
+#ifdef RENDERLITE_PROFILE
+				if (m_bProfilerOverlay)
+					DrawProfilerOverlay();
+#endif
 
-						}
-						break;
+				// Everything from here to the end of the frame counts as present
+				PROFILE_SCOPE(PROFILE_PRESENT);
 
-						default:
-							break;
-						}
-					}
-					break;
+				// Quantize shaded cells to the output palette
+				m_quantizer.Quantize(m_bufShade, (uint32_t*)m_bufScreen, m_bufIndex, m_nScreenWidth, m_nScreenHeight);
 
-					default:
-						break;
-						// We don't care just at the moment
-					}
+				// Update Title & Present Screen Buffer
+				if (!m_bHeadless)
+				{
+					wchar_t s[256];
+					swprintf_s(s, 256, L"%ls - FPS: %3.2f", m_sAppName.c_str(), 1.0f / elapsedTime.count());
+					Present(s);
 				}
 
-				for (int m = 0; m < 5; m++)
+				// Hand the finished frame to any extra outputs
+				if (!m_vecFrameOutputs.empty())
 				{
-					m_mouse[m].bPressed = false;
-					m_mouse[m].bReleased = false;
-
-					if (m_mouseNewState[m] != m_mouseOldState[m])
-					{
-						if (m_mouseNewState[m])
-						{
-							m_mouse[m].bPressed = true;
-							m_mouse[m].bHeld = true;
-						}
-						else
-						{
-							m_mouse[m].bReleased = true;
-							m_mouse[m].bHeld = false;
-						}
-					}
-
-					m_mouseOldState[m] = m_mouseNewState[m];
+					olcFrame frame;
+					frame.nWidth = m_nScreenWidth;
+					frame.nHeight = m_nScreenHeight;
+					frame.nFrame = m_nFrame;
+					frame.target = m_quantizer.Target();
+					frame.pCells = m_bufScreen;
+					frame.pShade = m_bufShade;
+					frame.pIndex = m_bufIndex;
+					for (auto output : m_vecFrameOutputs)
+						output->OnFrame(frame);
 				}
-
-
-				// Handle Frame Update
-				if (!OnUserUpdate(fElapsedTime))
-					m_bAtomActive = false;
-
-				// Update Title & Present Screen Buffer
-				wchar_t s[256];
-				swprintf_s(s, 256, L"%s - FPS: %3.2f", m_sAppName.c_str(), 1.0f / fElapsedTime);
-				SetConsoleTitle(s);
-				WriteConsoleOutput(m_hConsole, m_bufScreen, { (short)m_nScreenWidth, (short)m_nScreenHeight }, { 0,0 }, &m_rectWindow);
+				m_nFrame++;
 			}
 
 			if (m_bEnableSound)
@@ -921,8 +1287,11 @@ private:
 			if (OnUserDestroy())
 			{
 				// User has permitted destroy, so exit and clean up
-				delete[] m_bufScreen;
+#ifdef _WIN32
 				SetConsoleActiveScreenBuffer(m_hOriginalConsole);
+#else
+				RestoreTerminal();
+#endif
 				m_cvGameFinished.notify_one();
 			}
 			else
@@ -933,6 +1302,436 @@ private:
 		}
 	}
 
+	void AllocateBuffers()
+	{
+		int nCells = m_nScreenWidth * m_nScreenHeight;
+
+		// Allocate memory for screen buffer
+		m_bufScreen = new CHAR_INFO[nCells];
+		memset(m_bufScreen, 0, sizeof(CHAR_INFO) * nCells);
+
+		// Shaded colour per cell, and its palette index for the xterm-256 target.
+		// The legacy target quantizes straight into m_bufScreen
+		static_assert(sizeof(CHAR_INFO) == sizeof(uint32_t), "quantizer writes CHAR_INFO as packed uint32_t");
+		m_bufShade = new uint32_t[nCells];
+		memset(m_bufShade, 0, sizeof(uint32_t) * nCells);
+		m_bufIndex = new uint8_t[nCells];
+		memset(m_bufIndex, 0, nCells);
+
+		m_quantizer.SetTarget(m_quantizer.Target());
+	}
+
+	void Present(const wchar_t* sTitle)
+	{
+#ifdef _WIN32
+		SetConsoleTitle(sTitle);
+		if (m_quantizer.Target() == OUTPUT_LEGACY16)
+		{
+			WriteConsoleOutput(m_hConsole, m_bufScreen, { (short)m_nScreenWidth, (short)m_nScreenHeight }, { 0,0 }, &m_rectWindow);
+			return;
+		}
+		EncodeAnsi(nullptr);
+		DWORD written = 0;
+		WriteConsoleA(m_hConsole, m_sAnsiFrame.data(), (DWORD)m_sAnsiFrame.size(), &written, NULL);
+#else
+		EncodeAnsi(sTitle);
+		const char* p = m_sAnsiFrame.data();
+		size_t n = m_sAnsiFrame.size();
+		while (n > 0)
+		{
+			ssize_t w = write(STDOUT_FILENO, p, n);
+			if (w < 0) { if (errno == EINTR) continue; break; }
+			p += w;
+			n -= (size_t)w;
+		}
+#endif
+	}
+
+	static void AppendUTF8(std::string& out, unsigned int cp)
+	{
+		if (cp < 0x80) out += (char)cp;
+		else if (cp < 0x800) { out += (char)(0xC0 | (cp >> 6)); out += (char)(0x80 | (cp & 0x3F)); }
+		else { out += (char)(0xE0 | (cp >> 12)); out += (char)(0x80 | ((cp >> 6) & 0x3F)); out += (char)(0x80 | (cp & 0x3F)); }
+	}
+
+	// Build the frame as ANSI escapes. Glyph cells use the 16 colour SGR codes,
+	// shaded cells are drawn as a space on the quantized background colour.
+	// Colour changes are only emitted when they differ from the previous cell
+	void EncodeAnsi(const wchar_t* sTitle)
+	{
+		std::string& out = m_sAnsiFrame;
+		out.clear();
+
+		if (sTitle != nullptr)
+		{
+			out += "\x1b]0;";
+			for (const wchar_t* c = sTitle; *c; c++)
+				AppendUTF8(out, (unsigned int)*c);
+			out += "\x07";
+		}
+
+		// console attribute bits are blue/green/red, ANSI wants red/green/blue
+		auto ansi = [](int a) { return ((a & 1) << 2) | (a & 2) | ((a & 4) >> 2); };
+
+		OUTPUT_TARGET target = m_quantizer.Target();
+		char buf[32];
+		uint32_t last = 0xFFFFFFFF;
+
+		for (int y = 0; y < m_nScreenHeight; y++)
+		{
+			snprintf(buf, sizeof(buf), "\x1b[%d;1H", y + 1);
+			out += buf;
+
+			for (int x = 0; x < m_nScreenWidth; x++)
+			{
+				int i = y * m_nScreenWidth + x;
+				uint32_t shade = m_bufShade[i];
+
+				if (target != OUTPUT_LEGACY16 && isShaded(shade))
+				{
+					// tag the key so shaded and glyph cells never compare equal
+					uint32_t key = target == OUTPUT_XTERM256 ? (0x01000000u | m_bufIndex[i]) : (0x02000000u | (shade & 0xFFFFFF));
+					if (key != last)
+					{
+						if (target == OUTPUT_XTERM256)
+							snprintf(buf, sizeof(buf), "\x1b[48;5;%dm", m_bufIndex[i]);
+						else
+							snprintf(buf, sizeof(buf), "\x1b[48;2;%d;%d;%dm", shadeR(shade), shadeG(shade), shadeB(shade));
+						out += buf;
+						last = key;
+					}
+					out += ' ';
+				}
+				else
+				{
+					int a = m_bufScreen[i].Attributes;
+					uint32_t key = 0x03000000u | (a & 0xFF);
+					if (key != last)
+					{
+						int fg = a & 0x0F, bg = (a >> 4) & 0x0F;
+						snprintf(buf, sizeof(buf), "\x1b[%d;%dm", (fg & 8 ? 90 : 30) + ansi(fg), (bg & 8 ? 100 : 40) + ansi(bg));
+						out += buf;
+						last = key;
+					}
+					AppendUTF8(out, m_bufScreen[i].Char.UnicodeChar ? m_bufScreen[i].Char.UnicodeChar : L' ');
+				}
+			}
+		}
+	}
+
+#ifdef RENDERLITE_PROFILE
+	// Stage timing table in the top-left corner, refreshed every few frames so the
+	// numbers are readable and the percentile sort stays off most frames
+	void DrawProfilerOverlay()
+	{
+		Profiler& profiler = Profiler::Get();
+		if (profiler.Frames() >= m_nProfilerRefresh)
+		{
+			for (int s = 0; s < PROFILE_STAGES; s++)
+				m_profilerSummary[s] = profiler.Summary((PROFILE_STAGE)s);
+			m_nProfilerRefresh = profiler.Frames() + 16;
+		}
+
+		if (m_nScreenWidth < 36 || m_nScreenHeight < PROFILE_STAGES + 3)
+			return;
+
+		wchar_t s[64];
+		DrawString(1, 1, L"stage        min    avg    p99 ms", FG_WHITE);
+		for (int i = 0; i < PROFILE_STAGES; i++)
+		{
+			const char* sName = PROFILE_STAGE_NAME[i];
+			swprintf_s(s, 64, L"%-9ls %6.3f %6.3f %6.3f", std::wstring(sName, sName + strlen(sName)).c_str(),
+				m_profilerSummary[i].fMinMs, m_profilerSummary[i].fAvgMs, m_profilerSummary[i].fP99Ms);
+			DrawString(1, 2 + i, s, i == PROFILE_FRAME ? FG_YELLOW : FG_GREY);
+		}
+
+		// the totals above miss whatever did not fit in a ring
+		if (profiler.Dropped() > 0)
+		{
+			swprintf_s(s, 64, L"%u records dropped", profiler.Dropped());
+			DrawString(1, 2 + PROFILE_STAGES, s, FG_RED);
+		}
+	}
+#endif
+
+	// Replace the frame with write counts per cell (or fill time per tile), cold to hot,
+	// and put the summary on the bottom row
+	void DrawOverdrawHeatmap()
+	{
+		static const short ramp[] = { FG_BLACK, FG_DARK_BLUE, FG_BLUE, FG_DARK_CYAN, FG_GREEN, FG_YELLOW, FG_DARK_YELLOW, FG_RED, FG_MAGENTA, FG_WHITE };
+		const int nLevels = sizeof(ramp) / sizeof(ramp[0]);
+		int64_t nMaxNs = std::max<int64_t>(m_overdraw.MaxTileNs(), 1);
+
+		for (int y = 0; y < m_nScreenHeight; y++)
+			for (int x = 0; x < m_nScreenWidth; x++)
+			{
+				int nLevel;
+				if (m_overdrawMode == OVERDRAW_TILE_TIME)
+					nLevel = m_overdraw.TileNs(x, y) > 0 ? 1 + (int)(m_overdraw.TileNs(x, y) * (nLevels - 2) / nMaxNs) : 0;
+				else
+					nLevel = std::min<int>(m_overdraw.Count(x, y), nLevels - 1);
+
+				int i = y * m_nScreenWidth + x;
+				m_bufScreen[i].Char.UnicodeChar = PIXEL_SOLID;
+				m_bufScreen[i].Attributes = ramp[nLevel];
+				m_bufShade[i] = 0;
+			}
+
+		if (m_nScreenWidth < 48 || m_nScreenHeight < 2)
+			return;
+		wchar_t s[80];
+		if (m_overdrawMode == OVERDRAW_TILE_TIME)
+			swprintf_s(s, 80, L"fill %.3f ms, slowest tile %.3f ms", m_overdrawStats.fFillMs, nMaxNs * 1e-6f);
+		else
+			swprintf_s(s, 80, L"overdraw avg %.2f max %d, %d+ writes %.1f%%", m_overdrawStats.fAverage,
+				m_overdrawStats.nMax, OVERDRAW_HEAVY, m_overdrawStats.fHeavy * 100.0f);
+		DrawString(1, m_nScreenHeight - 2, s, FG_WHITE | BG_BLACK);
+	}
+
+#ifndef _WIN32
+	void RestoreTerminal()
+	{
+		if (!m_bTerminalActive)
+			return;
+		if (m_bStdinRaw)
+		{
+			const char modes[] = "\x1b[<u\x1b[?1004l\x1b[?1006l\x1b[?1003l";
+			if (write(STDOUT_FILENO, modes, sizeof(modes) - 1) < 0) {}
+			tcsetattr(STDIN_FILENO, TCSAFLUSH, &m_termiosOriginal);
+			m_bStdinRaw = false;
+		}
+		const char fini[] = "\x1b[0m\x1b[?25h\x1b[?1049l";
+		if (write(STDOUT_FILENO, fini, sizeof(fini) - 1) < 0) {}
+		m_bTerminalActive = false;
+	}
+#endif
+
+	void PushInput(const inputEvent& e)
+	{
+		if (!m_queueInput.Push(e))
+			m_nInputDropped++;
+	}
+
+#ifdef _WIN32
+	// Blocks on the console input handle and queues key, mouse and focus events
+	void InputThread()
+	{
+		DWORD dwButtons = 0;
+		while (m_bInputActive)
+		{
+			// Wake up now and again to notice shutdown
+			if (WaitForSingleObject(m_hConsoleIn, 50) != WAIT_OBJECT_0)
+				continue;
+
+			INPUT_RECORD inBuf[32];
+			DWORD events = 0;
+			if (!ReadConsoleInput(m_hConsoleIn, inBuf, 32, &events))
+				continue;
+
+			int64_t now = inputNow();
+			for (DWORD i = 0; i < events; i++)
+			{
+				switch (inBuf[i].EventType)
+				{
+				case KEY_EVENT:
+				{
+					const KEY_EVENT_RECORD& k = inBuf[i].Event.KeyEvent;
+					PushInput(inputEvent{ INPUT_KEY, (uint8_t)(k.bKeyDown != 0), (uint16_t)(k.wVirtualKeyCode & 0xFF), 0, 0, now });
+				}
+				break;
+
+				case FOCUS_EVENT:
+				{
+					PushInput(inputEvent{ INPUT_FOCUS, (uint8_t)(inBuf[i].Event.FocusEvent.bSetFocus != 0), 0, 0, 0, now });
+				}
+				break;
+
+				case MOUSE_EVENT:
+				{
+					const MOUSE_EVENT_RECORD& m = inBuf[i].Event.MouseEvent;
+					int16_t x = m.dwMousePosition.X, y = m.dwMousePosition.Y;
+					if (m.dwEventFlags == MOUSE_MOVED)
+						PushInput(inputEvent{ INPUT_MOUSE_MOVE, 0, 0, x, y, now });
+					else if (m.dwEventFlags == 0)
+					{
+						// Queue one event per button that changed
+						DWORD dwChanged = (m.dwButtonState ^ dwButtons) & 0x1F;
+						for (int b = 0; b < 5; b++)
+							if (dwChanged & (1 << b))
+								PushInput(inputEvent{ INPUT_MOUSE_BUTTON, (uint8_t)((m.dwButtonState >> b) & 1), (uint16_t)b, x, y, now });
+						dwButtons = m.dwButtonState;
+					}
+				}
+				break;
+
+				default:
+					break;
+				}
+			}
+		}
+	}
+#else
+	// Reads the raw-mode tty and queues the decoded events. Terminals send no key-ups
+	// (unless they speak the kitty protocol), so the decoder also times out held keys
+	void InputThread()
+	{
+		if (!m_bStdinRaw)
+			return;
+
+		TerminalInputDecoder decoder;
+		auto emit = [this](const inputEvent& e) { PushInput(e); };
+
+		while (m_bInputActive)
+		{
+			pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+			int n = poll(&pfd, 1, decoder.Busy() ? 5 : 50);
+			int64_t now = inputNow();
+
+			if (n > 0 && (pfd.revents & POLLIN))
+			{
+				char buf[256];
+				ssize_t nRead = read(STDIN_FILENO, buf, sizeof(buf));
+				if (nRead > 0)
+					decoder.Feed(buf, (size_t)nRead, now, emit);
+			}
+			decoder.Expire(now, emit);
+		}
+	}
+#endif
+
+	// Game thread: fold the queued events into m_keys / m_mouse. Pressed and released
+	// only last one frame, so clear them on exactly the keys that set them last time
+	void DrainInput()
+	{
+		PROFILE_SCOPE(PROFILE_INPUT);
+		int64_t tStart = inputNow();
+
+		for (int i = 0; i < m_nKeysTouched; i++)
+		{
+			m_keys[m_nKeyTouched[i]].bPressed = false;
+			m_keys[m_nKeyTouched[i]].bReleased = false;
+		}
+		m_nKeysTouched = 0;
+		for (int m = 0; m < 5; m++)
+		{
+			m_mouse[m].bPressed = false;
+			m_mouse[m].bReleased = false;
+		}
+
+		int nEvents = 0;
+		int64_t nLatencySum = 0, nLatencyMax = 0;
+		inputEvent e;
+		while (m_queueInput.Pop(e))
+		{
+			nEvents++;
+			int64_t nLatency = tStart - e.nTimeNs;
+			nLatencySum += nLatency;
+			nLatencyMax = std::max(nLatencyMax, nLatency);
+
+			switch (e.type)
+			{
+			case INPUT_KEY:
+			{
+				sKeyState& k = m_keys[e.nCode & 0xFF];
+				bool bFresh = !k.bPressed && !k.bReleased;
+				if (e.bDown)
+				{
+					// Autorepeat arrives as more key downs, those are not new presses
+					if (k.bHeld)
+						break;
+					k.bPressed = true;
+					k.bHeld = true;
+				}
+				else
+				{
+					if (!k.bHeld)
+						break;
+					k.bReleased = true;
+					k.bHeld = false;
+				}
+				if (bFresh)
+					m_nKeyTouched[m_nKeysTouched++] = (uint8_t)e.nCode;
+			}
+			break;
+
+			case INPUT_MOUSE_MOVE:
+				m_mousePosX = e.x;
+				m_mousePosY = e.y;
+				break;
+
+			case INPUT_MOUSE_BUTTON:
+			{
+				sKeyState& m = m_mouse[e.nCode % 5];
+				if (e.bDown && !m.bHeld)
+				{
+					m.bPressed = true;
+					m.bHeld = true;
+				}
+				else if (!e.bDown && m.bHeld)
+				{
+					m.bReleased = true;
+					m.bHeld = false;
+				}
+			}
+			break;
+
+			case INPUT_FOCUS:
+				m_bConsoleInFocus = e.bDown != 0;
+				break;
+
+			default:
+				break;
+			}
+		}
+
+		m_inputStats.nEvents = nEvents;
+		m_inputStats.nDropped = m_nInputDropped;
+		m_inputStats.fLatencyMs = nEvents ? (float)(nLatencySum / nEvents) * 1e-6f : 0.0f;
+		m_inputStats.fMaxLatencyMs = (float)nLatencyMax * 1e-6f;
+		m_inputStats.fHandleMs = (float)(inputNow() - tStart) * 1e-6f;
+	}
+
+	// The key / mouse state OnUserUpdate sees, as recorded in an input log
+	inputLogState GetInputLogState()
+	{
+		inputLogState state;
+		for (int i = 0; i < INPUTLOG_SLOTS; i++)
+		{
+			const sKeyState& k = i < 256 ? m_keys[i] : m_mouse[i - 256];
+			state.slot[i] = (k.bPressed ? INPUTLOG_PRESSED : 0) | (k.bReleased ? INPUTLOG_RELEASED : 0) | (k.bHeld ? INPUTLOG_HELD : 0);
+		}
+		state.nMouseX = (int16_t)m_mousePosX;
+		state.nMouseY = (int16_t)m_mousePosY;
+		state.bFocus = m_bConsoleInFocus;
+		return state;
+	}
+
+	void SetInputLogState(const inputLogState& state)
+	{
+		for (int i = 0; i < INPUTLOG_SLOTS; i++)
+		{
+			sKeyState& k = i < 256 ? m_keys[i] : m_mouse[i - 256];
+			k.bPressed = (state.slot[i] & INPUTLOG_PRESSED) != 0;
+			k.bReleased = (state.slot[i] & INPUTLOG_RELEASED) != 0;
+			k.bHeld = (state.slot[i] & INPUTLOG_HELD) != 0;
+		}
+		m_mousePosX = state.nMouseX;
+		m_mousePosY = state.nMouseY;
+		m_bConsoleInFocus = state.bFocus;
+	}
+
+	// Hash of what this frame drew: the shade of shaded cells, the character of the rest.
+	// Shaded cells still hold last frame's quantized output in m_bufScreen, so skip those
+	uint32_t FrameHash()
+	{
+		size_t nCells = (size_t)m_nScreenWidth * m_nScreenHeight;
+		const uint32_t* pCells = (const uint32_t*)m_bufScreen;
+		uint32_t hash = 2166136261u;
+		for (size_t i = 0; i < nCells; i++)
+			hash = inputLogHash(m_bufShade[i] ? &m_bufShade[i] : &pCells[i], 1, hash);
+		return hash;
+	}
+
 public:
 	// User MUST OVERRIDE THESE!!
 	virtual bool OnUserCreate() = 0;
@@ -943,6 +1742,7 @@ public:
 
 
 
+#ifdef _WIN32
 protected: // Audio Engine =====================================================================
 
 	class olcAudioSample
@@ -1287,6 +2087,7 @@ protected: // Audio Engine =====================================================
 	std::condition_variable m_cvBlockNotZero;
 	std::mutex m_muxBlockNotZero;
 	std::atomic<float> m_fGlobalTime = 0.0f;
+#endif
 
 
 
@@ -1310,8 +2111,36 @@ public:
 	sKeyState GetMouse(int nMouseButtonID) { return m_mouse[nMouseButtonID]; }
 	bool IsFocused() { return m_bConsoleInFocus; }
 
+	// Input cost and latency of the current frame
+	struct sInputStats
+	{
+		// time spent applying queued input before OnUserUpdate
+		float fHandleMs = 0.0f;
+		// mean / worst time from the input thread reading an event to this frame seeing it
+		float fLatencyMs = 0.0f;
+		float fMaxLatencyMs = 0.0f;
+		int nEvents = 0;
+		// events lost to a full queue since the start
+		uint32_t nDropped = 0;
+	};
+	sInputStats GetInputStats() { return m_inputStats; }
+
+	// Frames replayed so far, how many drew something other than the recording, and the
+	// first of those (-1 if none)
+	uint64_t GetReplayFrames() { return m_inputReplayer.Frames(); }
+	uint64_t GetReplayMismatches() { return m_inputReplayer.Mismatches(); }
+	int64_t GetReplayFirstMismatch() { return m_inputReplayer.FirstMismatch(); }
+	bool IsReplaying() { return m_inputReplayer.IsOpen(); }
+
+#ifdef RENDERLITE_PROFILE
+	// Draw the per-stage min / avg / p99 table over each frame
+	void SetProfilerOverlay(bool bShow) { m_bProfilerOverlay = bShow; }
+	bool GetProfilerOverlay() { return m_bProfilerOverlay; }
+#endif
+
 
 protected:
+#ifdef _WIN32
 	int Error(const wchar_t* msg)
 	{
 		wchar_t buf[256];
@@ -1320,7 +2149,17 @@ protected:
 		wprintf(L"ERROR: %s\n\t%s\n", msg, buf);
 		return 0;
 	}
+#else
+	int Error(const wchar_t* msg)
+	{
+		int err = errno;
+		RestoreTerminal();
+		fprintf(stderr, "ERROR: %ls\n\t%s\n", msg, strerror(err));
+		return 0;
+	}
+#endif
 
+#ifdef _WIN32
 	static BOOL CloseHandler(DWORD evt)
 	{
 		// Note this gets called in a seperate OS thread, so it must
@@ -1336,23 +2175,67 @@ protected:
 		}
 		return true;
 	}
+#else
+	static void CloseHandler(int /*sig*/)
+	{
+		// Signal context, so just stop the game loop; GameThread cleans up
+		m_bAtomActive = false;
+	}
+#endif
 
 protected:
 	int m_nScreenWidth;
 	int m_nScreenHeight;
-	CHAR_INFO* m_bufScreen;
+	CHAR_INFO* m_bufScreen = nullptr;
+	uint32_t* m_bufShade = nullptr;
+	uint8_t* m_bufIndex = nullptr;
+	Quantizer m_quantizer;
+	std::string m_sAnsiFrame;
+	std::vector<olcFrameOutput*> m_vecFrameOutputs;
+	uint64_t m_nFrame = 0;
+	bool m_bHeadless = false;
+	float m_fFixedTimestep = 0.0f;
 	std::wstring m_sAppName;
 	HANDLE m_hOriginalConsole;
 	CONSOLE_SCREEN_BUFFER_INFO m_OriginalConsoleInfo;
 	HANDLE m_hConsole;
 	HANDLE m_hConsoleIn;
 	SMALL_RECT m_rectWindow;
-	short m_keyOldState[256] = { 0 };
-	short m_keyNewState[256] = { 0 };
-	bool m_mouseOldState[5] = { 0 };
-	bool m_mouseNewState[5] = { 0 };
 	bool m_bConsoleInFocus = true;
 	bool m_bEnableSound = false;
+#ifndef _WIN32
+	bool m_bTerminalActive = false;
+	bool m_bStdinRaw = false;
+	termios m_termiosOriginal;
+#endif
+
+	// Input thread -> game thread
+	SpscQueue<inputEvent, 1024> m_queueInput;
+	std::atomic<bool> m_bInputActive{ false };
+	std::atomic<uint32_t> m_nInputDropped{ 0 };
+	uint8_t m_nKeyTouched[256];
+	int m_nKeysTouched = 0;
+	sInputStats m_inputStats;
+
+	// Overdraw debug mode
+	uint64_t m_nCellsFilled = 0;
+	OVERDRAW_MODE m_overdrawMode = OVERDRAW_OFF;
+	OverdrawCounter m_overdraw;
+	overdrawStats m_overdrawStats;
+
+	// Packed copy of a reduced-size frame for UpscaleScreen (bilinear)
+	std::vector<uint32_t> m_vecScaleShade;
+	std::vector<CHAR_INFO> m_vecScaleCells;
+
+	// Input recording / replay
+	InputRecorder m_inputRecorder;
+	InputReplayer m_inputReplayer;
+
+#ifdef RENDERLITE_PROFILE
+	bool m_bProfilerOverlay = false;
+	uint64_t m_nProfilerRefresh = 0;
+	Profiler::stageSummary m_profilerSummary[PROFILE_STAGES];
+#endif
 
 	// These need to be static because of the OnDestroy call the OS may make. The OS
 	// spawns a special thread just for that
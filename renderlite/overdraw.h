@@ -0,0 +1,214 @@
+// overdraw.h : per-cell write counts and per-tile fill time, for seeing where fill goes.
+//
+// While the engine's overdraw mode is on, every cell write through Draw, DrawShade and
+// FillTriangleShade bumps that cell's count (screen clears do not count), so after a
+// painter's-algorithm frame each cell holds how many times it was drawn. Optionally
+// each FillTriangleShade call is timed too and its time shared out over the
+// OVERDRAW_TILE x OVERDRAW_TILE tiles it touched, in proportion to the cells it wrote
+// in each.
+//
+// The engine can show either as a heatmap in place of the frame, through the console
+// colour attributes, and both can be written as PGM images.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+enum OVERDRAW_MODE
+{
+    OVERDRAW_OFF,
+    // count writes, keep the frame as drawn
+    OVERDRAW_COUNT,
+    // count writes and show them as a heatmap instead of the frame
+    OVERDRAW_HEATMAP,
+    // also time fills per tile and show that as the heatmap
+    OVERDRAW_TILE_TIME,
+};
+
+// tiles are OVERDRAW_TILE x OVERDRAW_TILE cells
+static const int OVERDRAW_TILE = 8;
+
+// a cell this many writes deep counts as heavily overdrawn in the stats
+static const int OVERDRAW_HEAVY = 5;
+
+struct overdrawStats
+{
+    // writes per cell, over the cells written at least once
+    float fAverage = 0.0f;
+    int nMax = 0;
+    // share of the screen written at all, and OVERDRAW_HEAVY times or more
+    float fCoverage = 0.0f;
+    float fHeavy = 0.0f;
+    uint64_t nWrites = 0;
+    // fill time accounted to tiles (OVERDRAW_TILE_TIME only)
+    float fFillMs = 0.0f;
+};
+
+inline int64_t overdrawNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class OverdrawCounter
+{
+public:
+    int nWidth = 0;
+    int nHeight = 0;
+    int nTilesX = 0;
+    int nTilesY = 0;
+
+    void Resize(int width, int height)
+    {
+        nWidth = width;
+        nHeight = height;
+        nTilesX = (width + OVERDRAW_TILE - 1) / OVERDRAW_TILE;
+        nTilesY = (height + OVERDRAW_TILE - 1) / OVERDRAW_TILE;
+        vecCount.assign((size_t)width * height, 0);
+        vecTileNs.assign((size_t)nTilesX * nTilesY, 0);
+        vecTileCells.assign(vecTileNs.size(), 0);
+        vecTouched.clear();
+        vecTouched.reserve(vecTileNs.size());
+    }
+
+    void BeginFrame()
+    {
+        std::fill(vecCount.begin(), vecCount.end(), (uint16_t)0);
+        std::fill(vecTileNs.begin(), vecTileNs.end(), 0);
+    }
+
+    void Cell(int x, int y)
+    {
+        uint16_t& n = vecCount[(size_t)y * nWidth + x];
+        if (n < 0xFFFF)
+            n++;
+    }
+
+    // one span of a fill, x0..x1 inclusive and already clipped to the screen
+    void Span(int x0, int x1, int y)
+    {
+        if (x0 > x1)
+            return;
+        uint16_t* row = &vecCount[(size_t)y * nWidth];
+        for (int x = x0; x <= x1; x++)
+            if (row[x] < 0xFFFF)
+                row[x]++;
+
+        if (!bTiming)
+            return;
+        // cells per tile for this fill, shared out in EndFill
+        int* tiles = &vecTileCells[(size_t)(y / OVERDRAW_TILE) * nTilesX];
+        for (int tx = x0 / OVERDRAW_TILE; tx <= x1 / OVERDRAW_TILE; tx++)
+        {
+            int nCells = std::min(x1, tx * OVERDRAW_TILE + OVERDRAW_TILE - 1) - std::max(x0, tx * OVERDRAW_TILE) + 1;
+            int& n = tiles[tx];
+            if (n == 0)
+                vecTouched.push_back((int)(&n - vecTileCells.data()));
+            n += nCells;
+        }
+    }
+
+    // time one fill: spans between BeginFill and EndFill share its duration
+    void BeginFill()
+    {
+        bTiming = true;
+        nFillStart = overdrawNow();
+    }
+
+    void EndFill()
+    {
+        int64_t nNs = overdrawNow() - nFillStart;
+        bTiming = false;
+
+        int64_t nCells = 0;
+        for (int t : vecTouched)
+            nCells += vecTileCells[t];
+        for (int t : vecTouched)
+        {
+            vecTileNs[t] += nNs * vecTileCells[t] / std::max<int64_t>(nCells, 1);
+            vecTileCells[t] = 0;
+        }
+        vecTouched.clear();
+    }
+
+    overdrawStats Stats() const
+    {
+        overdrawStats st;
+        uint64_t nCovered = 0, nHeavy = 0;
+        for (uint16_t n : vecCount)
+        {
+            st.nWrites += n;
+            nCovered += n > 0;
+            nHeavy += n >= OVERDRAW_HEAVY;
+            st.nMax = std::max<int>(st.nMax, n);
+        }
+        size_t nCells = std::max<size_t>(vecCount.size(), 1);
+        st.fAverage = nCovered ? (float)st.nWrites / nCovered : 0.0f;
+        st.fCoverage = (float)nCovered / nCells;
+        st.fHeavy = (float)nHeavy / nCells;
+
+        int64_t nNs = 0;
+        for (int64_t t : vecTileNs)
+            nNs += t;
+        st.fFillMs = nNs * 1e-6f;
+        return st;
+    }
+
+    uint16_t Count(int x, int y) const
+    {
+        return vecCount[(size_t)y * nWidth + x];
+    }
+
+    int64_t TileNs(int x, int y) const
+    {
+        return vecTileNs[(size_t)(y / OVERDRAW_TILE) * nTilesX + x / OVERDRAW_TILE];
+    }
+
+    int64_t MaxTileNs() const
+    {
+        return vecTileNs.empty() ? 0 : *std::max_element(vecTileNs.begin(), vecTileNs.end());
+    }
+
+    // write counts per cell (clamped to 255) as a binary PGM, one pixel per cell
+    bool WriteCountsPGM(const char* sPath) const
+    {
+        std::vector<uint8_t> pixels(vecCount.size());
+        for (size_t i = 0; i < vecCount.size(); i++)
+            pixels[i] = (uint8_t)std::min<int>(vecCount[i], 255);
+        return WritePGM(sPath, nWidth, nHeight, pixels);
+    }
+
+    // fill time per tile as a PGM, one pixel per tile, scaled so the slowest tile is 255
+    bool WriteTileTimePGM(const char* sPath) const
+    {
+        int64_t nMax = std::max<int64_t>(MaxTileNs(), 1);
+        std::vector<uint8_t> pixels(vecTileNs.size());
+        for (size_t i = 0; i < vecTileNs.size(); i++)
+            pixels[i] = (uint8_t)(vecTileNs[i] * 255 / nMax);
+        return WritePGM(sPath, nTilesX, nTilesY, pixels);
+    }
+
+private:
+    std::vector<uint16_t> vecCount;
+    std::vector<int64_t> vecTileNs;
+    // cells the fill being timed wrote per tile, and which tiles those are
+    std::vector<int> vecTileCells;
+    std::vector<int> vecTouched;
+    bool bTiming = false;
+    int64_t nFillStart = 0;
+
+    static bool WritePGM(const char* sPath, int w, int h, const std::vector<uint8_t>& pixels)
+    {
+        FILE* f = fopen(sPath, "wb");
+        if (f == nullptr)
+            return false;
+        fprintf(f, "P5\n%d %d\n255\n", w, h);
+        fwrite(pixels.data(), 1, pixels.size(), f);
+        fclose(f);
+        return true;
+    }
+};
@@ -0,0 +1,183 @@
+// perfcounters.h : hardware performance counters of the calling thread (Linux perf_event_open).
+//
+// Opens cycles, instructions, L1D read misses, last-level cache misses and branch
+// mispredicts as one event group, so they are scheduled onto the PMU together and one
+// read() returns all of them. Counters the CPU or hypervisor does not provide are left
+// out of the group and read as 0; Available() says which ones are real. Where nothing
+// can be opened (no PMU in a VM, perf_event_paranoid, other platforms) Open() fails
+// with a reason and the caller carries on without counters.
+//
+// The profiler reads the group at the start and end of every PROFILE_SCOPE once
+// counters are enabled (see Profiler::EnableCounters), which costs a syscall per read.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+enum PERF_COUNTER : uint8_t
+{
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_COUNTERS,
+};
+
+static const char* const PERF_COUNTER_NAME[PERF_COUNTERS] =
+{
+    "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses",
+};
+
+#ifdef __linux__
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+class PerfCounters
+{
+public:
+    ~PerfCounters()
+    {
+        Close();
+    }
+
+    // open the group on the calling thread, user space only
+    bool Open(std::string& sWhy)
+    {
+        Close();
+
+        static const struct { uint32_t type; uint64_t config; } events[PERF_COUNTERS] =
+        {
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+            { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+        };
+
+        int nErr = 0;
+        for (int c = 0; c < PERF_COUNTERS; c++)
+        {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = events[c].type;
+            attr.config = events[c].config;
+            attr.read_format = PERF_FORMAT_GROUP;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.disabled = nLeader < 0;
+
+            int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, nLeader, 0);
+            if (fd < 0)
+            {
+                nErr = errno;
+                continue;
+            }
+            if (nLeader < 0)
+                nLeader = fd;
+            nFd[c] = fd;
+            nSlot[c] = nOpen++;
+            nAvailable |= 1u << c;
+        }
+
+        if (nLeader < 0)
+        {
+            char buf[160];
+            snprintf(buf, sizeof(buf), "%s (perf_event_paranoid %d)", strerror(nErr), Paranoid());
+            sWhy = buf;
+            return false;
+        }
+
+        ioctl(nLeader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(nLeader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        return true;
+    }
+
+    void Close()
+    {
+        for (int c = PERF_COUNTERS - 1; c >= 0; c--)
+            if (nFd[c] >= 0)
+            {
+                close(nFd[c]);
+                nFd[c] = -1;
+            }
+        nLeader = -1;
+        nOpen = 0;
+        nAvailable = 0;
+    }
+
+    bool IsOpen() const
+    {
+        return nLeader >= 0;
+    }
+
+    // bit per PERF_COUNTER that is really being counted
+    uint32_t Available() const
+    {
+        return nAvailable;
+    }
+
+    // running totals since Open, 0 for unavailable counters
+    void Read(uint64_t nValue[PERF_COUNTERS]) const
+    {
+        // PERF_FORMAT_GROUP: the number of events, then one value each
+        uint64_t buf[1 + PERF_COUNTERS];
+        if (nLeader < 0 || read(nLeader, buf, sizeof(uint64_t) * (1 + nOpen)) <= 0)
+        {
+            memset(nValue, 0, sizeof(uint64_t) * PERF_COUNTERS);
+            return;
+        }
+        for (int c = 0; c < PERF_COUNTERS; c++)
+            nValue[c] = nFd[c] >= 0 ? buf[1 + nSlot[c]] : 0;
+    }
+
+private:
+    int nFd[PERF_COUNTERS] = { -1, -1, -1, -1, -1 };
+    // position of each counter in the group read
+    int nSlot[PERF_COUNTERS] = { 0 };
+    int nLeader = -1;
+    int nOpen = 0;
+    uint32_t nAvailable = 0;
+
+    static int Paranoid()
+    {
+        int n = -99;
+        if (FILE* f = fopen("/proc/sys/kernel/perf_event_paranoid", "r"))
+        {
+            if (fscanf(f, "%d", &n) != 1)
+                n = -99;
+            fclose(f);
+        }
+        return n;
+    }
+};
+
+#else
+
+class PerfCounters
+{
+public:
+    bool Open(std::string& sWhy)
+    {
+        sWhy = "perf_event_open is Linux only";
+        return false;
+    }
+    void Close() {}
+    bool IsOpen() const { return false; }
+    uint32_t Available() const { return 0; }
+    void Read(uint64_t nValue[PERF_COUNTERS]) const
+    {
+        for (int c = 0; c < PERF_COUNTERS; c++)
+            nValue[c] = 0;
+    }
+};
+
+#endif
@@ -0,0 +1,401 @@
+// profiler.h : per-stage frame timers, an on-screen summary and Chrome trace export.
+//
+// Build with RENDERLITE_PROFILE defined to enable it; otherwise every PROFILE_* macro
+// expands to nothing and none of this is compiled.
+//
+//   { PROFILE_SCOPE(PROFILE_RASTER); ... }     // times the enclosing block
+//
+// A scope writes one {stage, begin, end} record into a ring owned by the calling
+// thread, so timing never takes a lock. Once per frame the game thread drains every
+// thread's ring (PROFILE_END_FRAME), adds the durations up per stage, and keeps the last
+// PROFILE_HISTORY frames for the min / avg / p99 table drawn by the overlay. While a
+// trace is being captured the raw records are kept as well and can be written as Chrome
+// trace_event JSON (open in chrome://tracing or ui.perfetto.dev).
+//
+// A ring that fills up between two drains drops the records that do not fit. The drops
+// are counted per frame (Profiler::LastFrameDropped), shown under the overlay and marked
+// in the trace, since the stage totals of such a frame come out short.
+//
+// Profiler::EnableCounters() additionally has every scope read the thread's hardware
+// counters (see perfcounters.h), adding cycles, instructions, cache misses and branch
+// mispredicts per stage to the per-frame totals and to the trace. Built with
+// RENDERLITE_TRACK_ALLOCS too, each scope also counts the heap allocations made inside
+// it (see alloctrack.h).
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <chrono>
+
+enum PROFILE_STAGE : uint8_t
+{
+    PROFILE_INPUT,
+    // terrain chunks paged in and out (see TerrainStreamer::Update), or a newly loaded
+    // asset swapped in (see assetloader.h)
+    PROFILE_STREAM,
+    // whole instances outside the view skipped (see Scene::Cull)
+    PROFILE_FRUSTUM,
+    // level of detail chosen per instance (see Scene::SelectLods)
+    PROFILE_LOD,
+    PROFILE_TRANSFORM,
+    PROFILE_CULL,
+    PROFILE_LIGHT,
+    PROFILE_CLIP,
+    PROFILE_SORT,
+    PROFILE_CLEAR,
+    PROFILE_RASTER,
+    PROFILE_PRESENT,
+    // the whole frame, the stages above are nested inside it
+    PROFILE_FRAME,
+    PROFILE_STAGES,
+};
+
+static const char* const PROFILE_STAGE_NAME[PROFILE_STAGES] =
+{
+    "input", "stream", "frustum", "lod", "transform", "cull", "light", "clip", "sort", "clear", "raster", "present", "frame",
+};
+
+#ifdef RENDERLITE_PROFILE
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <string>
+#include "spscqueue.h"
+#include "perfcounters.h"
+#include "alloctrack.h"
+
+// frames of history behind the overlay's min / avg / p99
+static const int PROFILE_HISTORY = 128;
+
+struct profileEvent
+{
+    int64_t nBeginNs;
+    int64_t nEndNs;
+    uint8_t stage;
+    // hardware counter deltas over the scope, 0 unless counters are enabled
+    uint64_t nCounter[PERF_COUNTERS];
+    // heap allocations made inside the scope, 0 unless allocations are tracked
+    uint32_t nAllocs;
+    uint32_t nAllocBytes;
+};
+
+inline int64_t profileNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class Profiler
+{
+public:
+    struct stageSummary
+    {
+        float fMinMs = 0.0f;
+        float fAvgMs = 0.0f;
+        float fP99Ms = 0.0f;
+    };
+
+    static Profiler& Get()
+    {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    // the calling thread's ring, created on its first scope
+    void Record(const profileEvent& e)
+    {
+        thread_local threadRing* ring = nullptr;
+        if (ring == nullptr)
+            ring = Register();
+        if (!ring->events.Push(e))
+            nDropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // game thread, once per frame after the frame scope has closed
+    void EndFrame()
+    {
+        float fStage[PROFILE_STAGES] = { 0.0f };
+        uint64_t nStageCounter[PROFILE_STAGES][PERF_COUNTERS] = {};
+        allocCount stageAllocs[PROFILE_STAGES];
+
+        std::unique_lock<std::mutex> lm(mux);
+        for (auto& ring : rings)
+        {
+            profileEvent e;
+            while (ring->events.Pop(e))
+            {
+                fStage[e.stage] += (float)(e.nEndNs - e.nBeginNs) * 1e-6f;
+                for (int c = 0; c < PERF_COUNTERS; c++)
+                    nStageCounter[e.stage][c] += e.nCounter[c];
+                stageAllocs[e.stage].nAllocs += e.nAllocs;
+                stageAllocs[e.stage].nBytes += e.nAllocBytes;
+                if (nTraceFrames > 0)
+                    trace.push_back({ e, ring->nTid });
+            }
+        }
+
+        // records pushed after the rings were drained count towards the next frame
+        uint32_t nDroppedNow = nDropped.load(std::memory_order_relaxed);
+        nLastDropped = nDroppedNow - nDroppedSeen;
+        nDroppedSeen = nDroppedNow;
+        if (nTraceFrames > 0 && nLastDropped > 0)
+            traceDrops.push_back({ profileNow(), nLastDropped });
+
+        for (int s = 0; s < PROFILE_STAGES; s++)
+        {
+            history[s][nFrames % PROFILE_HISTORY] = fStage[s];
+            last[s] = fStage[s];
+            std::copy(nStageCounter[s], nStageCounter[s] + PERF_COUNTERS, lastCounter[s]);
+            lastAllocs[s] = stageAllocs[s];
+        }
+        nFrames++;
+        if (nTraceFrames > 0)
+            nTraceFrames--;
+    }
+
+    // min / avg / p99 of one stage's per-frame total over the recent history
+    stageSummary Summary(PROFILE_STAGE stage) const
+    {
+        int n = (int)std::min<uint64_t>(nFrames, PROFILE_HISTORY);
+        stageSummary sum;
+        if (n == 0)
+            return sum;
+
+        float fSorted[PROFILE_HISTORY];
+        std::copy(history[stage], history[stage] + n, fSorted);
+        int p99 = std::min(n - 1, (n * 99) / 100);
+        std::nth_element(fSorted, fSorted + p99, fSorted + n);
+        sum.fP99Ms = fSorted[p99];
+        sum.fMinMs = *std::min_element(fSorted, fSorted + n);
+
+        float fTotal = 0.0f;
+        for (int i = 0; i < n; i++)
+            fTotal += fSorted[i];
+        sum.fAvgMs = fTotal / n;
+        return sum;
+    }
+
+    // keep raw records for the next nFrames frames
+    void BeginTrace(int nFrames)
+    {
+        std::unique_lock<std::mutex> lm(mux);
+        trace.clear();
+        trace.reserve((size_t)nFrames * PROFILE_STAGES * 2);
+        traceDrops.clear();
+        nTraceFrames = nFrames;
+    }
+
+    // write what has been captured as Chrome trace_event JSON
+    bool WriteTrace(const char* sPath)
+    {
+        FILE* f = fopen(sPath, "w");
+        if (f == nullptr)
+            return false;
+
+        std::unique_lock<std::mutex> lm(mux);
+        int64_t t0 = trace.empty() ? 0 : trace.front().e.nBeginNs;
+        for (auto& t : trace)
+            t0 = std::min(t0, t.e.nBeginNs);
+        uint64_t nTraceDropped = 0;
+        for (auto& d : traceDrops)
+            nTraceDropped += d.nDropped;
+
+        fprintf(f, "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":%llu},\"traceEvents\":[\n",
+            (unsigned long long)nTraceDropped);
+        for (auto& ring : rings)
+            fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}},\n",
+                ring->nTid, ring->nTid == 0 ? "game" : "worker");
+        // an instant on the game thread at the end of each frame that lost records
+        for (auto& d : traceDrops)
+            fprintf(f, "{\"name\":\"dropped\",\"cat\":\"renderlite\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":%.3f,\"args\":{\"events\":%u}},\n",
+                (d.nEndNs - t0) * 1e-3, d.nDropped);
+        for (size_t i = 0; i < trace.size(); i++)
+        {
+            const traceEvent& t = trace[i];
+            fprintf(f, "{\"name\":\"%s\",\"cat\":\"renderlite\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                PROFILE_STAGE_NAME[t.e.stage], t.nTid, (t.e.nBeginNs - t0) * 1e-3, (t.e.nEndNs - t.e.nBeginNs) * 1e-3);
+            if (nCounterMask != 0)
+            {
+                const char* sep = "";
+                fprintf(f, ",\"args\":{");
+                for (int c = 0; c < PERF_COUNTERS; c++)
+                    if (nCounterMask & (1u << c))
+                    {
+                        fprintf(f, "%s\"%s\":%llu", sep, PERF_COUNTER_NAME[c], (unsigned long long)t.e.nCounter[c]);
+                        sep = ",";
+                    }
+                fprintf(f, "}");
+            }
+            fprintf(f, "}%s\n", i + 1 < trace.size() ? "," : "");
+        }
+        fprintf(f, "]}\n");
+        fclose(f);
+        return true;
+    }
+
+    // per-stage totals of the most recently ended frame
+    void LastFrame(float fStageMs[PROFILE_STAGES]) const
+    {
+        std::copy(last, last + PROFILE_STAGES, fStageMs);
+    }
+
+    // Have every scope from now on count hardware events too. Counters are per thread
+    // and opened on each thread's first scope; this opens the calling thread's group to
+    // check they work and fails, with the reason, if they do not
+    bool EnableCounters(std::string& sWhy)
+    {
+        threadCounters& tc = ThreadCounters();
+        if (!tc.counters.IsOpen())
+        {
+            sWhy = tc.sWhy;
+            return false;
+        }
+        nCounterMask = tc.counters.Available();
+        bCounters.store(true, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool CountersEnabled() const
+    {
+        return bCounters.load(std::memory_order_relaxed);
+    }
+
+    // bit per PERF_COUNTER that is really counted, 0 while counters are off
+    uint32_t CountersAvailable() const
+    {
+        return nCounterMask;
+    }
+
+    // the calling thread's counter totals, all 0 if it has none
+    void ReadCounters(uint64_t nValue[PERF_COUNTERS])
+    {
+        ThreadCounters().counters.Read(nValue);
+    }
+
+    // per-stage counter totals of the most recently ended frame
+    void LastFrameCounters(uint64_t nStageCounter[PROFILE_STAGES][PERF_COUNTERS]) const
+    {
+        for (int s = 0; s < PROFILE_STAGES; s++)
+            std::copy(lastCounter[s], lastCounter[s] + PERF_COUNTERS, nStageCounter[s]);
+    }
+
+    // per-stage heap allocations of the most recently ended frame
+    void LastFrameAllocs(allocCount stageAllocs[PROFILE_STAGES]) const
+    {
+        std::copy(lastAllocs, lastAllocs + PROFILE_STAGES, stageAllocs);
+    }
+
+    uint64_t Frames() const { return nFrames; }
+    // records lost to full rings, in total and in the most recently ended frame
+    uint32_t Dropped() const { return nDropped.load(std::memory_order_relaxed); }
+    uint32_t LastFrameDropped() const { return nLastDropped; }
+
+private:
+    struct threadRing
+    {
+        SpscQueue<profileEvent, 1024> events;
+        int nTid = 0;
+    };
+
+    struct traceEvent
+    {
+        profileEvent e;
+        int nTid;
+    };
+
+    struct traceDrop
+    {
+        int64_t nEndNs;
+        uint32_t nDropped;
+    };
+
+    struct threadCounters
+    {
+        PerfCounters counters;
+        std::string sWhy;
+
+        threadCounters()
+        {
+            counters.Open(sWhy);
+        }
+    };
+
+    std::mutex mux;
+    std::vector<std::unique_ptr<threadRing>> rings;
+    std::vector<traceEvent> trace;
+    std::vector<traceDrop> traceDrops;
+    int nTraceFrames = 0;
+    float history[PROFILE_STAGES][PROFILE_HISTORY] = {};
+    float last[PROFILE_STAGES] = {};
+    uint64_t lastCounter[PROFILE_STAGES][PERF_COUNTERS] = {};
+    allocCount lastAllocs[PROFILE_STAGES];
+    std::atomic<bool> bCounters{ false };
+    uint32_t nCounterMask = 0;
+    uint64_t nFrames = 0;
+    std::atomic<uint32_t> nDropped{ 0 };
+    uint32_t nDroppedSeen = 0;
+    uint32_t nLastDropped = 0;
+
+    static threadCounters& ThreadCounters()
+    {
+        thread_local threadCounters tc;
+        return tc;
+    }
+
+    threadRing* Register()
+    {
+        std::unique_lock<std::mutex> lm(mux);
+        rings.emplace_back(new threadRing());
+        rings.back()->nTid = (int)rings.size() - 1;
+        return rings.back().get();
+    }
+};
+
+class profileScope
+{
+public:
+    profileScope(PROFILE_STAGE stage) : stage(stage), bCounters(Profiler::Get().CountersEnabled())
+    {
+        if (bCounters)
+            Profiler::Get().ReadCounters(nBegin);
+        allocBegin = allocThreadCount();
+        nBeginNs = profileNow();
+    }
+
+    ~profileScope()
+    {
+        const allocCount& allocEnd = allocThreadCount();
+        profileEvent e{ nBeginNs, profileNow(), stage, {},
+            (uint32_t)(allocEnd.nAllocs - allocBegin.nAllocs), (uint32_t)(allocEnd.nBytes - allocBegin.nBytes) };
+        if (bCounters)
+        {
+            Profiler::Get().ReadCounters(e.nCounter);
+            for (int c = 0; c < PERF_COUNTERS; c++)
+                e.nCounter[c] -= nBegin[c];
+        }
+        Profiler::Get().Record(e);
+    }
+
+private:
+    PROFILE_STAGE stage;
+    bool bCounters;
+    int64_t nBeginNs;
+    uint64_t nBegin[PERF_COUNTERS];
+    allocCount allocBegin;
+};
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(stage) profileScope PROFILE_CONCAT(profileScope_, __LINE__)(stage)
+#define PROFILE_END_FRAME() Profiler::Get().EndFrame()
+
+#else
+
+#define PROFILE_SCOPE(stage) ((void)0)
+#define PROFILE_END_FRAME() ((void)0)
+
+#endif
@@ -0,0 +1,358 @@
+// quantize.h : maps the shaded RGB framebuffer onto the console output palettes.
+//
+// Shading is rendered into an 8-bit RGBX buffer, one uint32_t per console cell
+// (r in the low byte, see shadeRGB). Quantizer::Quantize() converts that buffer to the
+// selected output target in a single pass: each cell is ordered-dithered with a 4x4 Bayer
+// matrix, reduced to 5 bits per channel and looked up in a 32x32x32 table built once per
+// target. The top byte of a shade cell flags whether the cell is shaded at all; cells with
+// a zero top byte belong to the console glyph buffer (text, wireframe, overlays) and are
+// left alone.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define QUANTIZE_SSE2
+#endif
+
+enum OUTPUT_TARGET
+{
+    // 16 console colours mixed with the quarter/half/three-quarter shade glyphs (CHAR_INFO)
+    OUTPUT_LEGACY16,
+    // xterm 256-colour palette index per cell
+    OUTPUT_XTERM256,
+    // 24-bit RGB per cell, no palette and no dithering
+    OUTPUT_TRUECOLOR,
+};
+
+// pack an 8-bit colour into a shade cell (top byte marks the cell as shaded)
+inline uint32_t shadeRGB(uint8_t r, uint8_t g, uint8_t b)
+{
+    return (uint32_t)r | ((uint32_t)g << 8) | ((uint32_t)b << 16) | 0xFF000000u;
+}
+
+inline uint8_t shadeR(uint32_t s) { return (uint8_t)(s); }
+inline uint8_t shadeG(uint32_t s) { return (uint8_t)(s >> 8); }
+inline uint8_t shadeB(uint32_t s) { return (uint8_t)(s >> 16); }
+inline bool isShaded(uint32_t s) { return (s >> 24) != 0; }
+
+// RGB of the 16 console colours, in console attribute order
+// (bit 0 blue, bit 1 green, bit 2 red, bit 3 intensity)
+static const uint8_t QUANTIZE_CONSOLE_RGB[16][3] =
+{
+    {   0,   0,   0 }, {   0,   0, 128 }, {   0, 128,   0 }, {   0, 128, 128 },
+    { 128,   0,   0 }, { 128,   0, 128 }, { 128, 128,   0 }, { 192, 192, 192 },
+    { 128, 128, 128 }, {   0,   0, 255 }, {   0, 255,   0 }, {   0, 255, 255 },
+    { 255,   0,   0 }, { 255,   0, 255 }, { 255, 255,   0 }, { 255, 255, 255 },
+};
+
+// RGB of an xterm 256-colour palette entry (16..231 colour cube, 232..255 grey ramp)
+inline void xtermRGB(int i, uint8_t rgb[3])
+{
+    static const uint8_t level[6] = { 0, 95, 135, 175, 215, 255 };
+    if (i < 16)
+    {
+        // ANSI order has red and blue bits swapped relative to the console attributes
+        const uint8_t* c = QUANTIZE_CONSOLE_RGB[((i & 1) << 2) | (i & 2) | ((i & 4) >> 2) | (i & 8)];
+        rgb[0] = c[0]; rgb[1] = c[1]; rgb[2] = c[2];
+    }
+    else if (i < 232)
+    {
+        i -= 16;
+        rgb[0] = level[i / 36];
+        rgb[1] = level[(i / 6) % 6];
+        rgb[2] = level[i % 6];
+    }
+    else
+    {
+        rgb[0] = rgb[1] = rgb[2] = (uint8_t)(8 + 10 * (i - 232));
+    }
+}
+
+// colour a console cell shows on screen, packed like a shade cell. Glyph cells
+// (cell = CHAR_INFO packed as glyph | attr << 16) mix foreground over background by the
+// glyph's coverage; shaded cells use the shade or palette colour of the target
+inline uint32_t resolveRGB(uint32_t cell, uint32_t shade, uint8_t index, OUTPUT_TARGET target)
+{
+    if (isShaded(shade) && target == OUTPUT_TRUECOLOR)
+        return shade;
+
+    if (isShaded(shade) && target == OUTPUT_XTERM256)
+    {
+        uint8_t rgb[3];
+        xtermRGB(index, rgb);
+        return shadeRGB(rgb[0], rgb[1], rgb[2]);
+    }
+
+    // glyph coverage in quarters, text characters count as half covered
+    int cover;
+    switch (cell & 0xFFFF)
+    {
+    case 0x2588: cover = 4; break;
+    case 0x2593: cover = 3; break;
+    case 0x2592: cover = 2; break;
+    case 0x2591: cover = 1; break;
+    case 0: case ' ': cover = 0; break;
+    default: cover = 2; break;
+    }
+
+    const uint8_t* fg = QUANTIZE_CONSOLE_RGB[(cell >> 16) & 0x0F];
+    const uint8_t* bg = QUANTIZE_CONSOLE_RGB[(cell >> 20) & 0x0F];
+    return shadeRGB((uint8_t)((fg[0] * cover + bg[0] * (4 - cover)) / 4),
+                    (uint8_t)((fg[1] * cover + bg[1] * (4 - cover)) / 4),
+                    (uint8_t)((fg[2] * cover + bg[2] * (4 - cover)) / 4));
+}
+
+class Quantizer
+{
+public:
+    void SetTarget(OUTPUT_TARGET t)
+    {
+        target = t;
+
+        switch (target)
+        {
+        case OUTPUT_LEGACY16:
+            if (lutLegacy.empty()) buildLegacyLut();
+            // glyph mixes of the grey levels are ~20 apart
+            buildDither(24);
+            break;
+        case OUTPUT_XTERM256:
+            if (lutXterm.empty()) buildXtermLut();
+            // colour cube levels are ~40 apart
+            buildDither(32);
+            break;
+        case OUTPUT_TRUECOLOR:
+            buildDither(0);
+            break;
+        }
+    }
+
+    OUTPUT_TARGET Target() const { return target; }
+
+    // run the portable loop even where the SSE2 one is built, so the two can be timed
+    // and checked against each other (see renderlite_bench --micro)
+    void SetScalar(bool b) { bScalar = b; }
+
+    // quantize a w x h shade buffer into the current target.
+    // legacy16 writes shaded cells of 'cells' (CHAR_INFO packed as glyph | attr << 16),
+    // xterm256 writes one palette index per cell into 'index',
+    // truecolor reads the shade buffer directly and needs no pass.
+    void Quantize(const uint32_t* shade, uint32_t* cells, uint8_t* index, int w, int h)
+    {
+        if (target == OUTPUT_LEGACY16)
+            quantizeRows(shade, cells, w, h, lutLegacy.data(), true);
+        else if (target == OUTPUT_XTERM256)
+            quantizeRows(shade, index, w, h, lutXterm.data(), false);
+    }
+
+private:
+    OUTPUT_TARGET target = OUTPUT_LEGACY16;
+    bool bScalar = false;
+
+    // 32x32x32 tables indexed by (r5 << 10) | (g5 << 5) | b5
+    std::vector<uint32_t> lutLegacy;
+    std::vector<uint8_t> lutXterm;
+
+    // per Bayer row: saturating add / subtract offsets for 4 consecutive RGBX cells
+    alignas(16) uint8_t ditherAdd[4][16];
+    alignas(16) uint8_t ditherSub[4][16];
+
+    static int lutIndex(uint32_t v)
+    {
+        return ((v << 7) & (31 << 10)) | ((v >> 6) & (31 << 5)) | ((v >> 19) & 31);
+    }
+
+    // centre of a LUT bin in 8-bit space
+    static float binCentre(int i)
+    {
+        return (float)i * 255.0f / 31.0f;
+    }
+
+    // 4x4 Bayer thresholds in [-0.5, 0.5) scaled by 'amplitude', plus half a LUT bin
+    // (4) so that the 5-bit truncation rounds to nearest
+    void buildDither(int amplitude)
+    {
+        static const int bayer[4][4] =
+        {
+            {  0,  8,  2, 10 },
+            { 12,  4, 14,  6 },
+            {  3, 11,  1,  9 },
+            { 15,  7, 13,  5 },
+        };
+
+        for (int y = 0; y < 4; y++)
+            for (int x = 0; x < 4; x++)
+            {
+                int d = (int)(((float)bayer[y][x] + 0.5f) / 16.0f * amplitude - 0.5f * amplitude) + 4;
+                for (int c = 0; c < 3; c++)
+                {
+                    ditherAdd[y][x * 4 + c] = (uint8_t)(d > 0 ? d : 0);
+                    ditherSub[y][x * 4 + c] = (uint8_t)(d < 0 ? -d : 0);
+                }
+                // never touch the shaded flag
+                ditherAdd[y][x * 4 + 3] = 0;
+                ditherSub[y][x * 4 + 3] = 0;
+            }
+    }
+
+    struct candidate
+    {
+        float r, g, b;
+        uint32_t out;
+    };
+
+    template <typename T>
+    static void buildLut(std::vector<T>& lut, const std::vector<candidate>& cands)
+    {
+        lut.resize(32 * 32 * 32);
+
+        for (int r = 0; r < 32; r++)
+            for (int g = 0; g < 32; g++)
+                for (int b = 0; b < 32; b++)
+                {
+                    float fr = binCentre(r), fg = binCentre(g), fb = binCentre(b);
+
+                    // nearest candidate, weighted toward green like the eye
+                    float best = 1e30f;
+                    uint32_t out = 0;
+                    for (auto& c : cands)
+                    {
+                        float dr = c.r - fr, dg = c.g - fg, db = c.b - fb;
+                        float d = 2.0f * dr * dr + 4.0f * dg * dg + 3.0f * db * db;
+                        if (d < best) { best = d; out = c.out; }
+                    }
+                    lut[(r << 10) | (g << 5) | b] = (T)out;
+                }
+    }
+
+    void buildLegacyLut()
+    {
+        // background colour, foreground colour and shade glyph coverage.
+        // Solid first, so a flat colour prefers the plain block over an equal mix
+        static const struct { uint16_t glyph; float cover; } glyphs[4] =
+        {
+            { 0x2588, 1.0f }, { 0x2591, 0.25f }, { 0x2592, 0.5f }, { 0x2593, 0.75f },
+        };
+
+        std::vector<candidate> cands;
+        for (int bg = 0; bg < 16; bg++)
+            for (int fg = 0; fg < 16; fg++)
+                for (auto& gl : glyphs)
+                {
+                    // a solid glyph hides the background, so only keep one of those
+                    if (gl.cover == 1.0f && bg != 0)
+                        continue;
+
+                    const uint8_t* cb = QUANTIZE_CONSOLE_RGB[bg];
+                    const uint8_t* cf = QUANTIZE_CONSOLE_RGB[fg];
+                    candidate c;
+                    c.r = cb[0] * (1.0f - gl.cover) + cf[0] * gl.cover;
+                    c.g = cb[1] * (1.0f - gl.cover) + cf[1] * gl.cover;
+                    c.b = cb[2] * (1.0f - gl.cover) + cf[2] * gl.cover;
+                    c.out = (uint32_t)gl.glyph | ((uint32_t)((bg << 4) | fg) << 16);
+
+                    // many mixes land on the same colour, keep the first
+                    bool dup = false;
+                    for (auto& o : cands)
+                        if (o.r == c.r && o.g == c.g && o.b == c.b) { dup = true; break; }
+                    if (!dup)
+                        cands.push_back(c);
+                }
+
+        buildLut(lutLegacy, cands);
+    }
+
+    void buildXtermLut()
+    {
+        // skip 0..15, terminals theme those freely
+        std::vector<candidate> cands;
+        for (int i = 16; i < 256; i++)
+        {
+            uint8_t rgb[3];
+            xtermRGB(i, rgb);
+            cands.push_back({ (float)rgb[0], (float)rgb[1], (float)rgb[2], (uint32_t)i });
+        }
+
+        buildLut(lutXterm, cands);
+    }
+
+    // dither, index and gather one frame. 'keepUnshaded' leaves destination cells whose
+    // shade flag is clear untouched (legacy target shares its buffer with the glyph layer)
+    template <typename T>
+    void quantizeRows(const uint32_t* shade, T* dst, int w, int h, const T* lut, bool keepUnshaded)
+    {
+        for (int y = 0; y < h; y++)
+        {
+            const uint32_t* src = shade + y * w;
+            T* out = dst + y * w;
+            int x = 0;
+
+#ifdef QUANTIZE_SSE2
+            const __m128i dAdd = _mm_load_si128((const __m128i*)ditherAdd[y & 3]);
+            const __m128i dSub = _mm_load_si128((const __m128i*)ditherSub[y & 3]);
+            const __m128i mR = _mm_set1_epi32(31 << 10);
+            const __m128i mG = _mm_set1_epi32(31 << 5);
+            const __m128i mB = _mm_set1_epi32(31);
+            alignas(16) uint32_t idx[4];
+
+            // 4 cells per step, Bayer columns line up with the 4 lanes
+            for (; x + 4 <= w && !bScalar; x += 4)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i*)(src + x));
+                __m128i d = _mm_subs_epu8(_mm_adds_epu8(v, dAdd), dSub);
+
+                __m128i i = _mm_or_si128(
+                    _mm_or_si128(_mm_and_si128(_mm_slli_epi32(d, 7), mR),
+                                 _mm_and_si128(_mm_srli_epi32(d, 6), mG)),
+                    _mm_and_si128(_mm_srli_epi32(d, 19), mB));
+                _mm_store_si128((__m128i*)idx, i);
+
+                if (keepUnshaded)
+                {
+                    // lanes whose shade flag is zero keep the destination cell
+                    __m128i keep = _mm_cmpeq_epi32(_mm_srli_epi32(v, 24), _mm_setzero_si128());
+                    if (_mm_movemask_epi8(keep) == 0)
+                    {
+                        out[x + 0] = lut[idx[0]]; out[x + 1] = lut[idx[1]];
+                        out[x + 2] = lut[idx[2]]; out[x + 3] = lut[idx[3]];
+                    }
+                    else
+                    {
+                        for (int k = 0; k < 4; k++)
+                            if (isShaded(src[x + k]))
+                                out[x + k] = lut[idx[k]];
+                    }
+                }
+                else
+                {
+                    out[x + 0] = lut[idx[0]]; out[x + 1] = lut[idx[1]];
+                    out[x + 2] = lut[idx[2]]; out[x + 3] = lut[idx[3]];
+                }
+            }
+#endif
+
+            // scalar tail (and the whole row without SSE2)
+            for (; x < w; x++)
+            {
+                if (keepUnshaded && !isShaded(src[x]))
+                    continue;
+
+                const uint8_t* dA = &ditherAdd[y & 3][(x & 3) * 4];
+                const uint8_t* dS = &ditherSub[y & 3][(x & 3) * 4];
+                uint32_t v = src[x], d = 0;
+                for (int c = 0; c < 3; c++)
+                {
+                    int ch = (int)((v >> (c * 8)) & 0xFF) + dA[c] - dS[c];
+                    ch = ch < 0 ? 0 : (ch > 255 ? 255 : ch);
+                    d |= (uint32_t)ch << (c * 8);
+                }
+                out[x] = lut[lutIndex(d)];
+            }
+        }
+    }
+};
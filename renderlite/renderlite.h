@@ -0,0 +1,1184 @@
+// renderlite.h : the renderlite 3D demo (olcEngine3D) and its settings, shared by the
+// interactive program (renderlite.cpp) and the benchmark (renderlite_bench.cpp).
+
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include "olcConsoleGameEngine.h"
+#include "shmframe.h"
+#include "framesink.h"
+#include "framestream.h"
+#include "framearena.h"
+#include "assetloader.h"
+#include "filewatch.h"
+#include "scene.h"
+#include "terrain.h"
+#include "vecmath.h"
+using namespace std;
+
+//const char* asset = "axis.obj";
+//const char* asset = "ship.obj";
+//const char* asset = "teapot.obj";
+const char* asset = "mountains.obj";
+// 'N' loads the next of these in the background and draws it in place of the asset once
+// it is ready
+const char* asset_cycle[] = { "axis.obj", "ship.obj", "teapot.obj", "mountains.obj" };
+// how far below normal priority the loading thread runs (0 = normal), so it takes time
+// the frames leave rather than time from them
+int asset_loader_nice = 10;
+// reload the asset in the background whenever its file is rewritten, once nothing has
+// touched it for asset_watch_quiet_ms (see filewatch.h, Linux only). Only with a console,
+// so recorded and measured runs draw what they started with
+bool asset_watch = true;
+int asset_watch_quiet_ms = 250;
+bool show_wireframe = false;
+bool show_clipping = false;
+float zdepth = 15.0f;
+bool rotate_obj = false;
+// copies of the asset to draw (see scene.h), on a square grid across the x-z plane
+// starting zdepth in front of the camera, scene_spacing apart (0 = three times the
+// asset's width)
+int scene_instances = 1;
+float scene_spacing = 0.0f;
+// scatter the instances through a cube around (0, 0, zdepth) instead, as densely as the grid
+bool scene_scatter = false;
+// skip instances whose bounds are wholly outside the view (see bvh.h); false puts every
+// one through the pipeline, for comparison
+bool scene_cull = true;
+// simplified versions of the asset made when it loads (see lod.h), each with about half
+// the triangles of the one before, up to lod_levels of them (0 = none)
+int lod_levels = 6;
+// draw each instance at the coarsest level whose simplification error covers at most
+// lod_error cells on screen, changing level only once lod_hysteresis (relative) past
+// that, so nothing pops back and forth at the threshold; 'L' toggles
+bool lod_enabled = true;
+float lod_error = 0.5f;
+float lod_hysteresis = 0.25f;
+// reorder every level's triangles and vertices for the vertex cache as it is loaded or
+// streamed in (see vcache.h); false keeps the file's order, for comparison
+bool mesh_reorder = true;
+// keep meshes packed (see mesh::Pack): 16-bit positions across each mesh's bounds and
+// 16- or 32-bit corner indices, for a fraction of the memory at a small cost in precision
+bool mesh_pack = false;
+// streamed terrain in place of the asset (see terrain.h): "synthetic" for a generated
+// world terrain_world_chunks chunks across, or an OBJ terrain to cut into chunks
+// (nullptr = off). The camera starts over the middle of it
+const char* terrain = nullptr;
+int terrain_world_chunks = 4096;
+float terrain_chunk_size = 16.0f;
+// grid cells along a side of a synthetic chunk
+int terrain_chunk_cells = 16;
+// keep the chunks within terrain_radius of the camera, or of the point terrain_lookahead
+// along the view, and never more than terrain_max_chunks
+float terrain_radius = 128.0f;
+float terrain_lookahead = 48.0f;
+int terrain_max_chunks = 256;
+// wait for missing chunks rather than draw without them, so frames do not depend on the
+// streaming thread's timing (recording, replay)
+bool terrain_wait = false;
+// console palette to quantize shading to (OUTPUT_LEGACY16, OUTPUT_XTERM256, OUTPUT_TRUECOLOR)
+OUTPUT_TARGET output_target = OUTPUT_LEGACY16;
+// also publish frames to a POSIX shared-memory ring for external viewers
+// (e.g. "/renderlite", read it with shmviewer), nullptr = off
+const char* shm_export = nullptr;
+// offline rendering: stream frames to a file, or "-" for stdout, and run without the
+// console at a fixed 1 / sink_fps timestep (nullptr = off)
+const char* sink_path = nullptr;
+SINK_FORMAT sink_format = SINK_Y4M;
+int sink_fps = 30;
+// compressed keyframe/delta stream of every frame for low-bandwidth viewers
+// (file, FIFO or "-" for stdout, decode with framedecode), nullptr = off
+const char* stream_path = nullptr;
+// frames to render before exiting (0 = run until closed), e.g. one turntable revolution
+int render_frames = 0;
+// count writes per cell from the start (OVERDRAW_COUNT), or show them as a heatmap
+// (OVERDRAW_HEATMAP, OVERDRAW_TILE_TIME); 'O' cycles through the modes
+OVERDRAW_MODE overdraw_mode = OVERDRAW_OFF;
+// on exit, print the last frame's overdraw and write its counts as a PGM (plus fill
+// time per tile as <name>.tiles.pgm with OVERDRAW_TILE_TIME), nullptr = off
+const char* overdraw_pgm = nullptr;
+// triangle counts per pipeline stage in the top-right corner ('I' toggles)
+bool show_pipeline_stats = false;
+// dynamic resolution: render below the console size when frames take longer than
+// res_target_ms (0 = always full size), at res_min_scale..res_max_scale of it per axis,
+// and stretch the result over the console (see resscale.h). It follows the wall clock,
+// so leave it off when recording or replaying input
+float res_target_ms = 0.0f;
+float res_min_scale = 0.5f;
+float res_max_scale = 1.0f;
+RESAMPLE_FILTER res_filter = RESAMPLE_NEAREST;
+// bytes set aside for each frame's transient render data (see framearena.h); a frame
+// that needs more grows it, and the high-water mark is reported on exit
+size_t frame_arena_bytes = 2 << 20;
+// record every frame's input and time step to a log (see inputlog.h), or play one back
+// headless and report any frame that renders differently, nullptr = off
+const char* input_record = nullptr;
+const char* input_replay = nullptr;
+#ifdef RENDERLITE_PROFILE
+// stage timings of the first trace_frames frames, written on exit as Chrome trace JSON
+// (chrome://tracing, ui.perfetto.dev), nullptr = no trace; 'P' toggles the on-screen
+// timing table
+const char* trace_path = "renderlite_trace.json";
+int trace_frames = 300;
+// also count cycles, instructions, cache misses and branch mispredicts per stage and
+// put them in the trace (Linux perf_event_open, see perfcounters.h)
+bool perf_counters = false;
+#endif
+
+// what happened to the mesh's triangles on the way to the screen, for one frame
+struct pipelineStats
+{
+    // instances in the scene, and those skipped whole as outside the view along with
+    // their triangles
+    int nInstances = 0;
+    int nInstancesCulled = 0;
+    int nFrustumCulled = 0;
+    // triangles the instances left shed by being drawn at a coarser level of detail, and
+    // instances that changed level this frame
+    int nLodReduced = 0;
+    int nLodSwitches = 0;
+    // triangles of the instances left, as drawn
+    int nInput = 0;
+    // facing away from the camera
+    int nBackface = 0;
+    // near plane: entirely behind it, cut down to one triangle, split into two
+    int nNearRejected = 0;
+    int nNearClipped1 = 0;
+    int nNearClipped2 = 0;
+    // screen edges: projected triangles entirely off screen, and ones cut by an edge;
+    // those whose bounding box is inside the screen skip the edge tests altogether
+    int nScreenRejected = 0;
+    int nScreenClipped = 0;
+    int nScreenInside = 0;
+    // triangles rastered, and the cells they filled (overlaps count every time)
+    int nEmitted = 0;
+    uint64_t nCellsFilled = 0;
+    // of those, the ones small enough to skip the scanline walk (FillSmallTriangleShade),
+    // and how many of them covered a single cell
+    int nSmall = 0;
+    int nPoint = 0;
+};
+
+// the debug drawing done per triangle, fixed at compile time: the pipeline's stages are
+// instantiated once for each combination (see olcEngine3D::DrawScene) and a frame picks
+// one from show_wireframe and show_clipping, so no triangle tests either flag
+template <bool bWire, bool bClipCols>
+struct pipelineFeatures
+{
+    // outline every triangle rastered (show_wireframe)
+    static constexpr bool bWireframe = bWire;
+    // colour the pieces clipping cuts a triangle into (show_clipping)
+    static constexpr bool bClipColours = bClipCols;
+};
+
+class olcEngine3D : public olcConsoleGameEngine
+{
+public:
+    olcEngine3D()
+    {
+        m_sAppName = L"Render";
+    }
+
+    // high-water mark and growth of the per-frame stage buffers
+    const FrameArena& GetFrameArena() const { return frameArena; }
+    // what each stage of the last frame did with the mesh's triangles
+    const pipelineStats& GetPipelineStats() const { return stats; }
+    // the terrain's chunks, when it is streamed (see terrain)
+    const TerrainStreamer& GetTerrain() const { return terrainStreamer; }
+    // the meshes and instances being drawn
+    const Scene& GetScene() const { return scene; }
+
+    // read sPath in the background and draw it in place of the asset once it is ready
+    assetTicket LoadAsset(const char* sPath)
+    {
+        sAssetLoading = sPath;
+        nAssetTicket = assetLoader.Load(sPath);
+        return nAssetTicket;
+    }
+    // times a finished load has replaced the asset, the first one included
+    int GetAssetSwaps() const { return nAssetSwaps; }
+
+    // dynamic resolution: frame time to hold in ms (0 = off), and the range of the scale
+    void SetResolutionTarget(float fMs) { resScaler.SetTarget(fMs); }
+    void SetResolutionBounds(float fMin, float fMax) { resScaler.SetBounds(fMin, fMax); }
+    void SetResampleFilter(RESAMPLE_FILTER filter) { resFilter = filter; }
+    float GetResolutionTarget() const { return resScaler.Target(); }
+    float GetResolutionMinScale() const { return resScaler.MinScale(); }
+    float GetResolutionMaxScale() const { return resScaler.MaxScale(); }
+    // scale the next frame renders at, and the size that makes in cells
+    float GetResolutionScale() const { return resScaler.Scale(); }
+    int GetRenderWidth() { int w, h; resScaler.Size(ScreenWidth(), ScreenHeight(), w, h); return w; }
+    int GetRenderHeight() { int w, h; resScaler.Size(ScreenWidth(), ScreenHeight(), w, h); return h; }
+
+private:
+    // the asset, and where each instance of it sits relative to (0, 0, zdepth)
+    Scene scene;
+    meshHandle hAsset = -1;
+    vector<vec3d> vecPlacement;
+    // reads and prepares it off the game thread; the newest load asked for, and its path
+    // until it lands
+    AssetLoader assetLoader;
+    assetTicket nAssetTicket = 0;
+    string sAssetLoading;
+    // the file being drawn, and its directory watched for it being written again
+    string sAssetPath;
+    DirWatcher assetWatcher;
+    int nAssetSwaps = 0;
+    int nAssetCycle = 0;
+    // or the terrain instead, with its chunks as instances of the scene
+    TerrainStreamer terrainStreamer;
+    // position of camera in world space
+    vec3d vCamera;
+    // look direction (vector along direction want camera to point)
+    vec3d vLookDir;
+    // projection matrix (converts from view space to screen space)
+    mat4x4 matProj;
+    // viewing angle theta (spins world transform matrix)
+    float fTheta = 0.0f;
+    // direction camera is facing (rotation about y)
+    float fYaw = 0.0f;
+#ifndef _WIN32
+    // shared-memory frame export (see shm_export)
+    ShmFrameWriter shmWriter;
+#endif
+    // offline frame stream (see sink_path)
+    FrameSink frameSink;
+    // compressed frame stream (see stream_path)
+    FrameStreamWriter frameStream;
+    int nFramesRendered = 0;
+
+    // the stage buffers of the frame being drawn, reset at the top of every update
+    FrameArena frameArena;
+    // triangle counts of the last frame drawn
+    pipelineStats stats;
+    // render size controller (see res_target_ms)
+    ResolutionScaler resScaler;
+    RESAMPLE_FILTER resFilter = RESAMPLE_NEAREST;
+    // the frame's projected triangles (see DrawScene)
+    vector<triangle> vecTrianglesToRaster;
+
+
+    // returns number of triangles that need to be drawn after check clipping with screen edges,
+    // and optionally how many corners were inside the plane (3 = not clipped at all);
+    // with bClipColours the pieces are coloured by how the triangle was cut (show_clipping)
+    template <bool bClipColours>
+    int triClipPlane(vec3d planePoint, vec3d planeNormal, triangle& inTri, triangle& outTri1, triangle& outTri2, int* pInside = nullptr)
+    {
+        planeNormal = vectorNorm(planeNormal);
+
+        // return signed shortest distance from point to plane (plane normal must be normalized)
+        auto dist = [&](vec3d& p)
+            {
+                return (planeNormal.x * p.x + planeNormal.y * p.y + planeNormal.z * p.z - vectorDot(planeNormal, planePoint));
+            };
+
+        // temp arrays for points on inside (+) / outside (-) of plane
+        vec3d* inPoint[3];
+        vec3d* outPoint[3];
+        // number of points in/outside
+        int nIn = 0; 
+        int nOut = 0;
+
+        // get signed distance to plane for each point of triangle
+        float d0 = dist(inTri.p[0]);
+        float d1 = dist(inTri.p[1]);
+        float d2 = dist(inTri.p[2]);
+
+        // pointers
+        if (d0 >= 0) { inPoint[nIn++] = &inTri.p[0]; }
+        else { outPoint[nOut++] = &inTri.p[0]; }
+        if (d1 >= 0) { inPoint[nIn++] = &inTri.p[1]; }
+        else { outPoint[nOut++] = &inTri.p[1]; }
+        if (d2 >= 0) { inPoint[nIn++] = &inTri.p[2]; }
+        else { outPoint[nOut++] = &inTri.p[2]; }
+        if (pInside != nullptr)
+            *pInside = nIn;
+
+
+        // classify triangle points, break input triangle into 
+        // smaller output triangles if clipping.
+        
+        // all points outside plane, so clip whole triangle
+        if (nIn == 0)                   
+            return 0; 
+
+        // all points inside plane, so do nothing
+        if (nIn == 3)
+        {            
+            outTri1 = inTri;
+            return 1;
+        }
+
+        // 2 points on triangle outside plane, so clip to make 1 new triangle
+        if (nIn == 1 && nOut == 2)
+        {
+            // copy appearance info to new triangle
+            if constexpr (bClipColours) { outTri1.col = shadeRGB(0, 0, 255); }
+            else { outTri1.col = inTri.col; }
+
+            // keep inside point
+            outTri1.p[0] = *inPoint[0];
+
+            // 2 new points of triangle where original
+            // triangle sides intersect with plane
+            outTri1.p[1] = vectorIntersectPlane(planePoint, planeNormal, *inPoint[0], *outPoint[0]);
+            outTri1.p[2] = vectorIntersectPlane(planePoint, planeNormal, *inPoint[0], *outPoint[1]);
+
+            // return newly formed triangle
+            return 1;
+        }
+
+        // 2 points on triangle outside plane, so clip to make quad (2 new triangles)
+        if (nIn == 2 && nOut == 1)
+        {
+            if constexpr (bClipColours)
+            {
+                outTri1.col = shadeRGB(0, 255, 0);
+                outTri2.col = shadeRGB(255, 0, 0);
+            }
+            else 
+            {
+            outTri1.col = inTri.col;
+            outTri2.col = inTri.col;
+            }                
+
+            // 1st triangle has 2 inside points and 1 new point where 1 side of 
+            // triangles intersects plane
+            outTri1.p[0] = *inPoint[0];
+            outTri1.p[1] = *inPoint[1];
+            outTri1.p[2] = vectorIntersectPlane(planePoint, planeNormal, *inPoint[0], *outPoint[0]);
+
+            // 2nd triangle has 1 inside point, 1 new point where side of
+            // triangle intersects plane, 1 new point above
+            outTri2.p[0] = *inPoint[1];
+            outTri2.p[1] = outTri1.p[2];
+            outTri2.p[2] = vectorIntersectPlane(planePoint, planeNormal, *inPoint[1], *outPoint[0]);
+
+            return 2;
+        }
+
+        // every corner is inside or outside, so the cases above cover every triangle
+        return 0;
+    }
+
+
+    // put a finished load in place of the asset, and lay its instances out to suit its
+    // size; the geometry it replaces goes back to the loader to be freed
+    void SwapInAsset(unique_ptr<loadedAsset> pLoaded)
+    {
+        if (pLoaded == nullptr)
+            return;
+        if (pLoaded->nTicket == nAssetTicket)
+            sAssetLoading.clear();
+        if (!pLoaded->bOk)
+        {
+            fprintf(stderr, "asset: cannot load %s\n", pLoaded->sPath.c_str());
+            return;
+        }
+        vector<mesh> vecOld;
+        scene.ReplaceMesh(hAsset, move(pLoaded->levels), pLoaded->vecBounds.data(), vecOld);
+        assetLoader.Retire(move(vecOld));
+        PlaceInstances(pLoaded->vecBounds[0]);
+        nAssetSwaps++;
+
+        sAssetPath = pLoaded->sPath;
+        if (asset_watch && !m_bHeadless)
+        {
+            string sDir = sAssetPath.substr(0, sAssetPath.find_last_of("/\\") + 1);
+            if (!assetWatcher.Active() || assetWatcher.Dir() != sDir)
+                assetWatcher.Watch(sDir, asset_watch_quiet_ms);
+        }
+    }
+
+    // load the asset again if its file has been rewritten, unless something else is on
+    // its way already
+    void ReloadChangedAsset()
+    {
+        const vector<string>& vecChanged = assetWatcher.Poll();
+        if (vecChanged.empty() || !(sAssetLoading.empty() || sAssetLoading == sAssetPath))
+            return;
+        size_t nName = assetWatcher.Dir().size();
+        for (const string& sName : vecChanged)
+            if (sAssetPath.compare(nName, string::npos, sName) == 0)
+            {
+                LoadAsset(sAssetPath.c_str());
+                return;
+            }
+    }
+
+    // where each instance of a mesh with bounds box goes, relative to (0, 0, zdepth)
+    void PlaceInstances(const aabb& box)
+    {
+        float fSpacing = scene_spacing > 0.0f ? scene_spacing : 3.0f * max(box.vMax.x - box.vMin.x, box.vMax.z - box.vMin.z);
+        int nSide = (int)ceilf(sqrtf((float)scene_instances));
+        float fCube = fSpacing * cbrtf((float)scene_instances);
+        // the same cloud on every platform
+        uint32_t nSeed = 1;
+        auto rnd = [&]()
+            {
+                nSeed = nSeed * 1664525u + 1013904223u;
+                return (float)(nSeed >> 8) / (float)(1 << 24) - 0.5f;
+            };
+        vecPlacement.clear();
+        for (int k = 0; k < scene_instances; k++)
+        {
+            if (scene_scatter)
+                vecPlacement.push_back({ rnd() * fCube, rnd() * fCube, rnd() * fCube });
+            else
+                vecPlacement.push_back({ (k % nSide - (nSide - 1) * 0.5f) * fSpacing, 0.0f, (k / nSide) * fSpacing });
+        }
+    }
+
+    // the last frame's pipelineStats, top right
+    void drawPipelineStats()
+    {
+        if (ScreenWidth() < 64 || ScreenHeight() < 20)
+            return;
+        const int nCols = 30;
+        int x = ScreenWidth() - nCols - 1;
+        wchar_t s[64];
+        auto line = [&](int y, const wchar_t* sName, long long n)
+            {
+                swprintf_s(s, 64, L"%-20ls %9lld", sName, n);
+                DrawString(x, 1 + y, s, FG_GREY);
+            };
+        line(0, L"input", stats.nInput);
+        line(1, L"backface culled", stats.nBackface);
+        line(2, L"near rejected", stats.nNearRejected);
+        line(3, L"near clipped to 1", stats.nNearClipped1);
+        line(4, L"near split to 2", stats.nNearClipped2);
+        line(5, L"screen rejected", stats.nScreenRejected);
+        line(6, L"screen clipped", stats.nScreenClipped);
+        line(7, L"emitted", stats.nEmitted);
+        line(8, L"cells filled", (long long)stats.nCellsFilled);
+        line(9, L"inside, no clip", stats.nScreenInside);
+        line(10, L"small", stats.nSmall);
+        line(11, L"single cell", stats.nPoint);
+        line(12, L"instances", stats.nInstances);
+        line(13, L"instances culled", stats.nInstancesCulled);
+        line(14, L"their triangles", stats.nFrustumCulled);
+        line(15, L"lod reduced", stats.nLodReduced);
+        line(16, L"lod switches", stats.nLodSwitches);
+        if (resScaler.Target() > 0.0f)
+            line(17, L"render scale %", (long long)(resScaler.Scale() * 100.0f + 0.5f));
+    }
+
+    // grey shade for a light intensity in [0, 1]; the engine quantizes
+    // it to the console palette (with dithering) when the frame is presented
+    uint32_t getColor(float lum)
+    {
+        int level = (int)(255.0f * min(max(lum, 0.0f), 1.0f));
+        return shadeRGB(level, level, level);
+    }
+
+    // frustum cull, level of detail, then every per-triangle stage through to the raster,
+    // for one frame seen through matView at nRenderWidth x nRenderHeight. F is a
+    // pipelineFeatures: each combination of debug drawing is its own instantiation
+    template <typename F>
+    void DrawScene(const mat4x4& matView, int nRenderWidth, int nRenderHeight)
+    {
+        // the pipeline runs as one pass per stage over a batch of instances at a time
+        // (see SCENE_BATCH_TRIS), so each stage can be timed on its own (build with
+        // RENDERLITE_PROFILE, see profiler.h) and the world-space buffers stay one batch long
+
+        // stage buffers, all on the frame arena
+        arenaAllocator<triangle> arena(frameArena);
+        stats = pipelineStats();
+        stats.nInstances = scene.LiveInstances();
+        // the instances to draw (frustum)
+        arenaVector<int> vecInView(arena);
+        vecInView.reserve(scene.Instances());
+
+        // frustum: skip every instance whose bounds are wholly outside the view
+        {
+            PROFILE_SCOPE(PROFILE_FRUSTUM);
+            if (scene_cull)
+                // 0.1 is the near plane triangles are clipped against below
+                scene.Cull(matrixMult(matView, matProj), 0.1f, vecInView);
+            else
+                for (int k = 0; k < scene.Instances(); k++)
+                    if (scene.Instance(k).hMesh >= 0)
+                        vecInView.push_back(k);
+        }
+
+        // lod: the level of detail to draw each of them at, from how far away it is in
+        // cells of the size being rendered
+        {
+            PROFILE_SCOPE(PROFILE_LOD);
+            if (lod_enabled)
+            {
+                scene.SelectLods(matView, matProj.m[1][1] * nRenderHeight * 0.5f, lod_error, lod_hysteresis, vecInView);
+                stats.nLodSwitches = scene.Switches();
+            }
+        }
+        auto drawnMesh = [&](int k) { return lod_enabled ? scene.Drawn(k) : scene.Instance(k).hMesh; };
+
+        size_t nTris = 0, nFullTris = 0;
+        for (int k : vecInView)
+        {
+            nTris += scene.Mesh(drawnMesh(k)).Triangles();
+            nFullTris += scene.Mesh(scene.Instance(k).hMesh).Triangles();
+        }
+        size_t nBatchMax = min(nTris, max(SCENE_BATCH_TRIS, scene.MaxTris()));
+        stats.nInstancesCulled = stats.nInstances - (int)vecInView.size();
+        stats.nFrustumCulled = (int)(scene.Triangles() - nFullTris);
+        stats.nLodReduced = (int)(nFullTris - nTris);
+        stats.nInput = (int)nTris;
+        // one instance's vertices in world space (transform)
+        arenaVector<vec3d> vecVerts(arena);
+        vecVerts.resize(scene.MaxVerts());
+        // the batch's world-space triangles (transform)
+        arenaVector<triangle> vecWorld(arena);
+        vecWorld.reserve(nBatchMax);
+        // indices into vecWorld facing the camera, and their normals (cull)
+        arenaVector<int> vecVisible(arena);
+        arenaVector<vec3d> vecNormals(arena);
+        vecVisible.reserve(nBatchMax);
+        vecNormals.reserve(nBatchMax);
+        // projected triangles of every batch that may reach the screen (clip), in a member
+        // so its capacity carries over: it grows with the scene rather than the batch.
+        // Near-plane clipping can split a triangle in two, so twice a batch always fits one.
+        // How much is in view changes as things move, so it grows by a quarter extra, and
+        // is sized for full detail so a change of level does not grow it either
+        size_t nRasterMax = min(nFullTris, max(SCENE_BATCH_TRIS, scene.MaxTris())) * 2;
+        vecTrianglesToRaster.clear();
+        if (vecTrianglesToRaster.capacity() < nRasterMax)
+            vecTrianglesToRaster.reserve(nRasterMax + nRasterMax / 4);
+        // painter's order: back-to-front depth of each projected triangle (sort)
+        struct sortKey
+        {
+            float z;
+            int i;
+        };
+        arenaVector<sortKey> vecOrder(arena);
+        // what to raster, back to front (clip): the index of a triangle the screen edges
+        // left whole, or ~index into vecClipped for a piece of one they cut
+        arenaVector<int> vecDraw(arena);
+        arenaVector<triangle> vecClipped(arena);
+        // work queue for clipping one triangle against the screen edges:
+        // 4 edges, each can at most double it, 1 + 2 + 4 + 8 + 16
+        arenaVector<triangle> vecClipQueue(arena);
+        vecClipQueue.reserve(31);
+
+        int nInView = (int)vecInView.size();
+        for (int nFirst = 0, nLast = 0; nFirst < nInView; nFirst = nLast)
+        {
+            // instances vecInView[nFirst..nLast-1] make up this batch
+            size_t nBatchTris = 0;
+            for (; nLast < nInView; nLast++)
+            {
+                size_t n = scene.Mesh(drawnMesh(vecInView[nLast])).Triangles();
+                if (nLast > nFirst && nBatchTris + n > SCENE_BATCH_TRIS)
+                    break;
+                nBatchTris += n;
+            }
+
+            // transform: model to world space, one matrix per instance
+            {
+                PROFILE_SCOPE(PROFILE_TRANSFORM);
+                vecWorld.resize(nBatchTris);
+                size_t t = 0;
+                for (int k = nFirst; k < nLast; k++)
+                {
+                    const instance& inst = scene.Instance(vecInView[k]);
+                    const mesh& m = scene.Mesh(drawnMesh(vecInView[k]));
+                    if (m.Packed())
+                    {
+                        // the same, decoding the packed positions as they are transformed
+                        const packedMesh& pm = m.packed;
+                        transformPacked(inst.matWorld, pm, vecVerts.data());
+                        triangle* pEnd = pm.idx16.empty() ?
+                            assembleTris(vecVerts.data(), pm.idx32.data(), pm.idx32.size(), &vecWorld[t]) :
+                            assembleTris(vecVerts.data(), pm.idx16.data(), pm.idx16.size(), &vecWorld[t]);
+                        t = pEnd - vecWorld.data();
+                    }
+                    else if (m.idx.size() == m.tris.size() * 3)
+                    {
+                        // each shared vertex once, then the triangles from their corners
+                        transformVerts(inst.matWorld, m.verts.data(), vecVerts.data(), m.verts.size());
+                        t = assembleTris(vecVerts.data(), m.idx.data(), m.idx.size(), &vecWorld[t]) - vecWorld.data();
+                    }
+                    else
+                    {
+                        for (const triangle& tri : m.tris)
+                            transformVerts(inst.matWorld, tri.p, vecWorld[t++].p, 3);
+                    }
+                }
+            }
+
+            // cull: keep the triangles facing the camera, and their normals for lighting
+            {
+                PROFILE_SCOPE(PROFILE_CULL);
+                vecVisible.clear();
+                vecNormals.clear();
+                for (size_t i = 0; i < vecWorld.size(); i++)
+                {
+                    triangle& triTransformed = vecWorld[i];
+
+                    // calculate triangle normal
+                    vec3d normal, line1, line2;
+                    // lines on either side of triangle
+                    line1 = vectorSub(triTransformed.p[1], triTransformed.p[0]);
+                    line2 = vectorSub(triTransformed.p[2], triTransformed.p[0]);
+
+                    // normal to triangle surface
+                    normal = vectorCross(line1, line2);
+
+                    // normalize
+                    normal = vectorNorm(normal);
+
+
+                    // only show triangle if it's not occulted
+                    // (i.e. if dot product is nonzero; if z-component of triangle's normal 
+                    // projected onto the line b/t the camera and the triangle in 3D space is <90 deg).
+                    // get ray from triangle to camera
+                    vec3d vCameraRay = vectorSub(triTransformed.p[0], vCamera);
+                    // if ray is aligned w/ normal, triangle is visible
+                    if (vectorDot(normal, vCameraRay) < 0.0f)
+                    {
+                        vecVisible.push_back((int)i);
+                        vecNormals.push_back(normal);
+                    }
+                }
+                stats.nBackface += (int)(vecWorld.size() - vecVisible.size());
+            }
+
+            // light: shade visible triangles
+            {
+                PROFILE_SCOPE(PROFILE_LIGHT);
+
+                // illuminate triangle with light coming from -z
+                vec3d light_dir = { 0.0f, 1.0f, -1.0f };           
+                light_dir = vectorNorm(light_dir);
+
+                for (size_t k = 0; k < vecVisible.size(); k++)
+                {
+                    // dot product b/t triangle normal and light source 
+                    float dp = max(0.1f, vectorDot(light_dir, vecNormals[k]));
+
+                    // set triangle shade
+                    vecWorld[vecVisible[k]].col = getColor(dp);
+                }
+            }
+
+            // clip: view transform, near-plane clipping and projection to the screen
+            {
+                PROFILE_SCOPE(PROFILE_CLIP);
+                size_t nNeed = vecTrianglesToRaster.size() + vecVisible.size() * 2;
+                if (nNeed > vecTrianglesToRaster.capacity())
+                    vecTrianglesToRaster.reserve(max(nNeed, vecTrianglesToRaster.capacity() * 2));
+                float fMaxX = (float)nRenderWidth - 1;
+                float fMaxY = (float)nRenderHeight - 1;
+                for (int i : vecVisible)
+                {
+                    triangle& triTransformed = vecWorld[i];
+                    triangle triProjected, triViewed;
+
+                    // convert from world space to view space
+                    triViewed.p[0] = matvecMult(matView, triTransformed.p[0]);
+                    triViewed.p[1] = matvecMult(matView, triTransformed.p[1]);
+                    triViewed.p[2] = matvecMult(matView, triTransformed.p[2]);
+                    triViewed.col = triTransformed.col;
+
+                    // clip viewed triangle using near plane (z-plane just in front of camera),
+                    // which could create 2 new triangles
+                    int nClippedTri = 0;
+                    triangle clipped[2];
+                    int nInside = 3;
+                    nClippedTri = triClipPlane<F::bClipColours>({ 0.0f, 0.0f, 0.1f }, { 0.0f, 0.0f, 1.0f }, triViewed, clipped[0], clipped[1], &nInside);
+                    stats.nNearRejected += nClippedTri == 0;
+                    stats.nNearClipped1 += nClippedTri == 1 && nInside < 3;
+                    stats.nNearClipped2 += nClippedTri == 2;
+
+                    // operate on all checked triangles
+                    for (int n = 0; n < nClippedTri; n++)
+                    {
+                        // project triangle from 3D to 2D 
+                        triProjected.p[0] = matvecMult(matProj, clipped[n].p[0]);
+                        triProjected.p[1] = matvecMult(matProj, clipped[n].p[1]);
+                        triProjected.p[2] = matvecMult(matProj, clipped[n].p[2]);
+                        triProjected.col = clipped[n].col;
+
+                        // scale into visible screen area (normalize into Cartesian space)
+                        triProjected.p[0] = vectorDiv(triProjected.p[0], triProjected.p[0].w);
+                        triProjected.p[1] = vectorDiv(triProjected.p[1], triProjected.p[1].w);
+                        triProjected.p[2] = vectorDiv(triProjected.p[2], triProjected.p[2].w);
+
+                        // un-invert x, y axes
+                        triProjected.p[0].x *= -1.0f;
+                        triProjected.p[1].x *= -1.0f;
+                        triProjected.p[2].x *= -1.0f;
+                        triProjected.p[0].y *= -1.0f;
+                        triProjected.p[1].y *= -1.0f;
+                        triProjected.p[2].y *= -1.0f;
+
+                        // offset verticles into visible normalized space
+                        vec3d vOffsetView = { 1,1,0 };
+                        triProjected.p[0] = vectorAdd(triProjected.p[0], vOffsetView);
+                        triProjected.p[1] = vectorAdd(triProjected.p[1], vOffsetView);
+                        triProjected.p[2] = vectorAdd(triProjected.p[2], vOffsetView);
+
+                        triProjected.p[0].x *= 0.5f * (float)nRenderWidth;
+                        triProjected.p[1].x *= 0.5f * (float)nRenderWidth;
+                        triProjected.p[2].x *= 0.5f * (float)nRenderWidth;
+                        triProjected.p[0].y *= 0.5f * (float)nRenderHeight;
+                        triProjected.p[1].y *= 0.5f * (float)nRenderHeight;
+                        triProjected.p[2].y *= 0.5f * (float)nRenderHeight;
+
+                        // wholly beyond one screen edge: the edge clip would drop it anyway,
+                        // and with many instances most of the geometry can be off screen
+                        vec3d* p = triProjected.p;
+                        if (max(p[0].x, max(p[1].x, p[2].x)) < 0.0f || min(p[0].x, min(p[1].x, p[2].x)) > fMaxX ||
+                            max(p[0].y, max(p[1].y, p[2].y)) < 0.0f || min(p[0].y, min(p[1].y, p[2].y)) > fMaxY)
+                        {
+                            stats.nScreenRejected++;
+                            continue;
+                        }
+
+                        // store triangle for z-sorting 
+                        vecTrianglesToRaster.push_back(triProjected);                
+                    }
+                }
+            }
+        }
+
+        // sort triangles by midpoint z of each (average of z of the triangle's 3 points), 
+        // farthest first (a hack, the "painter's algorithm"). Sorts (depth, index) keys,
+        // so the depth is worked out once per triangle and a swap moves 8 bytes, not 52
+        {
+            PROFILE_SCOPE(PROFILE_SORT);
+            vecOrder.resize(vecTrianglesToRaster.size());
+            for (size_t i = 0; i < vecTrianglesToRaster.size(); i++)
+            {
+                triangle& t = vecTrianglesToRaster[i];
+                vecOrder[i] = { (t.p[0].z + t.p[1].z + t.p[2].z) / 3.0f, (int)i };
+            }
+            sort(vecOrder.begin(), vecOrder.end(), [](const sortKey& k1, const sortKey& k2)
+            {
+                    // return bool for whether positions of the 2 triangles should be swapped in z;
+                    // equal depths keep the order they were projected in, so the frame does not
+                    // depend on what else was in the list (culled or rejected triangles)
+                    return k1.z > k2.z || (k1.z == k2.z && k1.i < k2.i);
+            });
+        }
+
+
+        // clear screen from top-left to bottom-right
+        {
+            PROFILE_SCOPE(PROFILE_CLEAR);
+            ClearShade(shadeRGB(0, 0, 0), nRenderWidth, nRenderHeight);
+        }
+
+        // clip triangles against screen edges, keeping the back-to-front order
+        {
+            PROFILE_SCOPE(PROFILE_CLIP);
+            vecDraw.reserve(vecOrder.size());
+            float fMaxX = (float)nRenderWidth - 1;
+            float fMaxY = (float)nRenderHeight - 1;
+            for (const sortKey& key : vecOrder)
+            {
+                triangle& triToRaster = vecTrianglesToRaster[key.i];
+
+                // bounding box inside every edge: clipping would hand it back unchanged
+                vec3d* p = triToRaster.p;
+                if (min(p[0].x, min(p[1].x, p[2].x)) >= 0.0f && max(p[0].x, max(p[1].x, p[2].x)) <= fMaxX &&
+                    min(p[0].y, min(p[1].y, p[2].y)) >= 0.0f && max(p[0].y, max(p[1].y, p[2].y)) <= fMaxY)
+                {
+                    vecDraw.push_back(key.i);
+                    stats.nScreenInside++;
+                    continue;
+                }
+
+                triangle clipped[2];
+                // queue of triangles still to clip, from nFront on
+                vecClipQueue.clear();
+                size_t nFront = 0;
+
+                // add initial triangle
+                vecClipQueue.push_back(triToRaster);
+                int nNewTri = 1;
+                bool bCut = false;
+
+                for (int p = 0; p < 4; p++)
+                {
+                    int nTrisToAdd = 0;
+                    while (nNewTri > 0)
+                    {
+                        // take triangle from front of queue
+                        triangle test = vecClipQueue[nFront++];
+                        nNewTri--;
+
+                        // clip it against subsequent planes
+                        int nInside = 3;
+                        switch (p)
+                        {
+                        // top edge
+                        case 0:	nTrisToAdd = triClipPlane<F::bClipColours>({ 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, test, clipped[0], clipped[1], &nInside); break;
+                        // bottom edge
+                        case 1:	nTrisToAdd = triClipPlane<F::bClipColours>({ 0.0f, (float)nRenderHeight - 1, 0.0f }, { 0.0f, -1.0f, 0.0f }, test, clipped[0], clipped[1], &nInside); break;
+                        // left edge
+                        case 2:	nTrisToAdd = triClipPlane<F::bClipColours>({ 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, test, clipped[0], clipped[1], &nInside); break;
+                        // right edge
+                        case 3:	nTrisToAdd = triClipPlane<F::bClipColours>({ (float)nRenderWidth - 1, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f }, test, clipped[0], clipped[1], &nInside); break;
+                        }
+
+                        bCut |= nInside < 3;
+
+                        // add created triangles from clipping to back of queue for
+                        // subsequent clipping against next planes
+                        for (int w = 0; w < nTrisToAdd; w++)
+                            vecClipQueue.push_back(clipped[w]);
+                    }
+                    nNewTri = (int)(vecClipQueue.size() - nFront);
+                }
+
+                for (size_t k = nFront; k < vecClipQueue.size(); k++)
+                {
+                    vecDraw.push_back(~(int)vecClipped.size());
+                    vecClipped.push_back(vecClipQueue[k]);
+                }
+                stats.nScreenRejected += nFront == vecClipQueue.size();
+                stats.nScreenClipped += bCut && nFront < vecClipQueue.size();
+            }
+            stats.nEmitted = (int)vecDraw.size();
+        }
+
+        // raster: draw final triangles
+        {
+            PROFILE_SCOPE(PROFILE_RASTER);
+            uint64_t nCellsBefore = GetCellsFilled();
+            for (int d : vecDraw)
+            {
+                const triangle& tr = d >= 0 ? vecTrianglesToRaster[d] : vecClipped[~d];
+                int x1 = (int)tr.p[0].x, y1 = (int)tr.p[0].y;
+                int x2 = (int)tr.p[1].x, y2 = (int)tr.p[1].y;
+                int x3 = (int)tr.p[2].x, y3 = (int)tr.p[2].y;
+                // most of a distant mesh lands on a cell or two
+                if (IsSmallTriangle(x1, y1, x2, y2, x3, y3))
+                {
+                    FillSmallTriangleShade(x1, y1, x2, y2, x3, y3, tr.col);
+                    stats.nSmall++;
+                    stats.nPoint += x1 == x2 && x2 == x3 && y1 == y2 && y2 == y3;
+                }
+                else
+                    FillTriangleShade(x1, y1, x2, y2, x3, y3, tr.col);
+                if constexpr (F::bWireframe)
+                    DrawTriangle(x1, y1, x2, y2, x3, y3, PIXEL_SOLID, FG_YELLOW);
+            }
+            stats.nCellsFilled = GetCellsFilled() - nCellsBefore;
+
+            // a reduced-size frame is stretched over the screen as part of rastering it
+            UpscaleScreen(nRenderWidth, nRenderHeight, resFilter);
+        }
+    }
+
+public:
+    bool OnUserCreate() override
+    {
+        if (terrain != nullptr)
+        {
+            // stream the terrain in around the camera instead of loading an asset
+            unique_ptr<TerrainSource> pSource;
+            if (strcmp(terrain, "synthetic") == 0)
+                pSource.reset(new HeightfieldTerrain(terrain_world_chunks, terrain_chunk_size, terrain_chunk_cells));
+            else
+            {
+                ObjTerrain* pObj = new ObjTerrain();
+                pSource.reset(pObj);
+                if (!pObj->Load(terrain, terrain_chunk_size))
+                    return false;
+            }
+            terrainSettings ts;
+            ts.fRadius = terrain_radius;
+            ts.fLookAhead = terrain_lookahead;
+            ts.nMaxChunks = terrain_max_chunks;
+            ts.nLodLevels = lod_levels;
+            ts.bReorder = mesh_reorder;
+            ts.bPack = mesh_pack;
+            ts.bWait = terrain_wait;
+            terrainStreamer.Start(move(pSource), ts);
+            // chunks arriving in a frame join the scene before those out of range leave it
+            scene.Reserve(2 * terrain_max_chunks);
+        }
+        else
+        {
+            // scene_instances of the asset, with nothing to draw until its .obj file has
+            // loaded in the background (see assetloader.h)
+            hAsset = scene.AddMesh(mesh());
+            for (int k = 0; k < scene_instances; k++)
+                scene.AddInstance(hAsset, matrixIden());
+            assetLoader.Start(lod_levels, asset_loader_nice, mesh_reorder, mesh_pack);
+            LoadAsset(asset);
+            // without a console the frames are being recorded or measured, and every
+            // run must draw the same ones, so wait for it
+            if (m_bHeadless)
+                SwapInAsset(assetLoader.Wait());
+        }
+
+        frameArena.Reserve(frame_arena_bytes);
+        resScaler.SetBounds(res_min_scale, res_max_scale);
+        resScaler.SetTarget(res_target_ms);
+        resFilter = res_filter;
+        SetOverdrawMode(overdraw_pgm != nullptr && overdraw_mode == OVERDRAW_OFF ? OVERDRAW_COUNT : overdraw_mode);
+
+        SetOutputTarget(output_target);
+
+#ifndef _WIN32
+        if (shm_export != nullptr && shmWriter.Create(shm_export, ScreenWidth(), ScreenHeight()))
+            AddFrameOutput(&shmWriter);
+#endif
+
+        if (sink_path != nullptr)
+        {
+            if (!frameSink.Open(sink_path, sink_format, ScreenWidth(), ScreenHeight(), 8, sink_fps))
+                return false;
+            AddFrameOutput(&frameSink);
+        }
+
+        if (stream_path != nullptr)
+        {
+            if (!frameStream.Open(stream_path))
+                return false;
+            AddFrameOutput(&frameStream);
+        }
+
+        if (input_record != nullptr && !RecordInput(input_record))
+            return false;
+        if (input_replay != nullptr && !ReplayInput(input_replay))
+            return false;
+
+#ifdef RENDERLITE_PROFILE
+        if (trace_path != nullptr)
+            Profiler::Get().BeginTrace(trace_frames);
+        string sWhy;
+        if (perf_counters && !Profiler::Get().EnableCounters(sWhy))
+            fprintf(stderr, "profile: no hardware counters, timing only: %s\n", sWhy.c_str());
+        // the table would end up in recorded frames, so only show it on the console
+        SetProfilerOverlay(!m_bHeadless);
+#endif
+
+        // make projection matrix.
+        // near plane
+        float fNear = 0.1f;
+        float fFar = 1000.0f;
+        // field of view [deg]
+        float fFov = 90.0f;     
+        float fAspectRatio = (float)ScreenHeight() / (float)ScreenWidth();
+        matProj = matrixProj(fFov, fAspectRatio, fNear, fFar);
+
+        return true;
+    }
+
+
+    bool OnUserUpdate(float fElapsedTime) override
+    {
+        // nothing from last frame's stage buffers is used any more
+        frameArena.Reset();
+        auto tRenderStart = chrono::steady_clock::now();
+
+        // size to render at this frame, the top-left corner of the screen buffers
+        int nRenderWidth, nRenderHeight;
+        resScaler.Size(ScreenWidth(), ScreenHeight(), nRenderWidth, nRenderHeight);
+
+#ifdef RENDERLITE_PROFILE
+        if (GetKey(L'P').bPressed)
+            SetProfilerOverlay(!GetProfilerOverlay());
+#endif
+
+        if (GetKey(L'I').bPressed)
+            show_pipeline_stats = !show_pipeline_stats;
+        if (GetKey(L'L').bPressed)
+            lod_enabled = !lod_enabled;
+        if (GetKey(L'N').bPressed && assetLoader.Active())
+            LoadAsset(asset_cycle[nAssetCycle++ % (sizeof(asset_cycle) / sizeof(asset_cycle[0]))]);
+        if (GetKey(L'O').bPressed)
+            SetOverdrawMode((OVERDRAW_MODE)((GetOverdrawMode() + 1) % (OVERDRAW_TILE_TIME + 1)));
+
+        // user input to move camera
+        if (GetKey(VK_UP).bHeld)
+            vCamera.y += 8.0f * fElapsedTime;
+        if (GetKey(VK_DOWN).bHeld)
+            vCamera.y -= 8.0f * fElapsedTime;
+        //if (GetKey(VK_LEFT).bHeld)
+        //    vCamera.x += 8.0f * fElapsedTime;
+        //if (GetKey(VK_RIGHT).bHeld)
+        //    vCamera.x -= 8.0f * fElapsedTime;
+
+        if (GetKey(L'A').bHeld)
+            fYaw -= 2.0f * fElapsedTime;
+        if (GetKey(L'D').bHeld)
+            fYaw += 2.0f * fElapsedTime;
+
+        // rescaled vLookDir vector, w/ scaling determining forward camera motion
+        vec3d vForward = vectorMul(vLookDir, 8.0f * fElapsedTime);
+        if (GetKey(L'W').bHeld)
+            vCamera = vectorAdd(vCamera, vForward);
+        if (GetKey(L'S').bHeld)
+            vCamera = vectorSub(vCamera, vForward);
+
+
+        // stream: an asset that has finished loading takes the old one's place, before
+        // anything this frame looks at the scene, and one whose file has changed starts
+        // loading again
+        if (assetLoader.Active())
+        {
+            PROFILE_SCOPE(PROFILE_STREAM);
+            SwapInAsset(assetLoader.Take());
+            if (assetWatcher.Active())
+                ReloadChangedAsset();
+        }
+
+        // world matrix, the part every instance shares
+        mat4x4 matWorld;
+        matWorld = matrixIden();
+
+        // rotation matrices
+        if (rotate_obj)
+        {
+            mat4x4 matRotZ, matRotX;
+            // rotate over time
+            fTheta += 1.0f * fElapsedTime;
+
+            // rotation about z
+            matRotZ = matrixRotZ(fTheta * 0.5f);
+
+            // rotation about x by different rate than about z to avoid gimball lock
+            matRotX = matrixRotX(fTheta);
+
+            // rotate world matrix
+            matWorld = matrixMult(matRotZ, matRotX);
+        }            
+
+        // translate each instance's world matrix to its place, zdepth into the screen
+        for (int k = 0; k < (int)vecPlacement.size(); k++)
+        {
+            mat4x4 matTrans = matrixTrans(vecPlacement[k].x, vecPlacement[k].y, zdepth + vecPlacement[k].z);
+            scene.SetTransform(k, matrixMult(matWorld, matTrans));
+        }
+
+
+        vec3d vUp = { 0,1,0 };
+        // forward vector can be rotated by yaw, so want variable look dir:
+        // start w/ target vector along z-axis
+        vec3d vTarget = { 0,0,1 };
+        // rotate this vector by 'fYaw' rad (camera turning left/right)
+        mat4x4 matCameraRot = matrixRotY(fYaw);
+        vLookDir = matvecMult(matCameraRot, vTarget);
+        // add new forward-facing vector to camera location to give camera a target to look at
+        vTarget = vectorAdd(vCamera, vLookDir);
+
+        mat4x4 matCamera = matrixPointAt(vCamera, vTarget, vUp);
+        mat4x4 matView = matrixInv(matCamera);
+
+        // stream: page terrain chunks in and out around the camera
+        if (terrainStreamer.Active())
+        {
+            PROFILE_SCOPE(PROFILE_STREAM);
+            terrainStreamer.Update(scene, vCamera, vLookDir);
+        }
+
+
+        // the stages, in the variant for this frame's debug drawing
+        if (show_wireframe)
+        {
+            if (show_clipping)
+                DrawScene<pipelineFeatures<true, true>>(matView, nRenderWidth, nRenderHeight);
+            else
+                DrawScene<pipelineFeatures<true, false>>(matView, nRenderWidth, nRenderHeight);
+        }
+        else
+        {
+            if (show_clipping)
+                DrawScene<pipelineFeatures<false, true>>(matView, nRenderWidth, nRenderHeight);
+            else
+                DrawScene<pipelineFeatures<false, false>>(matView, nRenderWidth, nRenderHeight);
+        }
+
+        // the next frame's size follows from how long this one took
+        resScaler.Update(chrono::duration<float, milli>(chrono::steady_clock::now() - tRenderStart).count());
+
+        if (show_pipeline_stats)
+            drawPipelineStats();
+        // the asset on its way, bottom left
+        if (!sAssetLoading.empty() && !m_bHeadless && ScreenHeight() >= 2)
+            DrawString(1, ScreenHeight() - 2, L"loading " + wstring(sAssetLoading.begin(), sAssetLoading.end()), FG_GREY);
+
+        // stop once the requested number of frames has been drawn
+        nFramesRendered++;
+        return render_frames == 0 || nFramesRendered < render_frames;
+    }
+
+    bool OnUserDestroy() override
+    {
+        if (sink_path != nullptr)
+        {
+            // drain queued frames before reporting
+            frameSink.Close();
+            sinkStats st = frameSink.Stats();
+            fprintf(stderr, "sink: %llu frames in %.2f s (%.1f fps, %.1f MB/s), render stalled %.1f ms\n",
+                (unsigned long long)st.nFrames, st.fSeconds, st.nFrames / max(st.fSeconds, 1e-6),
+                st.nBytes / max(st.fSeconds, 1e-6) / 1e6, st.fStallSeconds * 1000.0);
+            if (st.nFailed > 0)
+                fprintf(stderr, "sink: write error, at least the last %llu frames were lost\n", (unsigned long long)st.nFailed);
+            else if (st.bWriteError)
+                fprintf(stderr, "sink: write error on the final flush, the output is incomplete\n");
+        }
+
+        if (overdraw_pgm != nullptr)
+        {
+            overdrawStats st = GetOverdrawStats();
+            fprintf(stderr, "overdraw: avg %.2f, max %d, %.1f%% of cells %d+ writes, %.1f%% covered\n",
+                st.fAverage, st.nMax, st.fHeavy * 100.0f, OVERDRAW_HEAVY, st.fCoverage * 100.0f);
+            GetOverdraw().WriteCountsPGM(overdraw_pgm);
+            if (GetOverdrawMode() == OVERDRAW_TILE_TIME)
+                GetOverdraw().WriteTileTimePGM((string(overdraw_pgm) + ".tiles.pgm").c_str());
+        }
+
+        if (terrainStreamer.Active())
+        {
+            terrainStreamer.Stop();
+            const terrainStats& st = terrainStreamer.Stats();
+            fprintf(stderr, "terrain: %llu chunks paged in, %llu out, %llu discarded; at most %d resident, %zu KB\n",
+                (unsigned long long)st.nPagedIn, (unsigned long long)st.nPagedOut, (unsigned long long)st.nDiscarded,
+                st.nResidentMax, st.nBytesMax / 1024);
+        }
+
+        // fold the last frame into the high-water mark
+        frameArena.Reset();
+        if (frameArena.Grows() > 0)
+            fprintf(stderr, "arena: frames needed up to %zu KB, more than frame_arena_bytes (%zu KB); raise it to avoid growing\n",
+                frameArena.HighWater() / 1024, frame_arena_bytes / 1024);
+
+        if (stream_path != nullptr)
+        {
+            frameStream.Close();
+            FrameStreamWriter::stats st = frameStream.Stats();
+            fprintf(stderr, "stream: %llu frames (%llu key), %.1f:1 compression, %.3f ms/frame encode, render stalled %.1f ms\n",
+                (unsigned long long)st.nFrames, (unsigned long long)st.nKeyFrames,
+                (double)st.nRawBytes / max<uint64_t>(st.nBytes, 1), st.fEncodeSeconds * 1000.0 / max<uint64_t>(st.nFrames, 1),
+                st.fStallSeconds * 1000.0);
+            if (st.nFailed > 0)
+                fprintf(stderr, "stream: write error, at least the last %llu frames were lost\n", (unsigned long long)st.nFailed);
+            else if (st.bWriteError)
+                fprintf(stderr, "stream: write error on the final flush, the output is incomplete\n");
+        }
+
+        if (IsReplaying())
+        {
+            int64_t nFirst = GetReplayFirstMismatch();
+            fprintf(stderr, "replay: %llu frames, %llu mismatched", (unsigned long long)GetReplayFrames(), (unsigned long long)GetReplayMismatches());
+            if (nFirst >= 0)
+                fprintf(stderr, " (first at frame %lld)", (long long)nFirst);
+            fprintf(stderr, "\n");
+        }
+
+#ifdef RENDERLITE_PROFILE
+        if (trace_path != nullptr && Profiler::Get().WriteTrace(trace_path))
+            fprintf(stderr, "profile: trace of %d frames written to %s\n", min<int>(trace_frames, (int)Profiler::Get().Frames()), trace_path);
+        if (Profiler::Get().Dropped() > 0)
+            fprintf(stderr, "profile: %u records dropped, stage totals of those frames are short\n", Profiler::Get().Dropped());
+#endif
+        return true;
+    }
+};
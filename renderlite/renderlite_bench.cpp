@@ -0,0 +1,1262 @@
+// renderlite_bench.cpp : headless benchmark of the renderlite pipeline.
+//
+// Renders every combination of bundled asset, scripted camera path, resolution and
+// wireframe / rotation setting without a console, at a fixed timestep so each run draws
+// the same frames on every build. For each run it reports frames per second, the median
+// time of every pipeline stage (see profiler.h), heap allocations and page faults per
+// frame, the frame arena's high-water mark and the mean triangle counts per frame at
+// each step of the pipeline (culled, clipped, emitted, cells filled), as JSON. The 99th
+// percentile frame time and the most resident memory (RSS) sampled during the run sit
+// alongside the medians, for the hitches and growth a median hides, and so does the
+// memory the scene's meshes hold ("mesh_bytes").
+//
+//   g++ -std=c++17 -O2 renderlite_bench.cpp -o renderlite_bench -lpthread -lrt
+//
+//   renderlite_bench [--quick] [--frames N] [--repeat N] [--filter text] [--assets dir]
+//                    [--counters] [--zero-alloc] [--instances N [--scatter] [--no-cull]]
+//                    [--no-lod] [--no-reorder] [--pack] [--clip-colours] [--depth D]
+//                    [--terrain synthetic|terrain.obj]
+//                    [--load other.obj] [--micro] [--out results.json]
+//                    [--baseline base.json [--threshold 0.10]]
+//
+// Allocations are counted process-wide and, via the profiler, per stage (see
+// alloctrack.h). --zero-alloc fails the run (exit code 1) if any configuration still
+// allocates once warmed up, so steady-state rendering stays allocation free.
+//
+// --counters adds the mean hardware counts per frame of every stage (cycles,
+// instructions, IPC, L1D / last-level cache misses, branch mispredicts, see
+// perfcounters.h). Where the machine has no usable counters the runs go ahead without
+// them and the results say "counters": null.
+//
+// --repeat renders each configuration N times and keeps the fastest (lowest median
+// frame time), which takes most scheduler and frequency noise out of the comparison.
+// --baseline compares against an earlier results file and flags any run whose fps
+// dropped, or whose frame / stage medians grew, by more than the threshold (default
+// 10%), and any run that allocates more per frame. The exit code is 1 if something
+// regressed, so it can gate a change.
+//
+// --instances draws that many copies of each asset (see scene_instances in renderlite.h)
+// and adds "/xN" to the run names, so results for different counts can sit side by side.
+// --scatter spreads them at random through a cube instead of a grid (scene_scatter) and
+// --no-cull draws every one without asking the scene's BVH which are in view
+// (scene_cull), adding "+scatter" and "+nocull" to the names.
+//
+// --no-lod draws everything at full detail (lod_enabled) and adds "+nolod". --no-reorder
+// keeps each mesh's triangles and vertices in the order the file has them rather than
+// vertex-cache order (mesh_reorder, see vcache.h) and adds "+noreorder". --pack keeps
+// them packed (mesh_pack, see mesh::Pack) and adds "+pack". --clip-colours colours the
+// pieces clipping cuts triangles into (show_clipping), which like wireframe draws through
+// a variant of the pipeline of its own (see pipelineFeatures), and adds "+clipcol".
+// --depth puts the scene D units in front of the camera instead of the demo's zdepth, on
+// every path but far, and adds "@D", so the levels of detail can be compared by distance.
+//
+// --terrain replaces the assets with a streamed terrain (see terrain.h), generated or cut
+// from an OBJ, flown over for BENCH_FLIGHT_FRAMES frames unless --frames says otherwise,
+// measured from when the first chunks have loaded. Those runs add a "terrain" object
+// with the warm-up frames, the most chunks and bytes resident, the chunks paged in, out
+// and discarded, and the mean chunks still missing per frame. Chunks are built and added
+// while the flight goes on, so --zero-alloc only holds the stages other than stream to
+// zero allocations on these runs.
+//
+// --load starts loading another OBJ in the background (see assetloader.h) on the first
+// measured frame of every asset run, and adds "+load". Those runs add a "load" object
+// with the frame it was swapped in on (-1 if the run ended first), the median, p99 and
+// worst frame times while it loaded, and the time of the frame that swapped it in, so
+// a loader that steals time from frames shows up. Frames after the swap draw the new
+// asset, and the swap itself allocates as the pipeline's buffers grow to suit it.
+//
+// --micro times single kernels instead of rendering: the quantizer per output target,
+// through its SSE2 and its portable loop (which must produce the same cells, or the exit
+// code is 1), resolving a frame to displayed colours per target, and the hot vector and
+// matrix operations of vecmath.h. Each is the median of BENCH_MICRO_BATCHES batches of
+// a fixed number of calls on a fixed input, and goes into "micro" with its time per
+// call (per operation for vecmath) and a checksum of its output, which --baseline
+// compares like the runs. --repeat keeps the fastest of N as it does for them, --quick
+// keeps to 256x240 and --filter picks kernels by name.
+
+#ifndef RENDERLITE_PROFILE
+#define RENDERLITE_PROFILE
+#endif
+#ifndef RENDERLITE_TRACK_ALLOCS
+#define RENDERLITE_TRACK_ALLOCS
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "renderlite.h"
+
+// frames rendered before measuring starts (caches, vector capacities); a terrain run
+// also waits for its first chunks to load
+static const int BENCH_WARMUP = 10;
+
+enum BENCH_PATH
+{
+    // camera stays put, only the model moves (if rotating)
+    PATH_STATIC,
+    // turn on the spot through a full circle and a bit
+    PATH_PAN,
+    // fly forward through the model, weaving left and right, then climb
+    PATH_FLY,
+    // the model pushed BENCH_FAR_DEPTH away, so it lands on a few cells per triangle
+    PATH_FAR,
+    // fly straight on over a streamed terrain, turning a little now and then (--terrain
+    // runs only)
+    PATH_FLYOVER,
+    PATH_COUNT,
+};
+
+static const char* const BENCH_PATH_NAME[PATH_COUNT] = { "static", "pan", "fly", "far", "flyover" };
+
+static const float BENCH_FAR_DEPTH = 80.0f;
+
+// a minute at 60 frames per second, 480 units of terrain
+static const int BENCH_FLIGHT_FRAMES = 3600;
+// frames between samples of the resident set size
+static const int BENCH_RSS_INTERVAL = 60;
+
+// pipelineStats, in the order and under the names they are reported
+static const int BENCH_PIPELINE_COUNTS = 17;
+static const char* const BENCH_PIPELINE_NAME[BENCH_PIPELINE_COUNTS] =
+{
+    "instances", "instances_culled", "frustum_culled", "lod_reduced", "lod_switches",
+    "input", "backface", "near_rejected", "near_clipped_1", "near_clipped_2",
+    "screen_rejected", "screen_clipped", "screen_inside", "emitted", "cells_filled", "small", "single_cell",
+};
+
+static void pipelineCounts(const pipelineStats& st, double n[BENCH_PIPELINE_COUNTS])
+{
+    n[0] = st.nInstances;
+    n[1] = st.nInstancesCulled;
+    n[2] = st.nFrustumCulled;
+    n[3] = st.nLodReduced;
+    n[4] = st.nLodSwitches;
+    n[5] = st.nInput;
+    n[6] = st.nBackface;
+    n[7] = st.nNearRejected;
+    n[8] = st.nNearClipped1;
+    n[9] = st.nNearClipped2;
+    n[10] = st.nScreenRejected;
+    n[11] = st.nScreenClipped;
+    n[12] = st.nScreenInside;
+    n[13] = st.nEmitted;
+    n[14] = (double)st.nCellsFilled;
+    n[15] = st.nSmall;
+    n[16] = st.nPoint;
+}
+
+struct benchRun
+{
+    std::string sAsset;
+    BENCH_PATH path;
+    int nWidth;
+    int nHeight;
+    bool bWireframe;
+    bool bRotate;
+    // clipped triangles coloured by how they were cut (show_clipping)
+    bool bClipColours;
+    // copies of the asset in the scene (scene_instances)
+    int nInstances;
+    // copies scattered through a volume rather than on a grid (scene_scatter), and
+    // whether the scene culls them against the view (scene_cull)
+    bool bScatter;
+    bool bCull;
+    // drawn at the chosen level of detail (lod_enabled), and how far in front of the
+    // camera the scene starts for every path but PATH_FAR (0 = the demo's zdepth)
+    bool bLod;
+    float fDepth;
+    // levels put in vertex-cache order when loaded (mesh_reorder), and packed (mesh_pack)
+    bool bReorder;
+    bool bPack;
+    // the streamed terrain drawn instead of an asset, which sAsset then names
+    bool bTerrain;
+    // an asset loaded in the background during the run, if not empty
+    std::string sLoad;
+
+    std::string Name() const
+    {
+        char s[160];
+        snprintf(s, sizeof(s), "%s/%s/%dx%d/%s%s", sAsset.c_str(), BENCH_PATH_NAME[path], nWidth, nHeight,
+            bWireframe ? "wire" : "fill", bRotate ? "+rotate" : "");
+        std::string sName = s;
+        if (bClipColours)
+            sName += "+clipcol";
+        if (nInstances != 1)
+            sName += "/x" + std::to_string(nInstances);
+        if (bScatter)
+            sName += "+scatter";
+        if (!bCull)
+            sName += "+nocull";
+        if (!bLod)
+            sName += "+nolod";
+        if (!bReorder)
+            sName += "+noreorder";
+        if (bPack)
+            sName += "+pack";
+        if (fDepth > 0.0f && path != PATH_FAR)
+        {
+            snprintf(s, sizeof(s), "@%g", fDepth);
+            sName += s;
+        }
+        if (!sLoad.empty())
+            sName += "+load";
+        return sName;
+    }
+};
+
+struct benchResult
+{
+    std::string sName;
+    benchRun run;
+    int nFrames = 0;
+    double fFps = 0.0;
+    double fAllocsPerFrame = 0.0;
+    // game thread only, per stage and (PROFILE_FRAME) in total
+    double fStageAllocs[PROFILE_STAGES] = {};
+    double fAllocBytesPerFrame = 0.0;
+    // minor + major page faults of the whole process
+    double fFaultsPerFrame = 0.0;
+    // most frame arena bytes any frame used
+    size_t nArenaHighWater = 0;
+    float fStageMedianMs[PROFILE_STAGES] = { 0.0f };
+    float fFrameP99Ms = 0.0f;
+    // most resident memory of the whole process, sampled every BENCH_RSS_INTERVAL frames
+    size_t nRssMax = 0;
+    // geometry the scene's meshes held at the end of the run
+    size_t nMeshBytes = 0;
+    // terrain runs only: the streamer's totals, and chunks missing per frame on average
+    terrainStats terrain;
+    double fTerrainMissing = 0.0;
+    // frames spent warming up, loading the first chunks included
+    int nWarmup = 0;
+    // --load: measured frame the new asset was swapped in on (-1 = never), frame times
+    // while it loaded and of the frame that swapped it in
+    int nSwapFrame = -1;
+    int nLoadingFrames = 0;
+    float fLoadingMedianMs = 0.0f;
+    float fLoadingP99Ms = 0.0f;
+    float fLoadingMaxMs = 0.0f;
+    float fSwapMs = 0.0f;
+    // mean hardware counts per frame, only with --counters
+    double fCounter[PROFILE_STAGES][PERF_COUNTERS] = {};
+    // mean pipelineStats per frame
+    double fPipeline[BENCH_PIPELINE_COUNTS] = {};
+    // profiler records lost to full rings over the measured frames; the stage
+    // timings are short when this is not 0
+    uint64_t nProfileDropped = 0;
+};
+
+static float median(std::vector<float>& v)
+{
+    if (v.empty())
+        return 0.0f;
+    std::nth_element(v.begin(), v.begin() + v.size() / 2, v.end());
+    return v[v.size() / 2];
+}
+
+static float percentile(std::vector<float>& v, float fRank)
+{
+    if (v.empty())
+        return 0.0f;
+    size_t n = min(v.size() - 1, (size_t)(fRank * v.size()));
+    std::nth_element(v.begin(), v.begin() + n, v.end());
+    return v[n];
+}
+
+
+// The demo with its keyboard replaced by a camera script, sampling the profiler and the
+// allocation counter once per frame
+class benchEngine : public olcEngine3D
+{
+public:
+    benchEngine(BENCH_PATH path, int nFrames, bool bTerrain, const std::string& sLoad) :
+        path(path), nFrames(nFrames), bLoading(bTerrain), sLoad(sLoad)
+    {
+        for (auto& v : vecStageMs)
+            v.reserve(nFrames);
+    }
+
+    bool OnUserUpdate(float fElapsedTime) override
+    {
+        int f = nFrame++;
+        // the terrain's first chunks still loading: keep warming up
+        if (f == nWarmup && bLoading)
+        {
+            if (GetTerrain().Active() && GetTerrain().Stats().nMissing > 0)
+                nWarmup++;
+            else
+                bLoading = false;
+        }
+
+        // the profiler closes a frame just before the next update starts, so this is
+        // the previous frame's breakdown, and the allocations it made
+        uint64_t nAllocs = allocProcessCount().load(std::memory_order_relaxed);
+        uint64_t nFaults = pageFaults();
+        if (f > nWarmup)
+        {
+            float fStage[PROFILE_STAGES];
+            Profiler::Get().LastFrame(fStage);
+            for (int s = 0; s < PROFILE_STAGES; s++)
+                vecStageMs[s].push_back(fStage[s]);
+            if (nLoadState == LOAD_WAITING)
+                vecLoadingMs.push_back(fStage[PROFILE_FRAME]);
+            else if (nLoadState == LOAD_SWAPPED)
+            {
+                fSwapMs = fStage[PROFILE_FRAME];
+                nLoadState = LOAD_DONE;
+            }
+            nAllocsMeasured += nAllocs - nAllocsLast;
+            nFaultsMeasured += nFaults - nFaultsLast;
+            if ((f - nWarmup) % BENCH_RSS_INTERVAL == 0)
+                nRssMax = max(nRssMax, residentBytes());
+
+            allocCount stageAllocs[PROFILE_STAGES];
+            Profiler::Get().LastFrameAllocs(stageAllocs);
+            for (int s = 0; s < PROFILE_STAGES; s++)
+                nStageAllocs[s] += stageAllocs[s].nAllocs;
+            nAllocBytes += stageAllocs[PROFILE_FRAME].nBytes;
+            nProfileDropped += Profiler::Get().LastFrameDropped();
+
+            uint64_t nCounter[PROFILE_STAGES][PERF_COUNTERS];
+            Profiler::Get().LastFrameCounters(nCounter);
+            for (int s = 0; s < PROFILE_STAGES; s++)
+                for (int c = 0; c < PERF_COUNTERS; c++)
+                    nCounterSum[s][c] += nCounter[s][c];
+        }
+        nAllocsLast = nAllocs;
+        nFaultsLast = nFaults;
+        if (f == nWarmup)
+            tStart = std::chrono::steady_clock::now();
+        tEnd = std::chrono::steady_clock::now();
+
+        Script(f);
+        if (f == nWarmup && !sLoad.empty())
+        {
+            nSwaps = GetAssetSwaps();
+            LoadAsset(sLoad.c_str());
+            nLoadState = LOAD_WAITING;
+        }
+        bool bContinue = olcEngine3D::OnUserUpdate(fElapsedTime);
+        if (nLoadState == LOAD_WAITING && GetAssetSwaps() != nSwaps)
+        {
+            nSwapFrame = f - nWarmup;
+            nLoadState = LOAD_SWAPPED;
+        }
+
+        // this frame's triangle counts, for the frames whose timings are measured
+        if (f >= nWarmup && f < nWarmup + nFrames)
+        {
+            double n[BENCH_PIPELINE_COUNTS];
+            pipelineCounts(GetPipelineStats(), n);
+            for (int i = 0; i < BENCH_PIPELINE_COUNTS; i++)
+                fPipelineSum[i] += n[i];
+            nPipelineFrames++;
+            nTerrainMissing += GetTerrain().Stats().nMissing;
+        }
+        return bContinue && nFrame < nWarmup + nFrames + 1;
+    }
+
+    void Result(benchResult& r)
+    {
+        r.nFrames = (int)vecStageMs[PROFILE_FRAME].size();
+        double fSeconds = std::chrono::duration<double>(tEnd - tStart).count();
+        r.fFps = fSeconds > 0.0 ? r.nFrames / fSeconds : 0.0;
+        r.fAllocsPerFrame = r.nFrames ? (double)nAllocsMeasured / r.nFrames : 0.0;
+        r.fAllocBytesPerFrame = r.nFrames ? (double)nAllocBytes / r.nFrames : 0.0;
+        r.fFaultsPerFrame = r.nFrames ? (double)nFaultsMeasured / r.nFrames : 0.0;
+        r.nArenaHighWater = GetFrameArena().HighWater();
+        r.nRssMax = max(nRssMax, residentBytes());
+        r.nMeshBytes = GetScene().Bytes();
+        r.terrain = GetTerrain().Stats();
+        r.fTerrainMissing = nPipelineFrames ? (double)nTerrainMissing / nPipelineFrames : 0.0;
+        r.nWarmup = nWarmup;
+        r.nSwapFrame = nSwapFrame;
+        r.nLoadingFrames = (int)vecLoadingMs.size();
+        r.fLoadingMaxMs = vecLoadingMs.empty() ? 0.0f : *std::max_element(vecLoadingMs.begin(), vecLoadingMs.end());
+        r.fLoadingP99Ms = percentile(vecLoadingMs, 0.99f);
+        r.fLoadingMedianMs = median(vecLoadingMs);
+        r.fSwapMs = fSwapMs;
+        r.fFrameP99Ms = percentile(vecStageMs[PROFILE_FRAME], 0.99f);
+        for (int s = 0; s < PROFILE_STAGES; s++)
+        {
+            r.fStageMedianMs[s] = median(vecStageMs[s]);
+            r.fStageAllocs[s] = r.nFrames ? (double)nStageAllocs[s] / r.nFrames : 0.0;
+            for (int c = 0; c < PERF_COUNTERS; c++)
+                r.fCounter[s][c] = r.nFrames ? (double)nCounterSum[s][c] / r.nFrames : 0.0;
+        }
+        for (int i = 0; i < BENCH_PIPELINE_COUNTS; i++)
+            r.fPipeline[i] = nPipelineFrames ? fPipelineSum[i] / nPipelineFrames : 0.0;
+        r.nProfileDropped = nProfileDropped;
+    }
+
+private:
+    BENCH_PATH path;
+    int nFrames;
+    int nFrame = 0;
+    int nWarmup = BENCH_WARMUP;
+    bool bLoading;
+    // --load: the asset, the swaps before it was asked for, and where it has got to
+    std::string sLoad;
+    enum { LOAD_NONE, LOAD_WAITING, LOAD_SWAPPED, LOAD_DONE } nLoadState = LOAD_NONE;
+    int nSwaps = 0;
+    int nSwapFrame = -1;
+    std::vector<float> vecLoadingMs;
+    float fSwapMs = 0.0f;
+    std::vector<float> vecStageMs[PROFILE_STAGES];
+    uint64_t nAllocsLast = 0;
+    uint64_t nAllocsMeasured = 0;
+    uint64_t nCounterSum[PROFILE_STAGES][PERF_COUNTERS] = {};
+    uint64_t nStageAllocs[PROFILE_STAGES] = {};
+    uint64_t nAllocBytes = 0;
+    uint64_t nProfileDropped = 0;
+    uint64_t nFaultsLast = 0;
+    uint64_t nFaultsMeasured = 0;
+    double fPipelineSum[BENCH_PIPELINE_COUNTS] = {};
+    int nPipelineFrames = 0;
+    uint64_t nTerrainMissing = 0;
+    size_t nRssMax = 0;
+    std::chrono::steady_clock::time_point tStart;
+    std::chrono::steady_clock::time_point tEnd;
+
+    static uint64_t pageFaults()
+    {
+        rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        return (uint64_t)ru.ru_minflt + ru.ru_majflt;
+    }
+
+    // the resident set size, read straight from /proc so sampling it does not allocate
+    static size_t residentBytes()
+    {
+        int fd = open("/proc/self/statm", O_RDONLY);
+        if (fd < 0)
+            return 0;
+        char buf[128];
+        ssize_t n = read(fd, buf, sizeof(buf) - 1);
+        close(fd);
+        if (n <= 0)
+            return 0;
+        buf[n] = 0;
+        // total program size, then resident pages
+        unsigned long nSize = 0, nPages = 0;
+        if (sscanf(buf, "%lu %lu", &nSize, &nPages) != 2)
+            return 0;
+        return (size_t)nPages * (size_t)sysconf(_SC_PAGESIZE);
+    }
+
+    void Hold(int nKey, bool bHeld)
+    {
+        m_keys[nKey].bHeld = bHeld;
+    }
+
+    void Script(int f)
+    {
+        float t = (float)f / (BENCH_WARMUP + nFrames);
+        Hold(L'W', false);
+        Hold(L'A', false);
+        Hold(L'D', false);
+        Hold(VK_UP, false);
+
+        switch (path)
+        {
+        case PATH_PAN:
+            Hold(L'D', true);
+            break;
+        case PATH_FLY:
+            // yaw swings about 0.7 rad either side of straight ahead
+            Hold(L'W', true);
+            Hold(L'A', (t >= 0.1f && t < 0.2f) || (t >= 0.4f && t < 0.5f));
+            Hold(L'D', t >= 0.2f && t < 0.4f);
+            Hold(VK_UP, t >= 0.6f);
+            break;
+        case PATH_FLYOVER:
+            // a third of a second's turn every four seconds, left then right, so the
+            // heading wanders about 0.7 rad either side of where it started
+            Hold(L'W', true);
+            Hold(L'A', f % 480 < 20);
+            Hold(L'D', f % 480 >= 240 && f % 480 < 260);
+            break;
+        default:
+            break;
+        }
+    }
+};
+
+// how far in front of the camera a run puts the scene
+static float zdepthOf(const benchRun& run)
+{
+    // the demo's own distance, read before the first run changes it
+    static const float fDemoDepth = zdepth;
+    if (run.path == PATH_FAR)
+        return BENCH_FAR_DEPTH;
+    return run.fDepth > 0.0f ? run.fDepth : fDemoDepth;
+}
+
+static benchResult runOne(const benchRun& run, const std::string& sAssetDir, int nFrames)
+{
+    benchResult r;
+    r.sName = run.Name();
+    r.run = run;
+
+    std::string sPath = run.bTerrain && run.sAsset == "synthetic" ? run.sAsset : sAssetDir + run.sAsset;
+    asset = sPath.c_str();
+    terrain = run.bTerrain ? sPath.c_str() : nullptr;
+    zdepth = zdepthOf(run);
+    show_wireframe = run.bWireframe;
+    rotate_obj = run.bRotate;
+    show_clipping = run.bClipColours;
+    scene_instances = run.nInstances;
+    scene_scatter = run.bScatter;
+    scene_cull = run.bCull;
+    lod_enabled = run.bLod;
+    mesh_reorder = run.bReorder;
+    mesh_pack = run.bPack;
+
+    benchEngine demo(run.path, nFrames, run.bTerrain, run.sLoad);
+    if (demo.ConstructHeadless(run.nWidth, run.nHeight))
+    {
+        // pan turns at 2 rad/s: 200 frames at 1/60 s is just over one revolution
+        demo.SetFixedTimestep(1.0f / 60.0f);
+        demo.Start();
+        demo.Result(r);
+    }
+    return r;
+}
+
+
+// --micro: single kernels timed on their own, outside the pipeline
+
+// each kernel is timed as this many batches of a fixed number of calls, and the
+// median batch kept
+static const int BENCH_MICRO_BATCHES = 15;
+
+static const char* const BENCH_TARGET_NAME[] = { "legacy16", "xterm256", "truecolor" };
+
+struct microResult
+{
+    std::string sName;
+    // median time of one call
+    double fNsPerCall = 0.0;
+    int nCalls = 0;
+    // hash of what the calls produced, the same for every path through one kernel
+    uint32_t nChecksum = 0;
+};
+
+template <typename F>
+static double microTime(int nCalls, F&& fn)
+{
+    // first call outside the clock: tables, caches, page faults
+    fn();
+    std::vector<float> vecNs;
+    for (int b = 0; b < BENCH_MICRO_BATCHES; b++)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < nCalls; i++)
+            fn();
+        vecNs.push_back((float)(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / nCalls));
+    }
+    return median(vecNs);
+}
+
+static uint32_t microHash(const void* p, size_t nBytes, uint32_t h = 2166136261u)
+{
+    const uint8_t* b = (const uint8_t*)p;
+    for (size_t i = 0; i < nBytes; i++)
+        h = (h ^ b[i]) * 16777619u;
+    return h;
+}
+
+// a shaded frame, the same on every run: gradients with a little noise, and one cell
+// in eight left to the glyph layer
+static void microShadeFrame(std::vector<uint32_t>& shade, int w, int h)
+{
+    shade.resize((size_t)w * h);
+    uint32_t seed = 12345;
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            int noise = (int)(seed >> 28) - 8;
+            shade[y * w + x] = (seed >> 24) % 8 == 0 ? 0 : shadeRGB((uint8_t)std::clamp(x * 255 / w + noise, 0, 255),
+                (uint8_t)std::clamp(y * 255 / h + noise, 0, 255), (uint8_t)std::clamp((x + y) * 127 / (w + h) + 64 + noise, 0, 255));
+        }
+}
+
+// Quantizer::Quantize per target, through the SSE2 and the portable loop, and then
+// resolving every cell to the colour it shows (olcFrame::CellRGB, what the sinks and
+// exports read), which is where truecolor spends its time instead. The two loops must
+// produce the same cells; returns false if they do not
+static bool microQuantize(int w, int h, const std::string& sFilter, std::vector<microResult>& results)
+{
+    int nCells = w * h;
+    std::vector<uint32_t> shade;
+    microShadeFrame(shade, w, h);
+    // about 16M cells per batch whatever the size
+    int nCalls = max(1, (16 << 20) / nCells);
+    std::string sSize = std::to_string(w) + "x" + std::to_string(h);
+    bool bMatch = true;
+
+    for (int t = OUTPUT_LEGACY16; t <= OUTPUT_TRUECOLOR; t++)
+    {
+        std::vector<uint32_t> cells;
+        std::vector<uint8_t> index;
+        uint32_t nScalarSum = 0;
+        bool bHaveScalar = false;
+
+        // scalar first, the SSE2 loop is checked against it
+        for (int nPath = 0; nPath < 2; nPath++)
+        {
+            bool bScalar = nPath == 0;
+#ifndef QUANTIZE_SSE2
+            if (!bScalar)
+                continue;
+#endif
+            microResult r;
+            r.sName = "quantize/" + std::string(BENCH_TARGET_NAME[t]) + "/" + sSize + (bScalar ? "/scalar" : "/sse2");
+            if (!sFilter.empty() && r.sName.find(sFilter) == std::string::npos)
+                continue;
+
+            Quantizer q;
+            q.SetTarget((OUTPUT_TARGET)t);
+            q.SetScalar(bScalar);
+            // glyph cells hold a space the quantizer must leave alone
+            cells.assign(nCells, 0x20);
+            index.assign(nCells, 0);
+            r.nCalls = nCalls;
+            r.fNsPerCall = microTime(nCalls, [&] { q.Quantize(shade.data(), cells.data(), index.data(), w, h); });
+            r.nChecksum = microHash(index.data(), index.size(), microHash(cells.data(), cells.size() * 4));
+            if (bScalar)
+            {
+                nScalarSum = r.nChecksum;
+                bHaveScalar = true;
+            }
+            else if (bHaveScalar && r.nChecksum != nScalarSum)
+            {
+                fprintf(stderr, "MISMATCH  %s differs from the scalar loop\n", r.sName.c_str());
+                bMatch = false;
+            }
+            results.push_back(r);
+        }
+
+        microResult r;
+        r.sName = "resolve/" + std::string(BENCH_TARGET_NAME[t]) + "/" + sSize;
+        if (!sFilter.empty() && r.sName.find(sFilter) == std::string::npos)
+            continue;
+        if (cells.empty())
+        {
+            Quantizer q;
+            q.SetTarget((OUTPUT_TARGET)t);
+            cells.assign(nCells, 0x20);
+            index.assign(nCells, 0);
+            q.Quantize(shade.data(), cells.data(), index.data(), w, h);
+        }
+        olcFrame frame;
+        frame.nWidth = w;
+        frame.nHeight = h;
+        frame.target = (OUTPUT_TARGET)t;
+        frame.pCells = (const CHAR_INFO*)cells.data();
+        frame.pShade = shade.data();
+        frame.pIndex = index.data();
+        uint32_t nSum = 0;
+        r.nCalls = nCalls;
+        r.fNsPerCall = microTime(nCalls, [&]
+            {
+                for (int i = 0; i < nCells; i++)
+                    nSum += frame.CellRGB(i);
+            });
+        r.nChecksum = nSum;
+        results.push_back(r);
+    }
+    return bMatch;
+}
+
+// the hot vecmath.h operations (and scene.h's batched transform), each applied to
+// BENCH_MICRO_OPS fixed random inputs per call; times are per operation. Their results
+// are checked against the functions they replaced by vecmath_test
+static const int BENCH_MICRO_OPS = 1024;
+
+static void microVecmath(const std::string& sFilter, std::vector<microResult>& results)
+{
+    const int n = BENCH_MICRO_OPS;
+    std::vector<vec3d> a(n), b(n), c(n), out(n);
+    std::vector<mat4x4> ma(n), mb(n), mOut(n);
+    std::vector<float> angles(n);
+    uint32_t seed = 12345;
+    auto rnd = [&] { seed = seed * 1664525u + 1013904223u; return (float)(seed >> 8) / 16777216.0f * 20.0f - 10.0f; };
+    for (int i = 0; i < n; i++)
+    {
+        a[i] = { rnd(), rnd(), rnd() };
+        b[i] = { rnd(), rnd(), rnd() };
+        c[i] = { rnd(), rnd(), rnd() };
+        for (int r = 0; r < 4; r++)
+            for (int k = 0; k < 4; k++)
+            {
+                ma[i].m[r][k] = rnd();
+                mb[i].m[r][k] = rnd();
+            }
+        angles[i] = rnd();
+    }
+
+    // about 4M operations per batch
+    const int nCalls = (4 << 20) / n;
+    auto kernel = [&](const char* sName, auto&& fn, bool bMatrices)
+    {
+        microResult r;
+        r.sName = std::string("vecmath/") + sName;
+        if (!sFilter.empty() && r.sName.find(sFilter) == std::string::npos)
+            return;
+        // each operation counts as a call
+        r.nCalls = nCalls * n;
+        r.fNsPerCall = microTime(nCalls, fn) / n;
+        r.nChecksum = bMatrices ? microHash(mOut.data(), mOut.size() * sizeof(mat4x4)) : microHash(out.data(), out.size() * sizeof(vec3d));
+        results.push_back(r);
+    };
+
+    kernel("matvecMult", [&] { for (int i = 0; i < n; i++) out[i] = matvecMult(ma[i], a[i]); }, false);
+    kernel("transformVerts", [&] { transformVerts(ma[0], a.data(), out.data(), n); }, false);
+    kernel("matrixMult", [&] { for (int i = 0; i < n; i++) mOut[i] = matrixMult(ma[i], mb[i]); }, true);
+    kernel("vectorCross+vectorNorm", [&] { for (int i = 0; i < n; i++) out[i] = vectorNorm(vectorCross(a[i], b[i])); }, false);
+    kernel("vectorIntersectPlane", [&] { for (int i = 0; i < n; i++) out[i] = vectorIntersectPlane(a[i], b[i], c[i], a[(i + 1) % n]); }, false);
+    kernel("matrixRotX", [&] { for (int i = 0; i < n; i++) mOut[i] = matrixRotX(angles[i]); }, true);
+    kernel("matrixPointAt", [&] { for (int i = 0; i < n; i++) mOut[i] = matrixPointAt(a[i], b[i], c[i]); }, true);
+    kernel("matrixInv", [&] { for (int i = 0; i < n; i++) mOut[i] = matrixInv(ma[i]); }, true);
+}
+
+
+// Just enough JSON to read a results file back in
+struct jsonValue
+{
+    enum { NUL, NUM, STR, BOOL, ARR, OBJ } type = NUL;
+    double num = 0.0;
+    std::string str;
+    std::vector<jsonValue> arr;
+    std::vector<std::pair<std::string, jsonValue>> obj;
+
+    const jsonValue* Get(const char* key) const
+    {
+        for (auto& kv : obj)
+            if (kv.first == key)
+                return &kv.second;
+        return nullptr;
+    }
+
+    double Num(const char* key, double def = 0.0) const
+    {
+        const jsonValue* v = Get(key);
+        return v != nullptr && v->type == NUM ? v->num : def;
+    }
+};
+
+class jsonParser
+{
+public:
+    jsonParser(const std::string& text) : s(text) {}
+
+    bool Parse(jsonValue& v)
+    {
+        Space();
+        if (i >= s.size())
+            return false;
+        char c = s[i];
+        if (c == '{')
+        {
+            v.type = jsonValue::OBJ;
+            i++;
+            Space();
+            if (Eat('}'))
+                return true;
+            do
+            {
+                Space();
+                std::string key;
+                if (!String(key))
+                    return false;
+                Space();
+                if (!Eat(':'))
+                    return false;
+                v.obj.emplace_back(key, jsonValue());
+                if (!Parse(v.obj.back().second))
+                    return false;
+                Space();
+            } while (Eat(','));
+            return Eat('}');
+        }
+        if (c == '[')
+        {
+            v.type = jsonValue::ARR;
+            i++;
+            Space();
+            if (Eat(']'))
+                return true;
+            do
+            {
+                v.arr.emplace_back();
+                if (!Parse(v.arr.back()))
+                    return false;
+                Space();
+            } while (Eat(','));
+            return Eat(']');
+        }
+        if (c == '"')
+        {
+            v.type = jsonValue::STR;
+            return String(v.str);
+        }
+        if (s.compare(i, 4, "true") == 0 || s.compare(i, 5, "false") == 0)
+        {
+            v.type = jsonValue::BOOL;
+            v.num = s[i] == 't';
+            i += s[i] == 't' ? 4 : 5;
+            return true;
+        }
+        if (s.compare(i, 4, "null") == 0)
+        {
+            i += 4;
+            return true;
+        }
+
+        char* end = nullptr;
+        v.type = jsonValue::NUM;
+        v.num = strtod(s.c_str() + i, &end);
+        if (end == s.c_str() + i)
+            return false;
+        i = end - s.c_str();
+        return true;
+    }
+
+private:
+    const std::string& s;
+    size_t i = 0;
+
+    void Space()
+    {
+        while (i < s.size() && (s[i] == ' ' || s[i] == '\n' || s[i] == '\r' || s[i] == '\t'))
+            i++;
+    }
+
+    bool Eat(char c)
+    {
+        if (i < s.size() && s[i] == c)
+        {
+            i++;
+            return true;
+        }
+        return false;
+    }
+
+    // our own output never escapes anything but quotes and backslashes
+    bool String(std::string& out)
+    {
+        if (!Eat('"'))
+            return false;
+        while (i < s.size() && s[i] != '"')
+        {
+            if (s[i] == '\\' && i + 1 < s.size())
+                i++;
+            out += s[i++];
+        }
+        return Eat('"');
+    }
+};
+
+
+static void writeJson(FILE* f, const std::vector<benchResult>& results, const std::vector<microResult>& micro, int nFrames, uint32_t nCounterMask)
+{
+    fprintf(f, "{\n  \"renderlite_bench\": 1,\n  \"frames\": %d,\n  \"counters\": ", nFrames);
+    if (nCounterMask == 0)
+        fprintf(f, "null");
+    else
+    {
+        fprintf(f, "[");
+        const char* sep = "";
+        for (int c = 0; c < PERF_COUNTERS; c++)
+            if (nCounterMask & (1u << c))
+            {
+                fprintf(f, "%s\"%s\"", sep, PERF_COUNTER_NAME[c]);
+                sep = ", ";
+            }
+        fprintf(f, "]");
+    }
+    fprintf(f, ",\n  \"runs\": [\n");
+    for (size_t k = 0; k < results.size(); k++)
+    {
+        const benchResult& r = results[k];
+        fprintf(f, "    {\"name\": \"%s\", \"asset\": \"%s\", \"path\": \"%s\", \"width\": %d, \"height\": %d, "
+            "\"wireframe\": %s, \"rotate\": %s, \"clip_colours\": %s, \"instances\": %d, \"scatter\": %s, \"cull\": %s, \"lod\": %s, \"reorder\": %s, \"pack\": %s, \"depth\": %g,\n",
+            r.sName.c_str(), r.run.sAsset.c_str(), BENCH_PATH_NAME[r.run.path], r.run.nWidth, r.run.nHeight,
+            r.run.bWireframe ? "true" : "false", r.run.bRotate ? "true" : "false",
+            r.run.bClipColours ? "true" : "false", r.run.nInstances,
+            r.run.bScatter ? "true" : "false", r.run.bCull ? "true" : "false",
+            r.run.bLod ? "true" : "false", r.run.bReorder ? "true" : "false", r.run.bPack ? "true" : "false", zdepthOf(r.run));
+        fprintf(f, "     \"frames\": %d, \"fps\": %.1f, \"frame_ms\": %.4f, \"frame_p99_ms\": %.4f, \"allocs_per_frame\": %.1f, \"alloc_bytes_per_frame\": %.0f,\n     \"page_faults_per_frame\": %.2f, \"arena_high_water\": %zu, \"rss_max\": %zu, \"mesh_bytes\": %zu, \"profile_dropped\": %llu,\n     \"terrain\": ",
+            r.nFrames, r.fFps, r.fStageMedianMs[PROFILE_FRAME], r.fFrameP99Ms, r.fAllocsPerFrame, r.fAllocBytesPerFrame,
+            r.fFaultsPerFrame, r.nArenaHighWater, r.nRssMax, r.nMeshBytes, (unsigned long long)r.nProfileDropped);
+        if (!r.run.bTerrain)
+            fprintf(f, "null");
+        else
+            fprintf(f, "{\"warmup_frames\": %d, \"resident_max\": %d, \"bytes_max\": %zu, \"paged_in\": %llu, \"paged_out\": %llu, \"discarded\": %llu, \"missing_per_frame\": %.2f}",
+                r.nWarmup, r.terrain.nResidentMax, r.terrain.nBytesMax, (unsigned long long)r.terrain.nPagedIn,
+                (unsigned long long)r.terrain.nPagedOut, (unsigned long long)r.terrain.nDiscarded, r.fTerrainMissing);
+        if (!r.run.sLoad.empty())
+            fprintf(f, ", \"load\": {\"path\": \"%s\", \"swap_frame\": %d, \"loading_frames\": %d, \"loading_frame_ms\": %.4f, \"loading_p99_ms\": %.4f, \"loading_max_ms\": %.4f, \"swap_ms\": %.4f}",
+                r.run.sLoad.c_str(), r.nSwapFrame, r.nLoadingFrames, r.fLoadingMedianMs, r.fLoadingP99Ms, r.fLoadingMaxMs, r.fSwapMs);
+        fprintf(f, ",\n     \"stages\": {");
+        for (int s = 0; s < PROFILE_FRAME; s++)
+            fprintf(f, "%s\"%s\": %.4f", s ? ", " : "", PROFILE_STAGE_NAME[s], r.fStageMedianMs[s]);
+        fprintf(f, "},\n     \"stage_allocs\": {");
+        for (int s = 0; s < PROFILE_FRAME; s++)
+            fprintf(f, "%s\"%s\": %.1f", s ? ", " : "", PROFILE_STAGE_NAME[s], r.fStageAllocs[s]);
+        fprintf(f, "},\n     \"pipeline\": {");
+        for (int i = 0; i < BENCH_PIPELINE_COUNTS; i++)
+            fprintf(f, "%s\"%s\": %.1f", i ? ", " : "", BENCH_PIPELINE_NAME[i], r.fPipeline[i]);
+        fprintf(f, "}");
+
+        // per stage and for the whole frame, only the counters the machine provides
+        if (nCounterMask != 0)
+        {
+            fprintf(f, ",\n     \"counters\": {");
+            for (int s = 0; s < PROFILE_STAGES; s++)
+            {
+                fprintf(f, "%s\n       \"%s\": {", s ? "," : "", PROFILE_STAGE_NAME[s]);
+                const char* sep = "";
+                for (int c = 0; c < PERF_COUNTERS; c++)
+                    if (nCounterMask & (1u << c))
+                    {
+                        fprintf(f, "%s\"%s\": %.0f", sep, PERF_COUNTER_NAME[c], r.fCounter[s][c]);
+                        sep = ", ";
+                    }
+                uint32_t nIpc = (1u << PERF_CYCLES) | (1u << PERF_INSTRUCTIONS);
+                if ((nCounterMask & nIpc) == nIpc)
+                    fprintf(f, ", \"ipc\": %.3f", r.fCounter[s][PERF_CYCLES] > 0.0 ? r.fCounter[s][PERF_INSTRUCTIONS] / r.fCounter[s][PERF_CYCLES] : 0.0);
+                fprintf(f, "}");
+            }
+            fprintf(f, "}");
+        }
+        fprintf(f, "}%s\n", k + 1 < results.size() ? "," : "");
+    }
+    fprintf(f, "  ],\n  \"micro\": [\n");
+    for (size_t k = 0; k < micro.size(); k++)
+    {
+        const microResult& m = micro[k];
+        fprintf(f, "    {\"name\": \"%s\", \"ns_per_call\": %.3f, \"calls\": %d, \"checksum\": \"%08x\"}%s\n",
+            m.sName.c_str(), m.fNsPerCall, m.nCalls, m.nChecksum, k + 1 < micro.size() ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+}
+
+// medians below this are timer noise and never count as regressions
+static const double BENCH_NOISE_MS = 0.02;
+// the same for a kernel's time per call; a batch takes milliseconds whatever the kernel
+static const double BENCH_MICRO_NOISE_NS = 1.0;
+
+static int compareBaseline(const std::vector<benchResult>& results, const std::vector<microResult>& micro, const char* sBaseline, double fThreshold)
+{
+    std::string text;
+    FILE* f = fopen(sBaseline, "rb");
+    if (f == nullptr)
+    {
+        fprintf(stderr, "bench: cannot read baseline %s\n", sBaseline);
+        return 2;
+    }
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        text.append(buf, n);
+    fclose(f);
+
+    jsonValue root;
+    jsonParser parser(text);
+    const jsonValue* runs = nullptr;
+    if (!parser.Parse(root) || (runs = root.Get("runs")) == nullptr || runs->type != jsonValue::ARR)
+    {
+        fprintf(stderr, "bench: %s is not a renderlite_bench results file\n", sBaseline);
+        return 2;
+    }
+
+    int nRegressions = 0, nCompared = 0;
+    for (const benchResult& r : results)
+    {
+        const jsonValue* base = nullptr;
+        for (auto& run : runs->arr)
+        {
+            const jsonValue* name = run.Get("name");
+            if (name != nullptr && name->str == r.sName)
+                base = &run;
+        }
+        if (base == nullptr)
+            continue;
+        nCompared++;
+
+        auto flag = [&](const char* what, double fBase, double fNow, bool bWorse)
+        {
+            if (!bWorse)
+                return;
+            fprintf(stderr, "REGRESSION %-44s %-16s %10.4f -> %10.4f (%+.1f%%)\n", r.sName.c_str(), what,
+                fBase, fNow, fBase != 0.0 ? (fNow / fBase - 1.0) * 100.0 : 0.0);
+            nRegressions++;
+        };
+
+        double fBaseFps = base->Num("fps");
+        flag("fps", fBaseFps, r.fFps, r.fFps < fBaseFps * (1.0 - fThreshold));
+
+        double fBaseFrame = base->Num("frame_ms");
+        flag("frame_ms", fBaseFrame, r.fStageMedianMs[PROFILE_FRAME],
+            fBaseFrame >= BENCH_NOISE_MS && r.fStageMedianMs[PROFILE_FRAME] > fBaseFrame * (1.0 + fThreshold));
+
+        const jsonValue* stages = base->Get("stages");
+        for (int s = 0; s < PROFILE_FRAME && stages != nullptr; s++)
+        {
+            double fBase = stages->Num(PROFILE_STAGE_NAME[s]);
+            std::string what = std::string("stage ") + PROFILE_STAGE_NAME[s];
+            flag(what.c_str(), fBase, r.fStageMedianMs[s],
+                fBase >= BENCH_NOISE_MS && r.fStageMedianMs[s] > fBase * (1.0 + fThreshold));
+        }
+
+        // allocation counts are deterministic, any growth is real
+        double fBaseAllocs = base->Num("allocs_per_frame");
+        flag("allocs/frame", fBaseAllocs, r.fAllocsPerFrame, r.fAllocsPerFrame > fBaseAllocs + 0.5);
+    }
+
+    // results from before --micro existed have no "micro"
+    const jsonValue* baseMicro = root.Get("micro");
+    for (const microResult& m : micro)
+    {
+        if (baseMicro == nullptr || baseMicro->type != jsonValue::ARR)
+            break;
+        const jsonValue* base = nullptr;
+        for (auto& k : baseMicro->arr)
+        {
+            const jsonValue* name = k.Get("name");
+            if (name != nullptr && name->str == m.sName)
+                base = &k;
+        }
+        if (base == nullptr)
+            continue;
+        nCompared++;
+
+        double fBase = base->Num("ns_per_call");
+        if (fBase >= BENCH_MICRO_NOISE_NS && m.fNsPerCall > fBase * (1.0 + fThreshold))
+        {
+            fprintf(stderr, "REGRESSION %-44s %-16s %10.4f -> %10.4f (%+.1f%%)\n", m.sName.c_str(), "ns/call",
+                fBase, m.fNsPerCall, (m.fNsPerCall / fBase - 1.0) * 100.0);
+            nRegressions++;
+        }
+    }
+
+    fprintf(stderr, "bench: compared %d runs against %s (threshold %.0f%%): %d regression%s\n",
+        nCompared, sBaseline, fThreshold * 100.0, nRegressions, nRegressions == 1 ? "" : "s");
+    return nRegressions > 0 ? 1 : 0;
+}
+
+
+int main(int argc, char** argv)
+{
+    int nFrames = 200;
+    int nRepeat = 1;
+    bool bQuick = false;
+    std::string sFilter, sAssetDir;
+    const char* sOut = nullptr;
+    const char* sBaseline = nullptr;
+    double fThreshold = 0.10;
+    bool bCounters = false;
+    bool bZeroAlloc = false;
+    int nInstances = 1;
+    bool bScatter = false;
+    bool bCull = true;
+    bool bLod = true;
+    bool bReorder = true;
+    bool bPack = false;
+    bool bClipColours = false;
+    float fDepth = 0.0f;
+    const char* sTerrain = nullptr;
+    std::string sLoad;
+    bool bFrames = false;
+    bool bMicro = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string a = argv[i];
+        if (a == "--quick") bQuick = true;
+        else if (a == "--frames" && i + 1 < argc) nFrames = max(1, atoi(argv[++i])), bFrames = true;
+        else if (a == "--repeat" && i + 1 < argc) nRepeat = max(1, atoi(argv[++i]));
+        else if (a == "--filter" && i + 1 < argc) sFilter = argv[++i];
+        else if (a == "--assets" && i + 1 < argc) sAssetDir = std::string(argv[++i]) + "/";
+        else if (a == "--counters") bCounters = true;
+        else if (a == "--zero-alloc") bZeroAlloc = true;
+        else if (a == "--instances" && i + 1 < argc) nInstances = max(1, atoi(argv[++i]));
+        else if (a == "--scatter") bScatter = true;
+        else if (a == "--no-cull") bCull = false;
+        else if (a == "--no-lod") bLod = false;
+        else if (a == "--no-reorder") bReorder = false;
+        else if (a == "--pack") bPack = true;
+        else if (a == "--clip-colours") bClipColours = true;
+        else if (a == "--depth" && i + 1 < argc) fDepth = max(0.0f, (float)atof(argv[++i]));
+        else if (a == "--terrain" && i + 1 < argc) sTerrain = argv[++i];
+        else if (a == "--load" && i + 1 < argc) sLoad = argv[++i];
+        else if (a == "--micro") bMicro = true;
+        else if (a == "--out" && i + 1 < argc) sOut = argv[++i];
+        else if (a == "--baseline" && i + 1 < argc) sBaseline = argv[++i];
+        else if (a == "--threshold" && i + 1 < argc) fThreshold = atof(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: %s [--quick] [--frames N] [--repeat N] [--filter text] [--assets dir] "
+                "[--counters] [--zero-alloc] [--instances N [--scatter] [--no-cull]] [--no-lod] [--no-reorder] [--pack] [--clip-colours] [--depth D] [--terrain synthetic|terrain.obj] [--load other.obj] [--micro] [--out results.json] [--baseline base.json [--threshold 0.10]]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    // no console, no trace file per run
+    trace_path = nullptr;
+
+    uint32_t nCounterMask = 0;
+    if (bCounters)
+    {
+        std::string sWhy;
+        if (Profiler::Get().EnableCounters(sWhy))
+        {
+            nCounterMask = Profiler::Get().CountersAvailable();
+            for (int c = 0; c < PERF_COUNTERS; c++)
+                if (!(nCounterMask & (1u << c)))
+                    fprintf(stderr, "bench: counter %s not supported here\n", PERF_COUNTER_NAME[c]);
+        }
+        else
+            fprintf(stderr, "bench: hardware counters unavailable, running without them: %s\n", sWhy.c_str());
+    }
+
+    const char* assets[] = { "axis.obj", "ship.obj", "teapot.obj", "mountains.obj" };
+    const int resolutions[][2] = { { 128, 120 }, { 256, 240 }, { 512, 480 } };
+
+    std::vector<benchRun> runs;
+    for (const char* sAsset : assets)
+        for (int p = 0; p < PATH_COUNT; p++)
+            for (auto& res : resolutions)
+                for (int mode = 0; mode < 4; mode++)
+                {
+                    benchRun run = { sAsset, (BENCH_PATH)p, res[0], res[1], (mode & 1) != 0, (mode & 2) != 0, bClipColours, nInstances, bScatter, bCull, bLod, fDepth, bReorder, bPack, false, sLoad };
+                    if (bMicro || sTerrain != nullptr || run.path == PATH_FLYOVER)
+                        continue;
+                    if (bQuick && (run.nWidth != 256 || run.bRotate))
+                        continue;
+                    if (!sFilter.empty() && run.Name().find(sFilter) == std::string::npos)
+                        continue;
+                    runs.push_back(run);
+                }
+    // the terrain is one scene, flown over, filled and as wireframe
+    if (sTerrain != nullptr && !bMicro)
+    {
+        if (!bFrames)
+            nFrames = BENCH_FLIGHT_FRAMES;
+        for (auto& res : resolutions)
+            for (int mode = 0; mode < 2; mode++)
+            {
+                benchRun run = { sTerrain, PATH_FLYOVER, res[0], res[1], mode != 0, false, bClipColours, 1, false, true, bLod, 0.0f, bReorder, bPack, true, "" };
+                if (bQuick && run.nWidth != 256)
+                    continue;
+                if (!sFilter.empty() && run.Name().find(sFilter) == std::string::npos)
+                    continue;
+                runs.push_back(run);
+            }
+    }
+
+    std::vector<benchResult> results;
+    for (const benchRun& run : runs)
+    {
+        // the generated terrain has no file
+        if (!run.bTerrain || run.sAsset != "synthetic")
+        {
+            FILE* f = fopen((sAssetDir + run.sAsset).c_str(), "r");
+            if (f == nullptr)
+            {
+                fprintf(stderr, "bench: skipping %s, cannot open %s%s\n", run.Name().c_str(), sAssetDir.c_str(), run.sAsset.c_str());
+                continue;
+            }
+            fclose(f);
+        }
+
+        benchResult best = runOne(run, sAssetDir, nFrames);
+        for (int k = 1; k < nRepeat; k++)
+        {
+            benchResult r = runOne(run, sAssetDir, nFrames);
+            if (r.fStageMedianMs[PROFILE_FRAME] < best.fStageMedianMs[PROFILE_FRAME])
+                best = r;
+        }
+        results.push_back(best);
+        const benchResult& r = results.back();
+        fprintf(stderr, "%-44s %8.1f fps  frame %7.3f ms  raster %7.3f ms  %7.1f allocs/frame\n", r.sName.c_str(),
+            r.fFps, r.fStageMedianMs[PROFILE_FRAME], r.fStageMedianMs[PROFILE_RASTER], r.fAllocsPerFrame);
+        if (run.bTerrain)
+            fprintf(stderr, "%-44s p99 %7.3f ms  rss %zu KB  %d chunks / %zu KB resident at most, %llu paged in\n", "",
+                r.fFrameP99Ms, r.nRssMax / 1024, r.terrain.nResidentMax, r.terrain.nBytesMax / 1024,
+                (unsigned long long)r.terrain.nPagedIn);
+        if (r.nProfileDropped > 0)
+            fprintf(stderr, "%-44s %llu profiler records dropped, stage timings are short\n", "", (unsigned long long)r.nProfileDropped);
+    }
+
+    std::vector<microResult> micro;
+    bool bMicroMatch = true;
+    if (bMicro)
+    {
+        // like the runs, --repeat keeps each kernel's fastest time
+        auto repeat = [&](auto&& kernels)
+        {
+            size_t nFirst = micro.size();
+            bMicroMatch &= kernels(micro);
+            for (int k = 1; k < nRepeat; k++)
+            {
+                std::vector<microResult> again;
+                bMicroMatch &= kernels(again);
+                for (size_t i = 0; i < again.size(); i++)
+                    micro[nFirst + i].fNsPerCall = min(micro[nFirst + i].fNsPerCall, again[i].fNsPerCall);
+            }
+        };
+        for (auto& res : resolutions)
+        {
+            if (bQuick && res[0] != 256)
+                continue;
+            repeat([&](std::vector<microResult>& out) { return microQuantize(res[0], res[1], sFilter, out); });
+        }
+        repeat([&](std::vector<microResult>& out) { microVecmath(sFilter, out); return true; });
+        for (const microResult& m : micro)
+            fprintf(stderr, "%-44s %12.1f ns/call  (%d calls x %d)\n", m.sName.c_str(), m.fNsPerCall, m.nCalls, BENCH_MICRO_BATCHES);
+    }
+
+    FILE* out = stdout;
+    if (sOut != nullptr && (out = fopen(sOut, "w")) == nullptr)
+    {
+        fprintf(stderr, "bench: cannot write %s\n", sOut);
+        return 2;
+    }
+    writeJson(out, results, micro, nFrames, nCounterMask);
+    if (out != stdout)
+        fclose(out);
+
+    int nExit = sBaseline != nullptr ? compareBaseline(results, micro, sBaseline, fThreshold) : 0;
+    if (!bMicroMatch && nExit == 0)
+        nExit = 1;
+
+    if (bZeroAlloc)
+    {
+        int nAllocating = 0;
+        for (const benchResult& r : results)
+        {
+            // chunks streaming in allocate by design; hold the rest of the frame to zero
+            double fAllocs = r.run.bTerrain ? r.fStageAllocs[PROFILE_FRAME] - r.fStageAllocs[PROFILE_STREAM] : r.fAllocsPerFrame;
+            if (fAllocs == 0.0)
+                continue;
+            nAllocating++;
+            fprintf(stderr, "ALLOCATES  %-44s %.1f allocs/frame:", r.sName.c_str(), fAllocs);
+            for (int s = 0; s < PROFILE_FRAME; s++)
+                if (r.fStageAllocs[s] > 0.0)
+                    fprintf(stderr, " %s %.1f", PROFILE_STAGE_NAME[s], r.fStageAllocs[s]);
+            fprintf(stderr, "\n");
+        }
+        fprintf(stderr, "bench: %d of %zu runs allocate in steady state\n", nAllocating, results.size());
+        if (nAllocating > 0 && nExit == 0)
+            nExit = 1;
+    }
+    return nExit;
+}
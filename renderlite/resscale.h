@@ -0,0 +1,391 @@
+// resscale.h : dynamic resolution, picking a render size that keeps frames within a budget.
+//
+// ResolutionScaler is fed the time every frame took to render and keeps a scale factor
+// between its bounds: once RESSCALE_WINDOW frames have been seen at the current scale it
+// compares their mean with the target, and if the frames are over budget, or well under
+// it, moves the scale by the square root of the ratio (the rasterised area goes with the
+// square of the scale), at most RESSCALE_MAX_STEP per move and in steps of
+// RESSCALE_QUANTUM so it settles instead of creeping.
+//
+// Work that does not depend on the resolution (transform, clipping, presenting the full
+// console) is not reduced by it, and stretching the frame back up costs about as much as
+// clearing the whole screen, so going down only pays where filling dominates. A step down
+// that did not make frames faster is undone, and the scale is not taken below it again
+// for RESSCALE_RETRY windows.
+//
+// The app renders into the top-left Size() cells of the screen buffers and stretches them
+// over the whole screen, nearest cell in place (resampleNearest), or bilinear on the
+// shades from a packed copy (resampleBilinear). Glyph cells cannot be blended and are
+// always taken from the nearest cell.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "quantize.h"
+#include "vecmath.h"
+
+enum RESAMPLE_FILTER
+{
+    RESAMPLE_NEAREST,
+    RESAMPLE_BILINEAR,
+};
+
+// frames averaged for each decision
+static const int RESSCALE_WINDOW = 8;
+// a window this far under the target lets the scale go up again
+static const float RESSCALE_HEADROOM = 0.8f;
+// largest relative change of the scale per decision
+static const float RESSCALE_MAX_STEP = 0.25f;
+// the scale moves in steps of this
+static const float RESSCALE_QUANTUM = 1.0f / 32.0f;
+// a step down has to take this much off the mean frame time to be kept
+static const float RESSCALE_MIN_GAIN = 0.03f;
+// windows before a scale that did not pay is tried again (the scene may have changed)
+static const int RESSCALE_RETRY = 32;
+
+class ResolutionScaler
+{
+public:
+    // frame time to hold in ms, 0 = off (render at the upper bound)
+    void SetTarget(float fMs)
+    {
+        fTargetMs = std::max(fMs, 0.0f);
+        nFrames = 0;
+        Forget();
+        if (fTargetMs == 0.0f)
+            fScale = fMaxScale;
+    }
+
+    // range of the scale, as a fraction of the screen size per axis
+    void SetBounds(float fMin, float fMax)
+    {
+        fMaxScale = std::min(std::max(fMax, RESSCALE_QUANTUM), 1.0f);
+        fMinScale = std::min(std::max(fMin, RESSCALE_QUANTUM), fMaxScale);
+        fScale = fTargetMs > 0.0f ? std::min(std::max(fScale, fMinScale), fMaxScale) : fMaxScale;
+        nFrames = 0;
+        Forget();
+    }
+
+    float Target() const { return fTargetMs; }
+    float MinScale() const { return fMinScale; }
+    float MaxScale() const { return fMaxScale; }
+    float Scale() const { return fScale; }
+    // scale changes since the start
+    uint32_t Changes() const { return nChanges; }
+
+    // render size for a screen of nWidth x nHeight at the current scale
+    void Size(int nWidth, int nHeight, int& w, int& h) const
+    {
+        w = std::min(std::max((int)(nWidth * fScale + 0.5f), 1), nWidth);
+        h = std::min(std::max((int)(nHeight * fScale + 0.5f), 1), nHeight);
+    }
+
+    // time the last frame took to render at Scale(); true if the scale changed
+    bool Update(float fFrameMs)
+    {
+        if (fTargetMs <= 0.0f)
+            return false;
+
+        fWindowMs[nFrames++] = fFrameMs;
+        if (nFrames < RESSCALE_WINDOW)
+            return false;
+
+        float fMean = 0.0f;
+        for (float f : fWindowMs)
+            fMean += f;
+        fMean /= RESSCALE_WINDOW;
+        nFrames = 0;
+        if (nRetry > 0 && --nRetry == 0)
+            fFloor = fMinScale;
+
+        // the last step down did not pay: back to where it came from, and stay there
+        if (fScale < fPrevScale && fMean > fPrevMeanMs * (1.0f - RESSCALE_MIN_GAIN))
+        {
+            fFloor = fPrevScale;
+            nRetry = RESSCALE_RETRY;
+            return Move(fPrevScale, fMean);
+        }
+
+        if (fMean <= fTargetMs && fMean >= fTargetMs * RESSCALE_HEADROOM)
+            return false;
+
+        // aim between the headroom and the target, so the next window lands inside the band
+        float fAim = fTargetMs * (1.0f + RESSCALE_HEADROOM) * 0.5f;
+        float fRatio = std::sqrt(fAim / std::max(fMean, 1e-3f));
+        fRatio = std::min(std::max(fRatio, 1.0f - RESSCALE_MAX_STEP), 1.0f + RESSCALE_MAX_STEP);
+
+        float fNew = std::round(fScale * fRatio / RESSCALE_QUANTUM) * RESSCALE_QUANTUM;
+        // a move smaller than a quantum still goes one quantum the right way
+        if (fNew == fScale)
+            fNew += fRatio > 1.0f ? RESSCALE_QUANTUM : -RESSCALE_QUANTUM;
+        fNew = std::min(std::max(fNew, fFloor), fMaxScale);
+        return Move(fNew, fMean);
+    }
+
+private:
+    float fTargetMs = 0.0f;
+    float fMinScale = 0.5f;
+    float fMaxScale = 1.0f;
+    float fScale = 1.0f;
+    float fWindowMs[RESSCALE_WINDOW] = {};
+    int nFrames = 0;
+    uint32_t nChanges = 0;
+    // scale before the last move and the mean frame time it ran at
+    float fPrevScale = 1.0f;
+    float fPrevMeanMs = 0.0f;
+    // lowest scale worth going to, and windows until that is tried again
+    float fFloor = 0.5f;
+    int nRetry = 0;
+
+    bool Move(float fNew, float fMeanMs)
+    {
+        if (fNew == fScale)
+            return false;
+        fPrevScale = fScale;
+        fPrevMeanMs = fMeanMs;
+        fScale = fNew;
+        nChanges++;
+        return true;
+    }
+
+    // nothing measured so far applies any more
+    void Forget()
+    {
+        fPrevScale = fScale;
+        fFloor = fMinScale;
+        nRetry = 0;
+    }
+};
+
+// mix two shade cells, f / 256 of the way from a to b (red and blue move together)
+inline uint32_t resampleLerp(uint32_t a, uint32_t b, uint32_t f)
+{
+    uint32_t rb = ((a & 0x00FF00FFu) * (256 - f) + (b & 0x00FF00FFu) * f) >> 8;
+    uint32_t g = ((a & 0x0000FF00u) * (256 - f) + (b & 0x0000FF00u) * f) >> 8;
+    return (rb & 0x00FF00FFu) | (g & 0x0000FF00u) | 0xFF000000u;
+}
+
+#ifdef VECMATH_SSE2
+// resampleLerp on 4 cells at once, weights given per channel as 16-bit lanes (a two
+// cells of 4 channels per register half, wA = 256 - f, wB = f)
+inline __m128i resampleLerp4(__m128i a, __m128i b, __m128i wAlo, __m128i wBlo, __m128i wAhi, __m128i wBhi)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), wAlo),
+                                              _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), wBlo)), 8);
+    __m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), wAhi),
+                                              _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), wBhi)), 8);
+    return _mm_or_si128(_mm_packus_epi16(lo, hi), _mm_set1_epi32((int)0xFF000000u));
+}
+
+// all-ones in the lanes of a or b that are glyph cells
+inline __m128i resampleGlyphs4(__m128i a, __m128i b)
+{
+    const __m128i zero = _mm_setzero_si128();
+    return _mm_or_si128(_mm_cmpeq_epi32(_mm_srli_epi32(a, 24), zero),
+                        _mm_cmpeq_epi32(_mm_srli_epi32(b, 24), zero));
+}
+#endif
+
+// where each of W destination columns samples a source row of w cells, bilinear:
+// source cell (bits 0..15), weight of the cell to its right (bits 16..23), and whether
+// there is one (bit 24, clear at the right edge)
+inline void resampleColumns(int w, int W, int32_t nStepX, uint32_t* cols)
+{
+    // centre of cell x is at source position (x + 0.5) * w / W - 0.5, clamped to the edges
+    int32_t u = nStepX / 2 - 0x8000;
+    for (int x = 0; x < W; x++, u += nStepX)
+    {
+        int32_t uc = std::min(std::max(u, 0), (w - 1) << 16);
+        uint32_t x0 = (uint32_t)uc >> 16;
+        cols[x] = x0 | (((uint32_t)uc >> 8 & 0xFF) << 16) | ((x0 + 1 < (uint32_t)w) << 24);
+    }
+}
+
+// one row of the horizontal bilinear pass: source row src stretched to W cells into dst,
+// cells next to a glyph cell taking the nearest source cell instead
+inline void resampleRow(const uint32_t* src, const uint32_t* cols, uint32_t* dst, int W)
+{
+    int x = 0;
+
+#ifdef VECMATH_SSE2
+    const __m128i n256 = _mm_set1_epi16(256);
+    for (; x + 4 <= W; x += 4)
+    {
+        const uint32_t* c = cols + x;
+        const uint32_t* p0 = src + (c[0] & 0xFFFF);
+        const uint32_t* p1 = src + (c[1] & 0xFFFF);
+        const uint32_t* p2 = src + (c[2] & 0xFFFF);
+        const uint32_t* p3 = src + (c[3] & 0xFFFF);
+        __m128i a = _mm_set_epi32((int)p3[0], (int)p2[0], (int)p1[0], (int)p0[0]);
+        __m128i b = _mm_set_epi32((int)p3[c[3] >> 24], (int)p2[c[2] >> 24], (int)p1[c[1] >> 24], (int)p0[c[0] >> 24]);
+        if (_mm_movemask_epi8(resampleGlyphs4(a, b)) != 0)
+        {
+            for (int k = 0; k < 4; k++)
+            {
+                uint32_t fx = (c[k] >> 16) & 0xFF;
+                uint32_t ak = src[c[k] & 0xFFFF], bk = src[(c[k] & 0xFFFF) + (c[k] >> 24)];
+                dst[x + k] = isShaded(ak) && isShaded(bk) ? resampleLerp(ak, bk, fx) : (fx < 128 ? ak : bk);
+            }
+            continue;
+        }
+
+        // each cell's weight spread over its 4 channels
+        __m128i f = _mm_and_si128(_mm_srli_epi32(_mm_loadu_si128((const __m128i*)c), 16), _mm_set1_epi32(0xFF));
+        __m128i fLo = _mm_unpacklo_epi32(f, f);
+        __m128i fHi = _mm_unpackhi_epi32(f, f);
+        fLo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(fLo, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+        fHi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(fHi, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+        _mm_storeu_si128((__m128i*)(dst + x),
+            resampleLerp4(a, b, _mm_sub_epi16(n256, fLo), fLo, _mm_sub_epi16(n256, fHi), fHi));
+    }
+#endif
+
+    for (; x < W; x++)
+    {
+        uint32_t c = cols[x];
+        const uint32_t* p = src + (c & 0xFFFF);
+        uint32_t fx = (c >> 16) & 0xFF;
+        uint32_t a = p[0], b = p[c >> 24];
+        if (isShaded(a) && isShaded(b))
+            dst[x] = resampleLerp(a, b, fx);
+        else
+            dst[x] = fx < 128 ? a : b;
+    }
+}
+
+// Stretch the top-left w x h cells of a W x H image of shade cells (see quantize.h) and
+// glyph cells over all of it, nearest cell, in place: working from the bottom row up
+// (and right to left along the top row), every source cell is read before anything is
+// written over it. Glyph cells
+// are only copied where the result is a glyph cell, since the quantizer rewrites the
+// rest anyway. Sample positions are stepped in 16.16 fixed point, so there is no division
+// per cell, and a row that samples the same source row as the one below it is a copy.
+template <typename CELL>
+void resampleNearest(uint32_t* shade, CELL* cells, int w, int h, int W, int H)
+{
+    // cell x takes source cell x * w / W
+    int32_t nStepX = (int32_t)(((int64_t)w << 16) / W);
+    int32_t nStepY = (int32_t)(((int64_t)h << 16) / H);
+    int nLastRow = -1;
+    bool bGlyphs = false;
+    for (int y = H - 1; y >= 0; y--)
+    {
+        uint32_t* dShade = shade + (size_t)y * W;
+        CELL* dCell = cells + (size_t)y * W;
+        int sy = (int)(((int64_t)y * nStepY) >> 16);
+        if (sy == nLastRow)
+        {
+            memcpy(dShade, dShade + W, sizeof(uint32_t) * W);
+            if (bGlyphs)
+                memcpy((void*)dCell, dCell + W, sizeof(CELL) * W);
+            continue;
+        }
+        nLastRow = sy;
+        bGlyphs = false;
+
+        const uint32_t* sShade = shade + (size_t)sy * W;
+        const CELL* sCell = cells + (size_t)sy * W;
+        auto stretch = [&](int x, int32_t u)
+            {
+                uint32_t s = sShade[u >> 16];
+                dShade[x] = s;
+                if (!isShaded(s))
+                {
+                    dCell[x] = sCell[u >> 16];
+                    bGlyphs = true;
+                }
+            };
+        // only the top row is its own source, and has to go right to left
+        if (sy == y)
+            for (int x = W - 1; x >= 0; x--)
+                stretch(x, x * nStepX);
+        else
+            for (int x = 0, u = 0; x < W; x++, u += nStepX)
+                stretch(x, u);
+    }
+}
+
+// Upsample a w x h image of shade cells and their glyph cells to W x H, bilinear on the
+// shades; the source must not overlap the destination. Filtering is separable: each
+// source row is stretched horizontally once, into two rows of scratch (3 * W cells, the
+// third holds the column table), and destination rows blend two of those.
+template <typename CELL>
+void resampleBilinear(const uint32_t* srcShade, const CELL* srcCell, int w, int h,
+    uint32_t* dstShade, CELL* dstCell, int W, int H, uint32_t* scratch)
+{
+    int32_t nStepX = (int32_t)(((int64_t)w << 16) / W);
+    int32_t nStepY = (int32_t)(((int64_t)h << 16) / H);
+
+    // rows[0] / rows[1] hold source rows nRow[0] / nRow[1] stretched to W
+    uint32_t* rows[2] = { scratch, scratch + W };
+    uint32_t* cols = scratch + 2 * W;
+    resampleColumns(w, W, nStepX, cols);
+    int nRow[2] = { -1, -1 };
+    int32_t v = nStepY / 2 - 0x8000;
+    for (int y = 0; y < H; y++, v += nStepY)
+    {
+        int32_t vc = std::min(std::max(v, 0), (h - 1) << 16);
+        int y0 = vc >> 16;
+        int y1 = std::min(y0 + 1, h - 1);
+        uint32_t fy = (vc >> 8) & 0xFF;
+
+        if (nRow[1] == y0 && nRow[0] != y0)
+        {
+            std::swap(rows[0], rows[1]);
+            std::swap(nRow[0], nRow[1]);
+        }
+        if (nRow[0] != y0)
+        {
+            resampleRow(srcShade + (size_t)y0 * w, cols, rows[0], W);
+            nRow[0] = y0;
+        }
+        if (nRow[1] != y1)
+        {
+            resampleRow(srcShade + (size_t)y1 * w, cols, rows[1], W);
+            nRow[1] = y1;
+        }
+
+        uint32_t* dShade = dstShade + (size_t)y * W;
+        CELL* dCell = dstCell + (size_t)y * W;
+        const CELL* sCell = srcCell + (size_t)(fy < 128 ? y0 : y1) * w;
+        const uint32_t* r0 = rows[0];
+        const uint32_t* r1 = rows[1];
+        auto blend = [&](int x, int32_t u)
+            {
+                uint32_t a = r0[x], b = r1[x];
+                uint32_t s = isShaded(a) && isShaded(b) ? resampleLerp(a, b, fy) : (fy < 128 ? a : b);
+                dShade[x] = s;
+                if (!isShaded(s))
+                    dCell[x] = sCell[u >> 16];
+            };
+        int x = 0;
+        int32_t u = 0;
+
+#ifdef VECMATH_SSE2
+        const __m128i wB = _mm_set1_epi16((short)fy);
+        const __m128i wA = _mm_set1_epi16((short)(256 - fy));
+
+        // 4 cells per step, one at a time where a glyph cell is involved
+        for (; x + 4 <= W; x += 4, u += 4 * nStepX)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i*)(r0 + x));
+            __m128i b = _mm_loadu_si128((const __m128i*)(r1 + x));
+            if (_mm_movemask_epi8(resampleGlyphs4(a, b)) != 0)
+            {
+                for (int k = 0; k < 4; k++)
+                    blend(x + k, u + k * nStepX);
+                continue;
+            }
+            _mm_storeu_si128((__m128i*)(dShade + x), resampleLerp4(a, b, wA, wB, wA, wB));
+        }
+#endif
+
+        // scalar tail (and the whole row without SSE2)
+        for (; x < W; x++, u += nStepX)
+            blend(x, u);
+    }
+}
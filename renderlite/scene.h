@@ -0,0 +1,456 @@
+// scene.h : meshes stored once and drawn many times, as instances with their own transform.
+//
+// A Scene owns the meshes it is given and hands back a meshHandle for each. An instance
+// is a handle plus one model-to-world matrix, with rotation, scale and placement already
+// multiplied together, so 10,000 ships share one copy of the ship's geometry and cost a
+// matrix each.
+//
+// The renderer draws an instance by running its mesh's shared vertices through
+// transformVerts (SSE2 where available) and assembling the triangles from the corner
+// indices, so a vertex shared by six triangles is transformed once rather than six
+// times. Instances are taken in batches of up to SCENE_BATCH_TRIS triangles, which keeps
+// the per-stage buffers the same size however many instances there are. A packed mesh
+// (mesh::Pack) goes through transformPacked instead, which decodes its 16-bit positions
+// in the same pass.
+//
+// The scene also keeps every instance's world-space bounding box in a SceneBVH (see
+// bvh.h). Cull() hands back the instances whose boxes reach into the view, so the rest
+// never get as far as having their vertices transformed. A transform change refits the
+// tree at the next Cull, and adding or removing instances rebuilds it.
+//
+// Meshes and instances can be removed again (RemoveMesh, RemoveInstance). Their slots
+// are reused, so a scene that streams things in and out (see terrain.h) stays the size
+// of what it holds at any one time. ReplaceMesh swaps new geometry in under a handle
+// every instance of it keeps (see assetloader.h).
+//
+// A mesh can be given a chain of simplified versions of itself (SetLods, see lod.h).
+// SelectLods then picks, per instance in view, the coarsest whose simplification error
+// would cover no more than a given fraction of a cell on screen, and Drawn() says which
+// mesh to draw it with.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include "bvh.h"
+#include "lod.h"
+#include "mesh.h"
+#include "vecmath.h"
+
+typedef int meshHandle;
+
+// triangles of world-space geometry the pipeline holds at once (see olcEngine3D)
+static const size_t SCENE_BATCH_TRIS = 1 << 18;
+
+struct instance
+{
+    meshHandle hMesh;
+    mat4x4 matWorld;
+};
+
+class Scene
+{
+public:
+    meshHandle AddMesh(mesh m)
+    {
+        aabb box;
+        m.bounds(box.vMin, box.vMax);
+        return AddMesh(std::move(m), box);
+    }
+
+    // ... with its bounds already known, which spares walking every triangle
+    meshHandle AddMesh(mesh m, const aabb& box)
+    {
+        if (!vecFreeMeshes.empty())
+        {
+            meshHandle hMesh = vecFreeMeshes.back();
+            vecFreeMeshes.pop_back();
+            vecMeshBounds[hMesh] = box;
+            vecMeshes[hMesh] = std::move(m);
+            return hMesh;
+        }
+        vecMeshBounds.push_back(box);
+        vecMeshes.push_back(std::move(m));
+        vecLods.emplace_back();
+        return (meshHandle)vecMeshes.size() - 1;
+    }
+
+    // free hMesh's geometry and its levels of detail, for a later AddMesh to reuse the
+    // handles; no instance may still be drawing it
+    void RemoveMesh(meshHandle hMesh)
+    {
+        for (const lodRef& lr : vecLods[hMesh])
+            if (lr.hMesh != hMesh)
+                FreeMesh(lr.hMesh);
+        vecLods[hMesh].clear();
+        FreeMesh(hMesh);
+    }
+
+    // draw hMesh as levels[l] (l > 0) where that is close enough; levels[0] is hMesh
+    // itself and the errors must grow from level to level, as lodChain makes them.
+    // pBounds, if given, holds the bounds of each level
+    void SetLods(meshHandle hMesh, std::vector<lodLevel> levels, const aabb* pBounds = nullptr)
+    {
+        std::vector<lodRef> chain = { { hMesh, 0.0f } };
+        for (size_t l = 1; l < levels.size(); l++)
+        {
+            float fError = levels[l].fError;
+            chain.push_back({ pBounds != nullptr ? AddMesh(std::move(levels[l].m), pBounds[l]) : AddMesh(std::move(levels[l].m)), fError });
+        }
+        vecLods[hMesh] = std::move(chain);
+    }
+
+    // put levels (levels[0] the mesh, as lodChain makes them, with bounds pBounds if
+    // known) in hMesh's place for every instance drawing it, and move the geometry they
+    // replace, levels of detail and all, onto vecOld for the caller to free
+    void ReplaceMesh(meshHandle hMesh, std::vector<lodLevel> levels, const aabb* pBounds, std::vector<mesh>& vecOld)
+    {
+        for (const lodRef& lr : vecLods[hMesh])
+            if (lr.hMesh != hMesh)
+            {
+                vecOld.push_back(std::move(vecMeshes[lr.hMesh]));
+                FreeMesh(lr.hMesh);
+            }
+        vecLods[hMesh].clear();
+        vecOld.push_back(std::move(vecMeshes[hMesh]));
+        vecMeshes[hMesh] = std::move(levels[0].m);
+        if (pBounds != nullptr)
+            vecMeshBounds[hMesh] = pBounds[0];
+        else
+            vecMeshes[hMesh].bounds(vecMeshBounds[hMesh].vMin, vecMeshBounds[hMesh].vMax);
+        SetLods(hMesh, std::move(levels), pBounds);
+        for (size_t i = 0; i < vecInstances.size(); i++)
+            if (vecInstances[i].hMesh == hMesh)
+            {
+                vecBounds[i] = aabbTransform(vecMeshBounds[hMesh], vecInstances[i].matWorld);
+                vecLevel[i] = 0;
+            }
+        bBuild = true;
+    }
+
+    int AddInstance(meshHandle hMesh, const mat4x4& matWorld)
+    {
+        bBuild = true;
+        nLive++;
+        if (!vecFreeInstances.empty())
+        {
+            int i = vecFreeInstances.back();
+            vecFreeInstances.pop_back();
+            vecInstances[i] = { hMesh, matWorld };
+            vecBounds[i] = aabbTransform(vecMeshBounds[hMesh], matWorld);
+            vecLevel[i] = 0;
+            return i;
+        }
+        vecInstances.push_back({ hMesh, matWorld });
+        vecBounds.push_back(aabbTransform(vecMeshBounds[hMesh], matWorld));
+        vecLevel.push_back(0);
+        return (int)vecInstances.size() - 1;
+    }
+
+    // empty slot i, for a later AddInstance to reuse; the other instances keep their
+    // numbers. An empty slot has no mesh (hMesh -1) and Cull never returns it
+    void RemoveInstance(int i)
+    {
+        vecInstances[i].hMesh = -1;
+        vecBounds[i] = aabbEmpty();
+        vecFreeInstances.push_back(i);
+        nLive--;
+        bBuild = true;
+    }
+
+    void SetTransform(int i, const mat4x4& matWorld)
+    {
+        instance& inst = vecInstances[i];
+        if (memcmp(&inst.matWorld, &matWorld, sizeof(mat4x4)) == 0)
+            return;
+        inst.matWorld = matWorld;
+        vecBounds[i] = aabbTransform(vecMeshBounds[inst.hMesh], matWorld);
+        if (!bBuild)
+            bvh.Update(i, vecBounds[i]);
+    }
+
+    // room for nInstances instance slots, so adding and culling up to that many does
+    // not allocate
+    void Reserve(int nInstances)
+    {
+        vecInstances.reserve(nInstances);
+        vecBounds.reserve(nInstances);
+        vecLevel.reserve(nInstances);
+        vecFreeInstances.reserve(nInstances);
+        bvh.Reserve(nInstances);
+    }
+
+    // drop the instances, keeping the meshes
+    void ClearInstances()
+    {
+        vecInstances.clear();
+        vecBounds.clear();
+        vecLevel.clear();
+        vecFreeInstances.clear();
+        nLive = 0;
+        bBuild = true;
+    }
+
+    // append the instances whose bounds are not wholly outside the view to vecOut, in
+    // ascending order, given the renderer's view and projection matrices multiplied
+    // together and its near plane
+    template <typename V>
+    void Cull(const mat4x4& matViewProj, float fNear, V& vecOut)
+    {
+        if (bBuild || !bvh.Refit())
+        {
+            bvh.Build(vecBounds);
+            bBuild = false;
+            nBuilds++;
+        }
+        plane planes[FRUSTUM_PLANES];
+        frustumPlanes(matViewProj, fNear, planes);
+        size_t nFirst = vecOut.size();
+        bvh.Cull(planes, FRUSTUM_PLANES, vecOut, &nVisited);
+        // the pipeline works through them in this order, keep it the scene's
+        std::sort(vecOut.begin() + nFirst, vecOut.end());
+    }
+
+    // choose the level of detail of each instance in vecIn: the coarsest whose error,
+    // seen from the near side of the instance's bounds, spans at most fErrorCells cells.
+    // fCellsPerUnit is how many cells a unit at distance one spans. An instance moves to
+    // a coarser level only once it is within the threshold by the relative margin fBand,
+    // and back to a finer one once it is past it by as much, so one sitting right at the
+    // threshold does not flick between the two every frame
+    template <typename V>
+    void SelectLods(const mat4x4& matView, float fCellsPerUnit, float fErrorCells, float fBand, const V& vecIn)
+    {
+        nSwitches = 0;
+        for (int i : vecIn)
+        {
+            const std::vector<lodRef>& chain = vecLods[vecInstances[i].hMesh];
+            if (chain.size() <= 1)
+                continue;
+
+            // distance in front of the camera to the nearest point of the bounding sphere
+            const aabb& box = vecBounds[i];
+            float c[3] = { (box.vMin.x + box.vMax.x) * 0.5f, (box.vMin.y + box.vMax.y) * 0.5f, (box.vMin.z + box.vMax.z) * 0.5f };
+            float e[3] = { box.vMax.x - c[0], box.vMax.y - c[1], box.vMax.z - c[2] };
+            float fDist = c[0] * matView.m[0][2] + c[1] * matView.m[1][2] + c[2] * matView.m[2][2] + matView.m[3][2] -
+                sqrtf(e[0] * e[0] + e[1] * e[1] + e[2] * e[2]);
+
+            int nLevel = vecLevel[i];
+            int nNew = 0;
+            if (fDist > 0.0f)
+            {
+                // cells one unit of model-space error covers, allowing for scale
+                const float (*m)[4] = vecInstances[i].matWorld.m;
+                float fScale = 0.0f;
+                for (int r = 0; r < 3; r++)
+                    fScale = std::max(fScale, m[r][0] * m[r][0] + m[r][1] * m[r][1] + m[r][2] * m[r][2]);
+                float fCells = sqrtf(fScale) * fCellsPerUnit / fDist;
+
+                // coarsest level within the threshold, and within it by the margin
+                int nFit = 0, nFitBand = 0;
+                for (int l = 1; l < (int)chain.size(); l++)
+                {
+                    float f = chain[l].fError * fCells;
+                    if (f <= fErrorCells)
+                        nFit = l;
+                    if (f <= fErrorCells * (1.0f - fBand))
+                        nFitBand = l;
+                }
+                nNew = nLevel;
+                if (nFitBand > nLevel)
+                    nNew = nFitBand;
+                else if (chain[nLevel].fError * fCells > fErrorCells * (1.0f + fBand))
+                    nNew = nFit;
+            }
+            nSwitches += nNew != nLevel;
+            vecLevel[i] = nNew;
+        }
+    }
+
+    // the mesh to draw instance i with, at the level SelectLods last chose for it
+    meshHandle Drawn(int i) const
+    {
+        const std::vector<lodRef>& chain = vecLods[vecInstances[i].hMesh];
+        return chain.empty() ? vecInstances[i].hMesh : chain[vecLevel[i]].hMesh;
+    }
+
+    int Level(int i) const { return vecLevel[i]; }
+    // instances the last SelectLods moved to another level
+    int Switches() const { return nSwitches; }
+
+    const aabb& Bounds(int i) const { return vecBounds[i]; }
+    const SceneBVH& BVH() const { return bvh; }
+    // times the tree has been built, and nodes the last Cull visited
+    int Builds() const { return nBuilds; }
+    int Visited() const { return nVisited; }
+
+    mesh& Mesh(meshHandle hMesh) { return vecMeshes[hMesh]; }
+    const mesh& Mesh(meshHandle hMesh) const { return vecMeshes[hMesh]; }
+    const instance& Instance(int i) const { return vecInstances[i]; }
+    int Meshes() const { return (int)vecMeshes.size(); }
+    // instance slots, some possibly empty (see RemoveInstance), and the instances in them
+    int Instances() const { return (int)vecInstances.size(); }
+    int LiveInstances() const { return nLive; }
+
+    // triangles drawing every instance takes
+    size_t Triangles() const
+    {
+        size_t n = 0;
+        for (const instance& inst : vecInstances)
+            if (inst.hMesh >= 0)
+                n += vecMeshes[inst.hMesh].Triangles();
+        return n;
+    }
+
+    // most triangles and vertices any one mesh has, for sizing the buffers of a batch
+    size_t MaxTris() const
+    {
+        size_t n = 0;
+        for (const mesh& m : vecMeshes)
+            n = std::max(n, m.Triangles());
+        return n;
+    }
+
+    size_t MaxVerts() const
+    {
+        size_t n = 0;
+        for (const mesh& m : vecMeshes)
+            n = std::max(n, m.Vertices());
+        return n;
+    }
+
+    // memory held by the geometry of every mesh, levels of detail included
+    size_t Bytes() const
+    {
+        size_t n = 0;
+        for (const mesh& m : vecMeshes)
+            n += m.Bytes();
+        return n;
+    }
+
+private:
+    struct lodRef
+    {
+        meshHandle hMesh;
+        float fError;
+    };
+
+    std::vector<mesh> vecMeshes;
+    // each mesh's levels of detail, none if it has no chain
+    std::vector<std::vector<lodRef>> vecLods;
+    // each mesh's bounds in model space, and each instance's in world space
+    std::vector<aabb> vecMeshBounds;
+    std::vector<instance> vecInstances;
+    std::vector<aabb> vecBounds;
+    // slots RemoveMesh and RemoveInstance freed
+    std::vector<meshHandle> vecFreeMeshes;
+    std::vector<int> vecFreeInstances;
+    int nLive = 0;
+    // each instance's level of detail
+    std::vector<int> vecLevel;
+    SceneBVH bvh;
+    bool bBuild = false;
+    int nBuilds = 0;
+    int nVisited = 0;
+    int nSwitches = 0;
+
+    void FreeMesh(meshHandle hMesh)
+    {
+        // assigning an empty mesh gives the memory back, clear() would keep it
+        vecMeshes[hMesh] = mesh();
+        vecFreeMeshes.push_back(hMesh);
+    }
+};
+
+// pOut[i] = pIn[i] * m for n points taken as row vectors, like matvecMult (vecmath.h).
+// Both paths weight the rows of m by x, y, z and w and add them in that order, so they
+// give the same bits
+inline void transformVerts(const mat4x4& m, const vec3d* pIn, vec3d* pOut, size_t n)
+{
+    size_t i = 0;
+#ifdef VECMATH_SSE2
+    __m128 r0 = _mm_loadu_ps(m.m[0]);
+    __m128 r1 = _mm_loadu_ps(m.m[1]);
+    __m128 r2 = _mm_loadu_ps(m.m[2]);
+    __m128 r3 = _mm_loadu_ps(m.m[3]);
+    for (; i < n; i++)
+    {
+        __m128 v = _mm_loadu_ps(&pIn[i].x);
+        __m128 x = _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0));
+        __m128 y = _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1));
+        __m128 z = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2));
+        __m128 w = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+        __m128 r = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, r0), _mm_mul_ps(y, r1)), _mm_mul_ps(z, r2)), _mm_mul_ps(w, r3));
+        _mm_storeu_ps(&pOut[i].x, r);
+    }
+#endif
+    for (; i < n; i++)
+    {
+        const vec3d& p = pIn[i];
+        vec3d& v = pOut[i];
+        v.x = p.x * m.m[0][0] + p.y * m.m[1][0] + p.z * m.m[2][0] + p.w * m.m[3][0];
+        v.y = p.x * m.m[0][1] + p.y * m.m[1][1] + p.z * m.m[2][1] + p.w * m.m[3][1];
+        v.z = p.x * m.m[0][2] + p.y * m.m[1][2] + p.z * m.m[2][2] + p.w * m.m[3][2];
+        v.w = p.x * m.m[0][3] + p.y * m.m[1][3] + p.z * m.m[2][3] + p.w * m.m[3][3];
+    }
+}
+
+// the same for a packed mesh's positions (see mesh::Pack), decoded on the way: the
+// steps and origin the positions were packed with are folded into m first, so each
+// vertex costs its conversion from integers and one matrix multiply, as above
+inline void transformPacked(const mat4x4& m, const packedMesh& pm, vec3d* pOut)
+{
+    // rows x, y and z scaled by the step along each, and the origin moved into row w
+    mat4x4 md;
+    const float fStep[3] = { pm.vStep.x, pm.vStep.y, pm.vStep.z };
+    const float fOrigin[3] = { pm.vOrigin.x, pm.vOrigin.y, pm.vOrigin.z };
+    for (int c = 0; c < 4; c++)
+    {
+        for (int r = 0; r < 3; r++)
+            md.m[r][c] = m.m[r][c] * fStep[r];
+        md.m[3][c] = fOrigin[0] * m.m[0][c] + fOrigin[1] * m.m[1][c] + fOrigin[2] * m.m[2][c] + m.m[3][c];
+    }
+
+    const uint16_t* pIn = pm.pos.data();
+    size_t i = 0, n = pm.nVerts;
+#ifdef VECMATH_SSE2
+    __m128 r0 = _mm_loadu_ps(md.m[0]);
+    __m128 r1 = _mm_loadu_ps(md.m[1]);
+    __m128 r2 = _mm_loadu_ps(md.m[2]);
+    __m128 r3 = _mm_loadu_ps(md.m[3]);
+    __m128i zero = _mm_setzero_si128();
+    for (; i < n; i++)
+    {
+        // x, y, z and the next vertex's x (or the spare entry), widened to floats
+        __m128 v = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(pIn + i * 3)), zero));
+        __m128 x = _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0));
+        __m128 y = _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1));
+        __m128 z = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2));
+        __m128 r = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, r0), _mm_mul_ps(y, r1)), _mm_mul_ps(z, r2)), r3);
+        _mm_storeu_ps(&pOut[i].x, r);
+    }
+#endif
+    for (; i < n; i++)
+    {
+        float x = pIn[i * 3], y = pIn[i * 3 + 1], z = pIn[i * 3 + 2];
+        vec3d& v = pOut[i];
+        v.x = x * md.m[0][0] + y * md.m[1][0] + z * md.m[2][0] + md.m[3][0];
+        v.y = x * md.m[0][1] + y * md.m[1][1] + z * md.m[2][1] + md.m[3][1];
+        v.z = x * md.m[0][2] + y * md.m[1][2] + z * md.m[2][2] + md.m[3][2];
+        v.w = x * md.m[0][3] + y * md.m[1][3] + z * md.m[2][3] + md.m[3][3];
+    }
+}
+
+// triangles from nCorners corner indices into transformed vertices pVerts, any width
+template <typename T>
+inline triangle* assembleTris(const vec3d* pVerts, const T* pIdx, size_t nCorners, triangle* pOut)
+{
+    for (size_t c = 0; c < nCorners; c += 3, pOut++)
+    {
+        pOut->p[0] = pVerts[pIdx[c]];
+        pOut->p[1] = pVerts[pIdx[c + 1]];
+        pOut->p[2] = pVerts[pIdx[c + 2]];
+    }
+    return pOut;
+}
@@ -0,0 +1,336 @@
+// shmframe.h : publishes finished frames into a POSIX shared-memory ring buffer.
+//
+// Layout of the shared object (all offsets 64-byte aligned):
+//
+//   shmRingHeader                      magic, version, geometry, newest frame number
+//   slot 0: shmSlotHeader + pixels     pixels are nMaxWidth * nMaxHeight * 4 bytes
+//   slot 1: ...
+//
+// The writer (the renderer) fills slot (frame % nSlots) and never waits on readers.
+// Each slot is guarded by a seqlock: the counter is odd while the slot is being
+// written and even once it is complete. A reader samples the counter, reads the pixels
+// straight out of the mapping, and then re-checks the counter; if it moved, the writer
+// lapped the reader and whatever it read must be thrown away. Slow readers therefore
+// drop frames instead of stalling rendering.
+//
+// The reader trusts nothing in the header it has not checked against the size of the
+// object: a ring with no slots, or with geometry or slots that run past the end of the
+// mapping, is refused by Open, and reads only use the checked copy.
+//
+// POSIX only (shm_open/mmap). Link with -lrt on older glibc.
+
+#pragma once
+
+#ifndef _WIN32
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "olcConsoleGameEngine.h"
+
+static const uint32_t SHM_FRAME_MAGIC = 0x464C5252; // "RRLF"
+static const uint32_t SHM_FRAME_VERSION = 1;
+
+enum SHM_FRAME_FORMAT
+{
+    // raw console cells (CHAR_INFO, 4 bytes: glyph then attributes)
+    SHM_FORMAT_CELLS = 0,
+    // displayed colour per cell, 8-bit r, g, b, x
+    SHM_FORMAT_RGBX = 1,
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "seqlock needs lock-free 64-bit atomics");
+
+struct alignas(64) shmRingHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nSlots;
+    uint32_t nSlotBytes;
+    uint32_t nMaxWidth;
+    uint32_t nMaxHeight;
+    // frame number + 1 of the newest complete frame (0 = nothing published yet)
+    std::atomic<uint64_t> nLatest;
+};
+
+struct alignas(64) shmSlotHeader
+{
+    // seqlock counter, odd while the slot is being written
+    std::atomic<uint64_t> nSeq;
+    uint64_t nFrame;
+    uint64_t nTimeNs;
+    uint32_t nWidth;
+    uint32_t nHeight;
+    uint32_t nFormat;
+    uint32_t nBytes;
+};
+
+// a slot header as the reader checked it: the copy fn gets, so the sizes it works with
+// cannot change under it while the writer rewrites the slot
+struct shmFrameInfo
+{
+    uint64_t nFrame;
+    uint64_t nTimeNs;
+    uint32_t nWidth;
+    uint32_t nHeight;
+    uint32_t nFormat;
+    uint32_t nBytes;
+};
+
+inline size_t shmSlotStride(uint32_t nMaxWidth, uint32_t nMaxHeight)
+{
+    size_t bytes = sizeof(shmSlotHeader) + (size_t)nMaxWidth * nMaxHeight * 4;
+    return (bytes + 63) & ~(size_t)63;
+}
+
+inline shmSlotHeader* shmSlot(shmRingHeader* ring, uint32_t i)
+{
+    return (shmSlotHeader*)((uint8_t*)ring + sizeof(shmRingHeader) + (size_t)i * ring->nSlotBytes);
+}
+
+inline uint8_t* shmSlotPixels(shmSlotHeader* slot)
+{
+    return (uint8_t*)slot + sizeof(shmSlotHeader);
+}
+
+
+// Renderer side: an olcFrameOutput that copies each frame into the next ring slot
+class ShmFrameWriter : public olcFrameOutput
+{
+public:
+    ~ShmFrameWriter()
+    {
+        Close();
+    }
+
+    // create (or replace) the shared object 'name' (e.g. "/renderlite")
+    bool Create(const char* name, int maxWidth, int maxHeight, SHM_FRAME_FORMAT format = SHM_FORMAT_RGBX, int nSlots = 4)
+    {
+        Close();
+
+        sName = name;
+        nFormat = format;
+        nMapBytes = sizeof(shmRingHeader) + nSlots * shmSlotStride(maxWidth, maxHeight);
+
+        shm_unlink(name);
+        int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+        if (fd < 0)
+            return false;
+        if (ftruncate(fd, nMapBytes) != 0)
+        {
+            ::close(fd);
+            shm_unlink(name);
+            return false;
+        }
+
+        void* p = mmap(nullptr, nMapBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+        {
+            shm_unlink(name);
+            return false;
+        }
+
+        // ftruncate zero-fills, so every seqlock starts even and nLatest at 0
+        ring = (shmRingHeader*)p;
+        ring->version = SHM_FRAME_VERSION;
+        ring->nSlots = nSlots;
+        ring->nSlotBytes = (uint32_t)shmSlotStride(maxWidth, maxHeight);
+        ring->nMaxWidth = maxWidth;
+        ring->nMaxHeight = maxHeight;
+        // magic last, readers check it before trusting the rest of the header
+        std::atomic_thread_fence(std::memory_order_release);
+        ring->magic = SHM_FRAME_MAGIC;
+        return true;
+    }
+
+    void Close()
+    {
+        if (ring == nullptr)
+            return;
+        munmap(ring, nMapBytes);
+        shm_unlink(sName.c_str());
+        ring = nullptr;
+    }
+
+    void OnFrame(const olcFrame& frame) override
+    {
+        if (ring == nullptr || frame.nWidth > (int)ring->nMaxWidth || frame.nHeight > (int)ring->nMaxHeight)
+            return;
+
+        shmSlotHeader* slot = shmSlot(ring, (uint32_t)(frame.nFrame % ring->nSlots));
+        uint64_t seq = slot->nSeq.load(std::memory_order_relaxed);
+
+        // open the slot (odd) before touching the payload
+        slot->nSeq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        int nCells = frame.nWidth * frame.nHeight;
+        slot->nFrame = frame.nFrame;
+        slot->nTimeNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        slot->nWidth = frame.nWidth;
+        slot->nHeight = frame.nHeight;
+        slot->nFormat = nFormat;
+        slot->nBytes = nCells * 4;
+
+        if (nFormat == SHM_FORMAT_CELLS)
+        {
+            memcpy(shmSlotPixels(slot), frame.pCells, (size_t)nCells * 4);
+        }
+        else
+        {
+            uint32_t* out = (uint32_t*)shmSlotPixels(slot);
+            for (int i = 0; i < nCells; i++)
+                out[i] = frame.CellRGB(i);
+        }
+
+        // close the slot (even) and advertise it
+        slot->nSeq.store(seq + 2, std::memory_order_release);
+        ring->nLatest.store(frame.nFrame + 1, std::memory_order_release);
+    }
+
+private:
+    shmRingHeader* ring = nullptr;
+    size_t nMapBytes = 0;
+    std::string sName;
+    SHM_FRAME_FORMAT nFormat = SHM_FORMAT_RGBX;
+};
+
+
+// Viewer side: maps the ring read-only and reads frames in place
+class ShmFrameReader
+{
+public:
+    ~ShmFrameReader()
+    {
+        Close();
+    }
+
+    bool Open(const char* name)
+    {
+        Close();
+
+        int fd = shm_open(name, O_RDONLY, 0);
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(shmRingHeader))
+        {
+            ::close(fd);
+            return false;
+        }
+
+        nMapBytes = (size_t)st.st_size;
+        void* p = mmap(nullptr, nMapBytes, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+            return false;
+
+        ring = (shmRingHeader*)p;
+        if (ring->magic != SHM_FRAME_MAGIC || ring->version != SHM_FRAME_VERSION)
+        {
+            Close();
+            return false;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        // the geometry is copied once, so a writer rewriting the header later cannot
+        // move reads outside the mapping (or make nSlots 0 under the modulo)
+        nSlots = ring->nSlots;
+        nSlotBytes = ring->nSlotBytes;
+        nMaxWidth = ring->nMaxWidth;
+        nMaxHeight = ring->nMaxHeight;
+        if (!Fits())
+        {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close()
+    {
+        if (ring == nullptr)
+            return;
+        munmap(ring, nMapBytes);
+        ring = nullptr;
+    }
+
+    // frame number + 1 of the newest published frame (0 = none yet)
+    uint64_t Latest() const
+    {
+        return ring->nLatest.load(std::memory_order_acquire);
+    }
+
+    // Call fn(info, pixels) on frame 'nFrame' without copying it out of the ring. info is
+    // a checked copy of the slot header, nBytes of pixels always lie inside the slot.
+    // Returns false if the frame is not (or no longer) in the ring, or if the writer
+    // overwrote it while fn was running; in that case anything fn derived is garbage.
+    template <typename F>
+    bool Read(uint64_t nFrame, F&& fn) const
+    {
+        shmSlotHeader* slot = (shmSlotHeader*)((uint8_t*)ring + sizeof(shmRingHeader) + (size_t)(nFrame % nSlots) * nSlotBytes);
+
+        uint64_t seq0 = slot->nSeq.load(std::memory_order_acquire);
+        if (seq0 & 1)
+            return false;
+        shmFrameInfo info = { slot->nFrame, slot->nTimeNs, slot->nWidth, slot->nHeight, slot->nFormat, slot->nBytes };
+        if (info.nFrame != nFrame)
+            return false;
+        // a frame larger than a slot holds, or whose size disagrees with its geometry,
+        // is not one this writer could have published
+        if (info.nWidth > nMaxWidth || info.nHeight > nMaxHeight || info.nBytes != (size_t)info.nWidth * info.nHeight * 4)
+            return false;
+
+        fn((const shmFrameInfo&)info, (const uint8_t*)shmSlotPixels(slot));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot->nSeq.load(std::memory_order_relaxed) == seq0;
+    }
+
+    // Read the newest complete frame, see Read()
+    template <typename F>
+    bool ReadLatest(F&& fn) const
+    {
+        uint64_t latest = Latest();
+        if (latest == 0)
+            return false;
+        return Read(latest - 1, fn);
+    }
+
+    const shmRingHeader* Header() const
+    {
+        return ring;
+    }
+
+private:
+    shmRingHeader* ring = nullptr;
+    size_t nMapBytes = 0;
+    uint32_t nSlots = 0;
+    uint32_t nSlotBytes = 0;
+    uint32_t nMaxWidth = 0;
+    uint32_t nMaxHeight = 0;
+
+    // whether the copied geometry describes a ring that lies inside the mapping
+    bool Fits() const
+    {
+        if (nSlots == 0 || nMaxWidth == 0 || nMaxHeight == 0)
+            return false;
+        // 16-bit dimensions keep the sizes below far from overflowing
+        if (nMaxWidth > 0xFFFF || nMaxHeight > 0xFFFF)
+            return false;
+        if (nSlotBytes % 64 != 0 || nSlotBytes < shmSlotStride(nMaxWidth, nMaxHeight))
+            return false;
+        return (nMapBytes - sizeof(shmRingHeader)) / nSlotBytes >= nSlots;
+    }
+};
+
+#endif
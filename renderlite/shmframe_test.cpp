@@ -0,0 +1,242 @@
+// shmframe_test.cpp : stress test of the shared-memory frame ring (see shmframe.h).
+//
+// A writer thread publishes frames through ShmFrameWriter as fast as it can while the
+// main thread follows the ring with ShmFrameReader, the way shmviewer does. Every cell
+// of frame n holds a value derived from n and the cell's index, so the reader can check
+// each frame it reads in place: a frame the seqlock accepted whose cells do not all
+// belong to it is a torn read that got through, and fails the test. Reads the seqlock
+// rejects are expected (the writer laps the reader) and only counted. Both sides report
+// their throughput in MB/s.
+//
+// Before that, Open is handed rings whose headers do not fit their objects (no slots,
+// slots or geometry past the end of the mapping) and must refuse every one.
+//
+//   g++ -std=c++17 -O2 shmframe_test.cpp -o shmframe_test -lpthread -lrt
+//
+//   shmframe_test [--seconds S] [--size WxH] [--slots N]
+//
+// The exit code is 1 if any check failed.
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <thread>
+#include "shmframe.h"
+
+static uint32_t cellValue(uint64_t nFrame, uint32_t i)
+{
+    return (uint32_t)(nFrame * 2654435761u) ^ (i * 40503u);
+}
+
+// a ring object whose header says what the caller wants, nBytes long in total (left
+// zeroed if that is too short for a header)
+static bool makeRing(const char* name, size_t nBytes, uint32_t nSlots, uint32_t nSlotBytes, uint32_t w, uint32_t h)
+{
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0)
+        return false;
+    if (ftruncate(fd, nBytes) != 0 || nBytes < sizeof(shmRingHeader))
+    {
+        ::close(fd);
+        return nBytes < sizeof(shmRingHeader);
+    }
+    void* p = mmap(nullptr, nBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+        return false;
+
+    shmRingHeader* ring = (shmRingHeader*)p;
+    ring->magic = SHM_FRAME_MAGIC;
+    ring->version = SHM_FRAME_VERSION;
+    ring->nSlots = nSlots;
+    ring->nSlotBytes = nSlotBytes;
+    ring->nMaxWidth = w;
+    ring->nMaxHeight = h;
+    munmap(p, nBytes);
+    return true;
+}
+
+static int testHeaders(const char* name)
+{
+    struct
+    {
+        const char* sWhat;
+        uint32_t nSlots;
+        uint32_t nSlotBytes;
+        uint32_t nWidth;
+        uint32_t nHeight;
+        bool bValid;
+    } cases[] =
+    {
+        { "well formed", 4, (uint32_t)shmSlotStride(64, 32), 64, 32, true },
+        { "no slots", 0, (uint32_t)shmSlotStride(64, 32), 64, 32, false },
+        { "more slots than fit", 5, (uint32_t)shmSlotStride(64, 32), 64, 32, false },
+        { "slots larger than fit", 4, (uint32_t)shmSlotStride(64, 32) * 2, 64, 32, false },
+        { "slots smaller than the geometry", 4, (uint32_t)shmSlotStride(64, 32), 128, 32, false },
+        { "unaligned slots", 4, (uint32_t)shmSlotStride(64, 32) - 8, 64, 32, false },
+        { "no width", 4, (uint32_t)shmSlotStride(64, 32), 0, 32, false },
+        { "huge geometry", 4, 64, 0x10000, 0x10000, false },
+    };
+
+    // every case is mapped the size of the well formed ring
+    size_t nBytes = sizeof(shmRingHeader) + 4 * shmSlotStride(64, 32);
+    int nFailed = 0;
+    for (auto& c : cases)
+    {
+        if (!makeRing(name, nBytes, c.nSlots, c.nSlotBytes, c.nWidth, c.nHeight))
+        {
+            printf("headers: cannot create %s\n", name);
+            return 1;
+        }
+        ShmFrameReader reader;
+        bool bOpened = reader.Open(name);
+        if (bOpened != c.bValid)
+        {
+            printf("FAIL  headers: %s %s\n", c.sWhat, bOpened ? "opened" : "refused");
+            nFailed++;
+        }
+    }
+
+    // too short for even the ring header
+    ShmFrameReader reader;
+    if (!makeRing(name, sizeof(shmRingHeader) / 2, 0, 0, 0, 0) || reader.Open(name))
+    {
+        printf("FAIL  headers: truncated header opened\n");
+        nFailed++;
+    }
+
+    shm_unlink(name);
+    printf("headers: %d of %zu bad rings opened\n", nFailed, sizeof(cases) / sizeof(cases[0]) + 1);
+    return nFailed;
+}
+
+static int testStress(const char* name, double fSeconds, int nWidth, int nHeight, int nSlots)
+{
+    ShmFrameWriter writer;
+    if (!writer.Create(name, nWidth, nHeight, SHM_FORMAT_CELLS, nSlots))
+    {
+        printf("stress: cannot create %s\n", name);
+        return 1;
+    }
+    ShmFrameReader reader;
+    if (!reader.Open(name))
+    {
+        printf("stress: cannot open %s\n", name);
+        return 1;
+    }
+
+    int nCells = nWidth * nHeight;
+    std::atomic<bool> bWriting{ true };
+    uint64_t nWritten = 0;
+    double fWriteSeconds = 0.0;
+
+    std::thread thread([&]
+        {
+            std::vector<uint32_t> cells(nCells);
+            olcFrame frame;
+            frame.nWidth = nWidth;
+            frame.nHeight = nHeight;
+            frame.pCells = (const CHAR_INFO*)cells.data();
+
+            auto t0 = std::chrono::steady_clock::now();
+            while (bWriting.load(std::memory_order_relaxed))
+            {
+                for (int i = 0; i < nCells; i++)
+                    cells[i] = cellValue(nWritten, i);
+                frame.nFrame = nWritten++;
+                writer.OnFrame(frame);
+            }
+            fWriteSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        });
+
+    uint64_t nNext = 0, nRead = 0, nSkipped = 0, nRejected = 0, nTorn = 0, nBytes = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    double fElapsed = 0.0;
+    while (fElapsed < fSeconds)
+    {
+        fElapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+        uint64_t latest = reader.Latest();
+        if (latest == 0 || latest - 1 < nNext)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        uint64_t nFrame = latest - 1;
+        if (nNext > 0 && nFrame > nNext)
+            nSkipped += nFrame - nNext;
+        nNext = nFrame + 1;
+
+        bool bIntact = true;
+        uint32_t nFrameBytes = 0;
+        bool ok = reader.Read(nFrame, [&](const shmFrameInfo& info, const uint8_t* pixels)
+            {
+                nFrameBytes = info.nBytes;
+                if (info.nWidth != (uint32_t)nWidth || info.nHeight != (uint32_t)nHeight || info.nBytes != (uint32_t)nCells * 4)
+                {
+                    bIntact = false;
+                    return;
+                }
+                const uint32_t* p = (const uint32_t*)pixels;
+                for (int i = 0; i < nCells; i++)
+                    if (p[i] != cellValue(nFrame, i))
+                    {
+                        bIntact = false;
+                        return;
+                    }
+            });
+
+        if (!ok)
+        {
+            nRejected++;
+            continue;
+        }
+        if (!bIntact)
+            nTorn++;
+        nRead++;
+        nBytes += nFrameBytes;
+    }
+
+    bWriting.store(false, std::memory_order_relaxed);
+    thread.join();
+
+    double fFrameMB = nCells * 4 / 1e6;
+    printf("stress: %dx%d, %d slots, %.1f s\n", nWidth, nHeight, nSlots, fElapsed);
+    printf("  writer  %llu frames  %.1f MB/s\n", (unsigned long long)nWritten, fWriteSeconds > 0.0 ? nWritten * fFrameMB / fWriteSeconds : 0.0);
+    printf("  reader  %llu frames  %.1f MB/s  skipped %llu  rejected %llu  torn %llu\n", (unsigned long long)nRead,
+        nBytes / fElapsed / 1e6, (unsigned long long)nSkipped, (unsigned long long)nRejected, (unsigned long long)nTorn);
+
+    if (nTorn > 0)
+        printf("FAIL  stress: %llu torn frames passed the seqlock\n", (unsigned long long)nTorn);
+    if (nRead == 0)
+        printf("FAIL  stress: nothing read\n");
+    return nTorn > 0 || nRead == 0 ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+    double fSeconds = 2.0;
+    int nWidth = 256, nHeight = 240, nSlots = 4;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) fSeconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) sscanf(argv[++i], "%dx%d", &nWidth, &nHeight);
+        else if (strcmp(argv[i], "--slots") == 0 && i + 1 < argc) nSlots = atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: %s [--seconds S] [--size WxH] [--slots N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "/renderlite_test_%d", (int)getpid());
+
+    int nFailed = testHeaders(name);
+    nFailed += testStress(name, fSeconds, nWidth, nHeight, nSlots);
+    printf("shmframe_test: %s\n", nFailed ? "FAILED" : "passed");
+    return nFailed ? 1 : 0;
+}
@@ -0,0 +1,135 @@
+// shmviewer.cpp : reference reader for the shared-memory frame ring (see shmframe.h).
+//
+// Maps the ring published by renderlite (shm_export) and follows it, reading every new
+// frame in place. Once a second it prints how many frames were read, skipped (the
+// reader fell behind) or torn (overwritten mid-read), plus the read throughput.
+//
+//   shmviewer [name] [--frames N] [--dump out.ppm]
+//
+// --frames stops after N frames have been read, --dump writes the last good frame as a
+// binary PPM (RGBX rings only).
+
+#include <cstdio>
+#include <cstdlib>
+#include <csignal>
+#include <vector>
+#include <thread>
+#include "shmframe.h"
+
+static volatile sig_atomic_t bRunning = 1;
+
+static void onSignal(int)
+{
+    bRunning = 0;
+}
+
+int main(int argc, char** argv)
+{
+    const char* name = "/renderlite";
+    const char* dump = nullptr;
+    uint64_t nStopAfter = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) nStopAfter = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc) dump = argv[++i];
+        else name = argv[i];
+    }
+
+    signal(SIGINT, onSignal);
+
+    ShmFrameReader reader;
+    while (bRunning && !reader.Open(name))
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    if (!bRunning)
+        return 1;
+
+    printf("%s: %u slots, up to %ux%u\n", name, reader.Header()->nSlots, reader.Header()->nMaxWidth, reader.Header()->nMaxHeight);
+
+    uint64_t nNext = 0, nRead = 0, nSkipped = 0, nTorn = 0, nBytes = 0;
+    uint64_t nReadTotal = 0;
+    uint32_t checksum = 0;
+    // the last good frame for --dump, and the one being read into until it proves good
+    std::vector<uint8_t> last, scratch;
+    uint32_t lastW = 0, lastH = 0, lastFormat = 0;
+    auto tReport = std::chrono::steady_clock::now();
+    double fBusy = 0.0;
+
+    while (bRunning && (nStopAfter == 0 || nReadTotal < nStopAfter))
+    {
+        uint64_t latest = reader.Latest();
+        if (latest == 0 || latest - 1 < nNext)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // always follow the newest frame, anything published in between is skipped
+        uint64_t nFrame = latest - 1;
+        if (nNext > 0 && nFrame > nNext)
+            nSkipped += nFrame - nNext;
+        nNext = nFrame + 1;
+
+        auto t0 = std::chrono::steady_clock::now();
+        uint32_t sum = 0;
+        uint32_t w = 0, h = 0, format = 0, bytes = 0;
+        bool ok = reader.Read(nFrame, [&](const shmFrameInfo& info, const uint8_t* pixels)
+            {
+                // touch every byte in place, standing in for real viewer work. info is
+                // Read's checked copy, so bytes is w * h * 4 and inside the slot
+                w = info.nWidth; h = info.nHeight; format = info.nFormat; bytes = info.nBytes;
+                const uint32_t* p = (const uint32_t*)pixels;
+                for (uint32_t i = 0; i < bytes / 4; i++)
+                    sum += p[i];
+                if (dump != nullptr)
+                    scratch.assign(pixels, pixels + bytes);
+            });
+        fBusy += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+        if (!ok)
+        {
+            nTorn++;
+            continue;
+        }
+
+        checksum ^= sum;
+        nRead++;
+        nReadTotal++;
+        nBytes += bytes;
+        // only a frame the seqlock vouched for replaces the one to dump, with its size
+        if (dump != nullptr)
+        {
+            last.swap(scratch);
+            lastW = w; lastH = h; lastFormat = format;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        double dt = std::chrono::duration<double>(now - tReport).count();
+        if (dt >= 1.0)
+        {
+            printf("frame %llu  read %.1f/s  skipped %llu  torn %llu  %.1f MB/s (%.3f ms/frame in place)\n",
+                (unsigned long long)nFrame, nRead / dt, (unsigned long long)nSkipped, (unsigned long long)nTorn,
+                nBytes / dt / 1e6, nRead ? fBusy * 1000.0 / nRead : 0.0);
+            fflush(stdout);
+            nRead = nSkipped = nTorn = nBytes = 0;
+            fBusy = 0.0;
+            tReport = now;
+        }
+    }
+
+    printf("read %llu frames, checksum %08x\n", (unsigned long long)nReadTotal, checksum);
+
+    if (dump != nullptr && !last.empty() && lastFormat == SHM_FORMAT_RGBX)
+    {
+        FILE* f = fopen(dump, "wb");
+        if (f != nullptr)
+        {
+            fprintf(f, "P6\n%u %u\n255\n", lastW, lastH);
+            for (uint32_t i = 0; i < lastW * lastH; i++)
+                fwrite(&last[i * 4], 1, 3, f);
+            fclose(f);
+        }
+    }
+
+    return 0;
+}
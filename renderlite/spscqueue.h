@@ -0,0 +1,57 @@
+// spscqueue.h : bounded lock-free queue between exactly one producer and one consumer
+// thread (input thread -> game thread, profiled thread -> game thread).
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded single-producer / single-consumer ring. Push() is only ever called by one
+// thread and Pop() by one other; neither blocks. Each side keeps a private copy of the
+// other side's index and only re-reads the shared one when the copy says full / empty,
+// so the two cache lines are not bounced on every event.
+template <typename T, size_t N>
+class SpscQueue
+{
+    static_assert((N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+public:
+    // false if the queue is full, the item is dropped
+    bool Push(const T& item)
+    {
+        size_t head = nHead.load(std::memory_order_relaxed);
+        if (head - nTailCache == N)
+        {
+            nTailCache = nTail.load(std::memory_order_acquire);
+            if (head - nTailCache == N)
+                return false;
+        }
+        items[head & (N - 1)] = item;
+        nHead.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // false if the queue is empty
+    bool Pop(T& item)
+    {
+        size_t tail = nTail.load(std::memory_order_relaxed);
+        if (tail == nHeadCache)
+        {
+            nHeadCache = nHead.load(std::memory_order_acquire);
+            if (tail == nHeadCache)
+                return false;
+        }
+        item = items[tail & (N - 1)];
+        nTail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // producer side
+    alignas(64) std::atomic<size_t> nHead{ 0 };
+    size_t nTailCache = 0;
+    // consumer side
+    alignas(64) std::atomic<size_t> nTail{ 0 };
+    size_t nHeadCache = 0;
+    alignas(64) T items[N];
+};
@@ -0,0 +1,530 @@
+// terrain.h : terrain too large to hold at once, streamed in chunk by chunk around the camera.
+//
+// A TerrainSource divides the ground into a grid of square chunks and builds the geometry
+// of any one of them on request:
+//   HeightfieldTerrain  samples a height function on an even grid. The synthetic one
+//                       here is fractal value noise, so a world thousands of chunks
+//                       across costs nothing until part of it is looked at
+//   ObjTerrain          an OBJ terrain (mountains.obj) with its triangles sorted into
+//                       chunks by their centres
+//
+// TerrainStreamer keeps the chunks around the camera in a Scene, one instance each, so
+// they are culled and given a level of detail like anything else. Update() runs on the
+// game thread once a frame: it adds the chunks the streaming thread has finished, drops
+// the ones now out of range, and gives the thread the list of chunks still missing,
+// those toward where the camera is looking first. The thread builds each chunk's mesh
+// and LOD chain (see lod.h) with the chunk's rim locked, so every level meets its
+// neighbours along the same edge, and two chunks drawn at different levels leave no crack.
+// Every level is then put in vertex-cache order (see vcache.h) unless bReorder is off,
+// and packed (mesh::Pack) if bPack is on.
+//
+// Only chunks within fRadius of the camera, or of a point fLookAhead along the view, are
+// kept, and never more than nMaxChunks, so the memory held stays the same however large
+// the world is.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "lod.h"
+#include "scene.h"
+#include "vcache.h"
+
+class TerrainSource
+{
+public:
+    virtual ~TerrainSource() = default;
+
+    // nChunksX x nChunksZ chunks fChunkSize on a side, chunk (0, 0) starting at
+    // (fOriginX, fOriginZ) and chunk x running along +x
+    int nChunksX = 0;
+    int nChunksZ = 0;
+    float fChunkSize = 16.0f;
+    float fOriginX = 0.0f;
+    float fOriginZ = 0.0f;
+
+    // the geometry of chunk (cx, cz) in world space. Called on the streaming thread, so
+    // it must leave the source as it is
+    virtual mesh Build(int cx, int cz) const = 0;
+};
+
+// a heightfield world of nChunks x nChunks chunks, centred on x = z = 0. The height is
+// fractal value noise scaled to fAmplitude and kept fClearance below y = 0, so a camera
+// at the origin starts out clear of the highest peak
+class HeightfieldTerrain : public TerrainSource
+{
+public:
+    HeightfieldTerrain(int nChunks, float fChunkSize, int nCells, uint32_t nSeed = 1,
+        float fAmplitude = 40.0f, float fClearance = 10.0f)
+        : nCells(std::max(nCells, 1)), nSeed(nSeed), fAmplitude(fAmplitude), fClearance(fClearance)
+    {
+        nChunksX = nChunksZ = nChunks;
+        this->fChunkSize = fChunkSize;
+        fOriginX = fOriginZ = -0.5f * nChunks * fChunkSize;
+    }
+
+    float Height(float x, float z) const
+    {
+        // octaves from 256 units across down to 8
+        float f = 0.0f, fWeight = 0.0f, fAmp = 1.0f, fFreq = 1.0f / 256.0f;
+        for (int o = 0; o < 6; o++)
+        {
+            f += fAmp * Noise(x * fFreq, z * fFreq, nSeed + o * 1013);
+            fWeight += fAmp;
+            fAmp *= 0.5f;
+            fFreq *= 2.0f;
+        }
+        f /= fWeight;
+        // squared, for broad valleys and sharp peaks
+        return -fClearance - fAmplitude * (1.0f - f * f);
+    }
+
+    mesh Build(int cx, int cz) const override
+    {
+        mesh m;
+        float fStep = fChunkSize / nCells;
+        int nSide = nCells + 1;
+        m.verts.reserve((size_t)nSide * nSide);
+        for (int i = 0; i <= nCells; i++)
+            for (int j = 0; j <= nCells; j++)
+            {
+                // from the world grid index, so both neighbours get the same bits on a seam
+                float x = fOriginX + (float)(cx * nCells + i) * fStep;
+                float z = fOriginZ + (float)(cz * nCells + j) * fStep;
+                m.verts.push_back({ x, Height(x, z), z });
+            }
+
+        // two triangles per cell, wound to face up
+        m.idx.reserve((size_t)nCells * nCells * 6);
+        m.tris.reserve((size_t)nCells * nCells * 2);
+        for (int i = 0; i < nCells; i++)
+            for (int j = 0; j < nCells; j++)
+            {
+                int a = i * nSide + j, b = a + 1, c = a + nSide, d = c + 1;
+                for (int v : { a, b, c, c, b, d })
+                    m.idx.push_back(v);
+                m.tris.push_back({ { m.verts[a], m.verts[b], m.verts[c] }, 0 });
+                m.tris.push_back({ { m.verts[c], m.verts[b], m.verts[d] }, 0 });
+            }
+        return m;
+    }
+
+private:
+    int nCells;
+    uint32_t nSeed;
+    float fAmplitude;
+    float fClearance;
+
+    // [0, 1) from a lattice point
+    static float Hash(int x, int z, uint32_t nSeed)
+    {
+        uint32_t h = (uint32_t)x * 0x8DA6B343u ^ (uint32_t)z * 0xD8163841u ^ nSeed * 0xCB1AB31Fu;
+        h ^= h >> 13;
+        h *= 0x5BD1E995u;
+        h ^= h >> 15;
+        return (h >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // the lattice values blended with smoothstep weights
+    static float Noise(float x, float z, uint32_t nSeed)
+    {
+        float fx = floorf(x), fz = floorf(z);
+        int ix = (int)fx, iz = (int)fz;
+        float tx = x - fx, tz = z - fz;
+        tx = tx * tx * (3.0f - 2.0f * tx);
+        tz = tz * tz * (3.0f - 2.0f * tz);
+        float a = Hash(ix, iz, nSeed), b = Hash(ix + 1, iz, nSeed);
+        float c = Hash(ix, iz + 1, nSeed), d = Hash(ix + 1, iz + 1, nSeed);
+        return (a + (b - a) * tx) + ((c + (d - c) * tx) - (a + (b - a) * tx)) * tz;
+    }
+};
+
+// an OBJ terrain cut into chunks. The whole source mesh stays loaded; what is streamed
+// is each chunk's own copy and its levels of detail
+class ObjTerrain : public TerrainSource
+{
+public:
+    // read the OBJ and lower it until its highest point is fClearance below y = 0; false
+    // if it cannot be read
+    bool Load(const char* sPath, float fChunkSize, float fClearance = 10.0f)
+    {
+        source = mesh();
+        if (!source.loadObj(sPath) || source.idx.size() != source.tris.size() * 3)
+            return false;
+        vec3d vMin, vMax;
+        source.bounds(vMin, vMax);
+        for (vec3d& v : source.verts)
+            v.y -= vMax.y + fClearance;
+
+        this->fChunkSize = fChunkSize;
+        fOriginX = vMin.x;
+        fOriginZ = vMin.z;
+        nChunksX = std::max(1, (int)ceilf((vMax.x - vMin.x) / fChunkSize));
+        nChunksZ = std::max(1, (int)ceilf((vMax.z - vMin.z) / fChunkSize));
+        vecChunkTris.assign((size_t)nChunksX * nChunksZ, std::vector<int>());
+        for (size_t t = 0; t < source.tris.size(); t++)
+        {
+            const vec3d* p[3] = { &source.verts[source.idx[t * 3]], &source.verts[source.idx[t * 3 + 1]], &source.verts[source.idx[t * 3 + 2]] };
+            float x = (p[0]->x + p[1]->x + p[2]->x) / 3.0f, z = (p[0]->z + p[1]->z + p[2]->z) / 3.0f;
+            int cx = std::min(nChunksX - 1, std::max(0, (int)((x - fOriginX) / fChunkSize)));
+            int cz = std::min(nChunksZ - 1, std::max(0, (int)((z - fOriginZ) / fChunkSize)));
+            vecChunkTris[(size_t)cz * nChunksX + cx].push_back((int)t);
+        }
+        return true;
+    }
+
+    mesh Build(int cx, int cz) const override
+    {
+        mesh m;
+        std::unordered_map<int, int> remap;
+        for (int t : vecChunkTris[(size_t)cz * nChunksX + cx])
+        {
+            triangle tri = {};
+            for (int k = 0; k < 3; k++)
+            {
+                int v = source.idx[(size_t)t * 3 + k];
+                auto it = remap.find(v);
+                if (it == remap.end())
+                {
+                    it = remap.emplace(v, (int)m.verts.size()).first;
+                    m.verts.push_back(source.verts[v]);
+                }
+                m.idx.push_back(it->second);
+                tri.p[k] = source.verts[v];
+            }
+            m.tris.push_back(tri);
+        }
+        return m;
+    }
+
+private:
+    mesh source;
+    // the source triangles of each chunk
+    std::vector<std::vector<int>> vecChunkTris;
+};
+
+struct terrainSettings
+{
+    // chunks reaching within fRadius of the camera, or of the point fLookAhead along the
+    // view, are wanted; a chunk more than a chunk further out than that is dropped
+    float fRadius = 128.0f;
+    float fLookAhead = 48.0f;
+    // most chunks held at once
+    int nMaxChunks = 256;
+    // levels of detail per chunk (see lodChain), each reordered for the vertex cache
+    // (vcacheOptimize) if bReorder
+    int nLodLevels = 6;
+    bool bReorder = true;
+    // keep the levels packed: 16-bit positions across each chunk's own bounds, so a rim
+    // vertex two chunks share can come out up to a step apart in each
+    bool bPack = false;
+    // wait for every wanted chunk before drawing, so frames do not depend on how fast the
+    // streaming thread happens to be
+    bool bWait = false;
+};
+
+struct terrainStats
+{
+    int nResident = 0;
+    int nResidentMax = 0;
+    // wanted but not built yet, this frame
+    int nMissing = 0;
+    uint64_t nPagedIn = 0;
+    uint64_t nPagedOut = 0;
+    // built, but out of range by the time they arrived
+    uint64_t nDiscarded = 0;
+    // geometry held by resident chunks, all levels, now and at most
+    size_t nBytes = 0;
+    size_t nBytesMax = 0;
+};
+
+class TerrainStreamer
+{
+public:
+    ~TerrainStreamer()
+    {
+        Stop();
+    }
+
+    void Start(std::unique_ptr<TerrainSource> pSource, const terrainSettings& ts)
+    {
+        Stop();
+        source = std::move(pSource);
+        settings = ts;
+        stats = terrainStats();
+        bActive = true;
+        worker = std::thread(&TerrainStreamer::StreamThread, this);
+    }
+
+    // stop the streaming thread; resident chunks stay in the scene
+    void Stop()
+    {
+        if (!bActive)
+            return;
+        {
+            std::unique_lock<std::mutex> lm(mux);
+            bActive = false;
+        }
+        cvWork.notify_one();
+        worker.join();
+        vecQueue.clear();
+        vecDone.clear();
+    }
+
+    bool Active() const { return bActive; }
+    const terrainStats& Stats() const { return stats; }
+    const TerrainSource* Source() const { return source.get(); }
+
+    // once a frame, on the game thread: bring the scene's chunks up to date for a camera
+    // at vCamera looking along vLookDir
+    void Update(Scene& scene, const vec3d& vCamera, const vec3d& vLookDir)
+    {
+        fCamX = vCamera.x;
+        fCamZ = vCamera.z;
+        // the point ahead, along the view as seen from above
+        float fLen = sqrtf(vLookDir.x * vLookDir.x + vLookDir.z * vLookDir.z);
+        fAheadX = fCamX + (fLen > 0.0f ? vLookDir.x / fLen * settings.fLookAhead : 0.0f);
+        fAheadZ = fCamZ + (fLen > 0.0f ? vLookDir.z / fLen * settings.fLookAhead : 0.0f);
+
+        while (true)
+        {
+            Integrate(scene);
+            Plan(scene);
+            if (!settings.bWait || stats.nMissing == 0)
+                break;
+            std::unique_lock<std::mutex> lm(mux);
+            cvDone.wait(lm, [&] { return !vecDone.empty(); });
+        }
+    }
+
+private:
+    struct chunk
+    {
+        // -1 for a chunk with no triangles
+        int nInstance;
+        meshHandle hMesh;
+        size_t nBytes;
+        // the last Plan that wanted it
+        uint64_t nWanted;
+    };
+
+    struct built
+    {
+        uint64_t nKey;
+        std::vector<lodLevel> levels;
+        size_t nBytes;
+    };
+
+    static const uint64_t NONE = ~0ull;
+
+    std::unique_ptr<TerrainSource> source;
+    terrainSettings settings;
+    terrainStats stats;
+    std::unordered_map<uint64_t, chunk> resident;
+    float fCamX = 0.0f, fCamZ = 0.0f, fAheadX = 0.0f, fAheadZ = 0.0f;
+    uint64_t nPlan = 0;
+    // game thread scratch, kept so a frame with nothing to page does not allocate:
+    // (priority, chunk) wanted, best first, and chunks to drop / still to build
+    std::vector<std::pair<float, uint64_t>> vecWanted;
+    std::vector<std::pair<float, uint64_t>> vecSpare;
+    std::vector<uint64_t> vecEvict;
+    std::vector<uint64_t> vecMissing;
+    std::vector<built> vecArrived;
+
+    // shared with the streaming thread, under mux
+    std::mutex mux;
+    std::condition_variable cvWork;
+    std::condition_variable cvDone;
+    // chunks to build, the next one last
+    std::vector<uint64_t> vecQueue;
+    uint64_t nBuilding = NONE;
+    std::vector<built> vecDone;
+    bool bActive = false;
+    std::thread worker;
+
+    static uint64_t Key(int cx, int cz) { return ((uint64_t)(uint32_t)cx << 32) | (uint32_t)cz; }
+    static int KeyX(uint64_t nKey) { return (int)(uint32_t)(nKey >> 32); }
+    static int KeyZ(uint64_t nKey) { return (int)(uint32_t)nKey; }
+
+    // from (x, z) to the nearest point of a chunk, seen from above
+    float Distance(uint64_t nKey, float x, float z) const
+    {
+        float x0 = source->fOriginX + KeyX(nKey) * source->fChunkSize;
+        float z0 = source->fOriginZ + KeyZ(nKey) * source->fChunkSize;
+        float dx = std::max(std::max(x0 - x, x - (x0 + source->fChunkSize)), 0.0f);
+        float dz = std::max(std::max(z0 - z, z - (z0 + source->fChunkSize)), 0.0f);
+        return sqrtf(dx * dx + dz * dz);
+    }
+
+    float Range(uint64_t nKey) const
+    {
+        return std::min(Distance(nKey, fCamX, fCamZ), Distance(nKey, fAheadX, fAheadZ));
+    }
+
+    // the chunks between the camera and the point ahead come first
+    float Priority(uint64_t nKey) const
+    {
+        return Distance(nKey, fCamX, fCamZ) + Distance(nKey, fAheadX, fAheadZ);
+    }
+
+    // add what the streaming thread has finished, if it is still wanted
+    void Integrate(Scene& scene)
+    {
+        {
+            std::unique_lock<std::mutex> lm(mux);
+            std::swap(vecDone, vecArrived);
+        }
+        for (built& b : vecArrived)
+        {
+            if (resident.count(b.nKey) || Range(b.nKey) > settings.fRadius + source->fChunkSize ||
+                (int)resident.size() >= settings.nMaxChunks)
+            {
+                stats.nDiscarded++;
+                continue;
+            }
+            chunk c = { -1, -1, b.nBytes, nPlan };
+            if (b.levels[0].m.Triangles() > 0)
+            {
+                c.hMesh = scene.AddMesh(std::move(b.levels[0].m));
+                scene.SetLods(c.hMesh, std::move(b.levels));
+                mat4x4 matIden;
+                for (int i = 0; i < 4; i++)
+                    matIden.m[i][i] = 1.0f;
+                c.nInstance = scene.AddInstance(c.hMesh, matIden);
+            }
+            resident.emplace(b.nKey, c);
+            stats.nPagedIn++;
+            stats.nBytes += c.nBytes;
+        }
+        vecArrived.clear();
+        stats.nResident = (int)resident.size();
+        stats.nResidentMax = std::max(stats.nResidentMax, stats.nResident);
+        stats.nBytesMax = std::max(stats.nBytesMax, stats.nBytes);
+    }
+
+    // work out which chunks are wanted, drop what is not, and queue what is missing
+    void Plan(Scene& scene)
+    {
+        nPlan++;
+        const TerrainSource& src = *source;
+        float fReach = settings.fRadius;
+        int cx0 = (int)floorf((std::min(fCamX, fAheadX) - fReach - src.fOriginX) / src.fChunkSize);
+        int cx1 = (int)floorf((std::max(fCamX, fAheadX) + fReach - src.fOriginX) / src.fChunkSize);
+        int cz0 = (int)floorf((std::min(fCamZ, fAheadZ) - fReach - src.fOriginZ) / src.fChunkSize);
+        int cz1 = (int)floorf((std::max(fCamZ, fAheadZ) + fReach - src.fOriginZ) / src.fChunkSize);
+        vecWanted.clear();
+        for (int cz = std::max(cz0, 0); cz <= std::min(cz1, src.nChunksZ - 1); cz++)
+            for (int cx = std::max(cx0, 0); cx <= std::min(cx1, src.nChunksX - 1); cx++)
+            {
+                uint64_t nKey = Key(cx, cz);
+                if (Range(nKey) <= fReach)
+                    vecWanted.push_back({ Priority(nKey), nKey });
+            }
+        std::sort(vecWanted.begin(), vecWanted.end());
+        if ((int)vecWanted.size() > settings.nMaxChunks)
+            vecWanted.resize(settings.nMaxChunks);
+
+        vecMissing.clear();
+        for (const auto& w : vecWanted)
+        {
+            auto it = resident.find(w.second);
+            if (it != resident.end())
+                it->second.nWanted = nPlan;
+            else
+                vecMissing.push_back(w.second);
+        }
+
+        // drop chunks out of range, then, if the missing ones would not fit, the unwanted
+        // ones still in range, lowest priority first
+        vecEvict.clear();
+        vecSpare.clear();
+        for (const auto& kv : resident)
+        {
+            if (kv.second.nWanted == nPlan)
+                continue;
+            if (Range(kv.first) > fReach + src.fChunkSize)
+                vecEvict.push_back(kv.first);
+            else
+                vecSpare.push_back({ Priority(kv.first), kv.first });
+        }
+        size_t nKeep = resident.size() - vecEvict.size();
+        if (nKeep + vecMissing.size() > (size_t)settings.nMaxChunks)
+        {
+            std::sort(vecSpare.begin(), vecSpare.end());
+            while (!vecSpare.empty() && nKeep + vecMissing.size() > (size_t)settings.nMaxChunks)
+            {
+                vecEvict.push_back(vecSpare.back().second);
+                vecSpare.pop_back();
+                nKeep--;
+            }
+        }
+        for (uint64_t nKey : vecEvict)
+        {
+            auto it = resident.find(nKey);
+            if (it->second.nInstance >= 0)
+            {
+                scene.RemoveInstance(it->second.nInstance);
+                scene.RemoveMesh(it->second.hMesh);
+            }
+            stats.nBytes -= it->second.nBytes;
+            stats.nPagedOut++;
+            resident.erase(it);
+        }
+        stats.nResident = (int)resident.size();
+        stats.nMissing = (int)vecMissing.size();
+
+        // the thread takes from the back
+        {
+            std::unique_lock<std::mutex> lm(mux);
+            vecQueue.clear();
+            for (auto it = vecMissing.rbegin(); it != vecMissing.rend(); ++it)
+                if (*it != nBuilding)
+                    vecQueue.push_back(*it);
+        }
+        cvWork.notify_one();
+    }
+
+    void StreamThread()
+    {
+        while (true)
+        {
+            uint64_t nKey;
+            {
+                std::unique_lock<std::mutex> lm(mux);
+                cvWork.wait(lm, [&] { return !vecQueue.empty() || !bActive; });
+                if (!bActive)
+                    break;
+                nKey = vecQueue.back();
+                vecQueue.pop_back();
+                nBuilding = nKey;
+            }
+
+            built b;
+            b.nKey = nKey;
+            b.levels = lodChain(source->Build(KeyX(nKey), KeyZ(nKey)), settings.nLodLevels, 0.5f, 32, true);
+            b.nBytes = 0;
+            for (lodLevel& lv : b.levels)
+            {
+                if (settings.bReorder)
+                    vcacheOptimize(lv.m);
+                if (settings.bPack)
+                    lv.m.Pack();
+                b.nBytes += lv.m.Bytes();
+            }
+
+            {
+                std::unique_lock<std::mutex> lm(mux);
+                vecDone.push_back(std::move(b));
+                nBuilding = NONE;
+            }
+            cvDone.notify_one();
+        }
+    }
+};
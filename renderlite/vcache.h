@@ -0,0 +1,183 @@
+// vcache.h : triangle and vertex order of a mesh rearranged for locality, at load time.
+//
+// OBJ files list faces in whatever order the exporter walked them, which for a large
+// terrain jumps all over the vertex list. The renderer assembles every triangle from
+// its three corners in the transformed vertices (see scene.h), so a scattered order
+// turns each corner into a cache miss.
+//
+// vcacheOptimize puts the triangles in the order of Tom Forsyth's "Linear-speed vertex
+// cache optimisation": it models an LRU cache of VCACHE_SIZE vertices and keeps picking
+// the triangle whose corners score best. A corner scores higher the nearer the front of
+// the cache it is (the last triangle's own corners a little less, so strips do not run
+// backwards), and higher the fewer triangles still need it, which finishes off a patch
+// before moving on. It then renumbers the vertices in the order the new triangle list
+// first uses them, so the vertex array is read front to back too. Triangles keep their
+// corners' winding and their positions, only their order and the vertex numbering
+// change.
+//
+// vcacheACMR measures the result as the average cache miss ratio: vertices fetched per
+// triangle through a FIFO cache of a given size, 3 at worst and about 0.5 for a regular
+// grid done well.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include "mesh.h"
+
+// LRU cache vcacheOptimize orders for
+static const int VCACHE_SIZE = 32;
+
+// vertices fetched per triangle by a FIFO cache of nCacheSize vertices
+inline double vcacheACMR(const mesh& m, int nCacheSize = 16)
+{
+    size_t nTris = m.idx.size() / 3;
+    if (nTris == 0)
+        return 0.0;
+    // a vertex is in the cache if it went in less than nCacheSize misses ago
+    std::vector<size_t> vecStamp(m.verts.size(), 0);
+    size_t nMisses = 0;
+    for (int v : m.idx)
+        if (vecStamp[v] == 0 || nMisses - vecStamp[v] >= (size_t)nCacheSize)
+            vecStamp[v] = ++nMisses;
+    return (double)nMisses / (double)nTris;
+}
+
+inline void vcacheOptimize(mesh& m)
+{
+    size_t nTris = m.idx.size() / 3;
+    size_t nVerts = m.verts.size();
+    if (nTris == 0 || m.idx.size() != m.tris.size() * 3)
+        return;
+
+    // the triangles around each vertex, packed one vertex after another
+    std::vector<int> vecFirst(nVerts + 1, 0), vecAround(m.idx.size());
+    for (int v : m.idx)
+        vecFirst[v + 1]++;
+    for (size_t v = 0; v < nVerts; v++)
+        vecFirst[v + 1] += vecFirst[v];
+    {
+        std::vector<int> vecFill(vecFirst.begin(), vecFirst.end() - 1);
+        for (size_t c = 0; c < m.idx.size(); c++)
+            vecAround[vecFill[m.idx[c]]++] = (int)(c / 3);
+    }
+
+    // the scores, from Forsyth
+    auto score = [](int nCachePos, int nLeft)
+        {
+            if (nLeft == 0)
+                return -1.0f;
+            float f = 0.0f;
+            if (nCachePos >= 0)
+                f = nCachePos < 3 ? 0.75f : powf(1.0f - (nCachePos - 3) / (float)(VCACHE_SIZE - 3), 1.5f);
+            return f + 2.0f * powf((float)nLeft, -0.5f);
+        };
+
+    // triangles each vertex still has to go, where it is in the cache (-1 = not), and
+    // its score; each triangle's score is its corners' added up
+    std::vector<int> vecLeft(nVerts), vecCachePos(nVerts, -1);
+    std::vector<float> vecVertScore(nVerts), vecTriScore(nTris, 0.0f);
+    std::vector<bool> vecDone(nTris, false);
+    for (size_t v = 0; v < nVerts; v++)
+    {
+        vecLeft[v] = vecFirst[v + 1] - vecFirst[v];
+        vecVertScore[v] = score(-1, vecLeft[v]);
+    }
+    for (size_t c = 0; c < m.idx.size(); c++)
+        vecTriScore[c / 3] += vecVertScore[m.idx[c]];
+
+    std::vector<int> vecOrder;
+    vecOrder.reserve(nTris);
+    // room for the cache plus the three corners pushed in ahead of it
+    std::vector<int> vecCache, vecNext;
+    vecCache.reserve(VCACHE_SIZE + 3);
+    vecNext.reserve(VCACHE_SIZE + 3);
+    size_t nScan = 0;
+    int nBest = -1;
+    while (vecOrder.size() < nTris)
+    {
+        // nothing near the cache left: start again from the first triangle not done
+        if (nBest < 0)
+        {
+            while (vecDone[nScan])
+                nScan++;
+            nBest = (int)nScan;
+        }
+        vecDone[nBest] = true;
+        vecOrder.push_back(nBest);
+
+        // its corners go to the front of the cache, and need one triangle fewer
+        const int* pCorner = &m.idx[(size_t)nBest * 3];
+        vecNext.assign(pCorner, pCorner + 3);
+        for (int k = 0; k < 3; k++)
+        {
+            int v = pCorner[k];
+            vecLeft[v]--;
+            int* pAround = &vecAround[vecFirst[v]];
+            int* pEnd = pAround + vecLeft[v] + 1;
+            std::swap(*std::find(pAround, pEnd, nBest), pEnd[-1]);
+        }
+        for (int v : vecCache)
+            if (v != pCorner[0] && v != pCorner[1] && v != pCorner[2])
+                vecNext.push_back(v);
+
+        // rescore what is in the cache, and what has just fallen out of it, and the
+        // triangles still around them; the best of those goes next
+        for (size_t i = 0; i < vecNext.size(); i++)
+        {
+            int v = vecNext[i];
+            vecCachePos[v] = i < (size_t)VCACHE_SIZE ? (int)i : -1;
+            float fScore = score(vecCachePos[v], vecLeft[v]);
+            float fDelta = fScore - vecVertScore[v];
+            vecVertScore[v] = fScore;
+            for (int a = vecFirst[v]; a < vecFirst[v] + vecLeft[v]; a++)
+                vecTriScore[vecAround[a]] += fDelta;
+        }
+        float fBest = -1.0f;
+        nBest = -1;
+        for (size_t i = 0; i < vecNext.size() && i < (size_t)VCACHE_SIZE; i++)
+        {
+            int v = vecNext[i];
+            for (int a = vecFirst[v]; a < vecFirst[v] + vecLeft[v]; a++)
+                if (vecTriScore[vecAround[a]] > fBest)
+                {
+                    fBest = vecTriScore[vecAround[a]];
+                    nBest = vecAround[a];
+                }
+        }
+        vecNext.resize(std::min(vecNext.size(), (size_t)VCACHE_SIZE));
+        vecCache.swap(vecNext);
+    }
+
+    // the triangles in their new order, and the vertices in the order they first use them
+    std::vector<int> vecMap(nVerts, -1);
+    std::vector<vec3d> vecVerts;
+    vecVerts.reserve(nVerts);
+    std::vector<int> vecIdx;
+    vecIdx.reserve(m.idx.size());
+    std::vector<triangle> vecTris;
+    vecTris.reserve(nTris);
+    for (int t : vecOrder)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            int& n = vecMap[m.idx[(size_t)t * 3 + k]];
+            if (n < 0)
+            {
+                n = (int)vecVerts.size();
+                vecVerts.push_back(m.verts[m.idx[(size_t)t * 3 + k]]);
+            }
+            vecIdx.push_back(n);
+        }
+        vecTris.push_back(m.tris[t]);
+    }
+    // vertices no triangle uses keep their place at the end
+    for (size_t v = 0; v < nVerts; v++)
+        if (vecMap[v] < 0)
+            vecVerts.push_back(m.verts[v]);
+    m.verts.swap(vecVerts);
+    m.idx.swap(vecIdx);
+    m.tris.swap(vecTris);
+}
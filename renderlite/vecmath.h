@@ -0,0 +1,245 @@
+// vecmath.h : vector and matrix arithmetic on the renderer's vec3d and mat4x4.
+//
+// Free functions that take their arguments by const reference and return the result,
+// so they inline into whatever expression uses them and work on temporaries. Those
+// that need nothing but arithmetic are constexpr, so constant matrices and vectors can
+// be built at compile time. The products a frame does most of, a point through a
+// matrix (matvecMult) and a matrix through a matrix (matrixMult), take a 16-byte row
+// at a time with SSE2 where the compiler targets it; vec3d is four floats, so a point
+// loads as one register. Rotations take the sine and cosine of their angle once each
+// (sinCos), and vectorMulAdd scales a vector and adds it to another in one call.
+//
+// Every function gives the same bits as the member functions olcEngine3D had before
+// it: the SSE2 paths add the rows' products in the same order as the scalar ones, and
+// nothing is fused into FMA, which rounds once where the scalar code rounds twice.
+// Vector arithmetic on x, y and z leaves w at 1, as it always did.
+
+#pragma once
+
+#include <cmath>
+#include "mesh.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VECMATH_SSE2
+#endif
+
+constexpr vec3d vectorAdd(const vec3d& v1, const vec3d& v2)
+{
+    return { v1.x + v2.x, v1.y + v2.y, v1.z + v2.z };
+}
+
+constexpr vec3d vectorSub(const vec3d& v1, const vec3d& v2)
+{
+    return { v1.x - v2.x, v1.y - v2.y, v1.z - v2.z };
+}
+
+constexpr vec3d vectorMul(const vec3d& v, float k)
+{
+    return { v.x * k, v.y * k, v.z * k };
+}
+
+constexpr vec3d vectorDiv(const vec3d& v, float k)
+{
+    return { v.x / k, v.y / k, v.z / k };
+}
+
+// v1 + v2 * k
+constexpr vec3d vectorMulAdd(const vec3d& v1, const vec3d& v2, float k)
+{
+    return { v1.x + v2.x * k, v1.y + v2.y * k, v1.z + v2.z * k };
+}
+
+constexpr float vectorDot(const vec3d& v1, const vec3d& v2)
+{
+    return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z;
+}
+
+constexpr vec3d vectorCross(const vec3d& v1, const vec3d& v2)
+{
+    return { v1.y * v2.z - v1.z * v2.y, v1.z * v2.x - v1.x * v2.z, v1.x * v2.y - v1.y * v2.x };
+}
+
+inline float vectorLen(const vec3d& v)
+{
+    return sqrtf(vectorDot(v, v));
+}
+
+inline vec3d vectorNorm(const vec3d& v)
+{
+    float len = vectorLen(v);
+    return { v.x / len, v.y / len, v.z / len };
+}
+
+// point where the line from lineStart to lineEnd meets the plane through planePoint
+// with normal planeNormal
+inline vec3d vectorIntersectPlane(const vec3d& planePoint, const vec3d& planeNormal, const vec3d& lineStart, const vec3d& lineEnd)
+{
+    vec3d n = vectorNorm(planeNormal);
+    float planeD = -vectorDot(n, planePoint);
+    float ad = vectorDot(lineStart, n);
+    float bd = vectorDot(lineEnd, n);
+    float tt = (-planeD - ad) / (bd - ad);
+    return vectorMulAdd(lineStart, vectorSub(lineEnd, lineStart), tt);
+}
+
+// sine and cosine of one angle
+inline void sinCos(float fAngleRad, float& s, float& c)
+{
+    s = sinf(fAngleRad);
+    c = cosf(fAngleRad);
+}
+
+constexpr mat4x4 matrixIden()
+{
+    mat4x4 matrix;
+    matrix.m[0][0] = 1.0f;
+    matrix.m[1][1] = 1.0f;
+    matrix.m[2][2] = 1.0f;
+    matrix.m[3][3] = 1.0f;
+    return matrix;
+}
+
+inline mat4x4 matrixRotX(float fAngleRad)
+{
+    float s, c;
+    sinCos(fAngleRad, s, c);
+    mat4x4 matrix;
+    matrix.m[0][0] = 1.0f;
+    matrix.m[1][1] = c;
+    matrix.m[1][2] = s;
+    matrix.m[2][1] = -s;
+    matrix.m[2][2] = c;
+    matrix.m[3][3] = 1.0f;
+    return matrix;
+}
+
+inline mat4x4 matrixRotY(float fAngleRad)
+{
+    float s, c;
+    sinCos(fAngleRad, s, c);
+    mat4x4 matrix;
+    matrix.m[0][0] = c;
+    matrix.m[0][2] = s;
+    matrix.m[2][0] = -s;
+    matrix.m[1][1] = 1.0f;
+    matrix.m[2][2] = c;
+    matrix.m[3][3] = 1.0f;
+    return matrix;
+}
+
+inline mat4x4 matrixRotZ(float fAngleRad)
+{
+    float s, c;
+    sinCos(fAngleRad, s, c);
+    mat4x4 matrix;
+    matrix.m[0][0] = c;
+    matrix.m[0][1] = s;
+    matrix.m[1][0] = -s;
+    matrix.m[1][1] = c;
+    matrix.m[2][2] = 1.0f;
+    matrix.m[3][3] = 1.0f;
+    return matrix;
+}
+
+constexpr mat4x4 matrixTrans(float x, float y, float z)
+{
+    mat4x4 matrix = matrixIden();
+    matrix.m[3][0] = x;
+    matrix.m[3][1] = y;
+    matrix.m[3][2] = z;
+    return matrix;
+}
+
+// projection of view space onto the screen: [x, y, z, 1] goes to
+// [a * f * x, f * y, q * (z - z_near), z], with a the aspect ratio (height / width),
+// f = 1 / tan(fov / 2) and q = z_far / (z_far - z_near), for dividing through by w
+// (https://www.youtube.com/watch?v=ih20l3pJoeU&list=PLrOv9FMX8xJE8NgepZR1etrsU63fDDGxO&index=24&ab_channel=javidx9&t=1067)
+inline mat4x4 matrixProj(float fFovDeg, float fAspectRatio, float fNear, float fFar)
+{
+    float fFovRad = 1.0f / tanf(fFovDeg * 0.5f / 180.0f * 3.14159f);
+    mat4x4 matrix;
+    matrix.m[0][0] = fAspectRatio * fFovRad;
+    matrix.m[1][1] = fFovRad;
+    matrix.m[2][2] = fFar / (fFar - fNear);
+    matrix.m[3][2] = (-fFar * fNear) / (fFar - fNear);
+    matrix.m[2][3] = 1.0f;
+    matrix.m[3][3] = 0.0f;
+    return matrix;
+}
+
+// i * m, with i taken as a row vector, w included
+inline vec3d matvecMult(const mat4x4& m, const vec3d& i)
+{
+    vec3d v;
+#ifdef VECMATH_SSE2
+    __m128 p = _mm_loadu_ps(&i.x);
+    __m128 r = _mm_mul_ps(_mm_shuffle_ps(p, p, _MM_SHUFFLE(0, 0, 0, 0)), _mm_loadu_ps(m.m[0]));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1)), _mm_loadu_ps(m.m[1])));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2)), _mm_loadu_ps(m.m[2])));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 3, 3)), _mm_loadu_ps(m.m[3])));
+    _mm_storeu_ps(&v.x, r);
+#else
+    v.x = i.x * m.m[0][0] + i.y * m.m[1][0] + i.z * m.m[2][0] + i.w * m.m[3][0];
+    v.y = i.x * m.m[0][1] + i.y * m.m[1][1] + i.z * m.m[2][1] + i.w * m.m[3][1];
+    v.z = i.x * m.m[0][2] + i.y * m.m[1][2] + i.z * m.m[2][2] + i.w * m.m[3][2];
+    v.w = i.x * m.m[0][3] + i.y * m.m[1][3] + i.z * m.m[2][3] + i.w * m.m[3][3];
+#endif
+    return v;
+}
+
+// m1 then m2: each row of m1 through m2
+inline mat4x4 matrixMult(const mat4x4& m1, const mat4x4& m2)
+{
+    mat4x4 matrix;
+#ifdef VECMATH_SSE2
+    __m128 b0 = _mm_loadu_ps(m2.m[0]);
+    __m128 b1 = _mm_loadu_ps(m2.m[1]);
+    __m128 b2 = _mm_loadu_ps(m2.m[2]);
+    __m128 b3 = _mm_loadu_ps(m2.m[3]);
+    for (int r = 0; r < 4; r++)
+    {
+        __m128 v = _mm_mul_ps(_mm_set1_ps(m1.m[r][0]), b0);
+        v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(m1.m[r][1]), b1));
+        v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(m1.m[r][2]), b2));
+        v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(m1.m[r][3]), b3));
+        _mm_storeu_ps(matrix.m[r], v);
+    }
+#else
+    for (int c = 0; c < 4; c++)
+        for (int r = 0; r < 4; r++)
+            matrix.m[r][c] = m1.m[r][0] * m2.m[0][c] + m1.m[r][1] * m2.m[1][c] + m1.m[r][2] * m2.m[2][c] + m1.m[r][3] * m2.m[3][c];
+#endif
+    return matrix;
+}
+
+// rotation and translation that put an object at pos, facing target, with up as near
+// its up as it can be
+inline mat4x4 matrixPointAt(const vec3d& pos, const vec3d& target, const vec3d& up)
+{
+    // new forward direction (z), up (y) with the part along forward taken out, and right (x)
+    vec3d newForward = vectorNorm(vectorSub(target, pos));
+    vec3d newUp = vectorNorm(vectorSub(up, vectorMul(newForward, vectorDot(up, newForward))));
+    vec3d newRight = vectorCross(newUp, newForward);
+
+    mat4x4 matrix;
+    matrix.m[0][0] = newRight.x;    matrix.m[0][1] = newRight.y;    matrix.m[0][2] = newRight.z;    matrix.m[0][3] = 0.0f;
+    matrix.m[1][0] = newUp.x;       matrix.m[1][1] = newUp.y;       matrix.m[1][2] = newUp.z;       matrix.m[1][3] = 0.0f;
+    matrix.m[2][0] = newForward.x;  matrix.m[2][1] = newForward.y;  matrix.m[2][2] = newForward.z;  matrix.m[2][3] = 0.0f;
+    matrix.m[3][0] = pos.x;         matrix.m[3][1] = pos.y;         matrix.m[3][2] = pos.z;         matrix.m[3][3] = 1.0f;
+    return matrix;
+}
+
+// inverse of a rotation and translation, such as matrixPointAt makes (not of any matrix)
+constexpr mat4x4 matrixInv(const mat4x4& m)
+{
+    mat4x4 matrix;
+    matrix.m[0][0] = m.m[0][0]; matrix.m[0][1] = m.m[1][0]; matrix.m[0][2] = m.m[2][0]; matrix.m[0][3] = 0.0f;
+    matrix.m[1][0] = m.m[0][1]; matrix.m[1][1] = m.m[1][1]; matrix.m[1][2] = m.m[2][1]; matrix.m[1][3] = 0.0f;
+    matrix.m[2][0] = m.m[0][2]; matrix.m[2][1] = m.m[1][2]; matrix.m[2][2] = m.m[2][2]; matrix.m[2][3] = 0.0f;
+    matrix.m[3][0] = -(m.m[3][0] * matrix.m[0][0] + m.m[3][1] * matrix.m[1][0] + m.m[3][2] * matrix.m[2][0]);
+    matrix.m[3][1] = -(m.m[3][0] * matrix.m[0][1] + m.m[3][1] * matrix.m[1][1] + m.m[3][2] * matrix.m[2][1]);
+    matrix.m[3][2] = -(m.m[3][0] * matrix.m[0][2] + m.m[3][1] * matrix.m[1][2] + m.m[3][2] * matrix.m[2][2]);
+    matrix.m[3][3] = 1.0f;
+    return matrix;
+}
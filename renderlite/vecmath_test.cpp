@@ -0,0 +1,459 @@
+// vecmath_test.cpp : checks vecmath.h bit for bit against the functions it replaced.
+//
+// legacyMath below holds the vector and matrix member functions olcEngine3D had before
+// vecmath.h, copied unchanged (non-const references and all). Every vecmath.h function
+// is run next to its old counterpart on the same random inputs, from a fixed seed so a
+// failure can be replayed, and the results compared as bits: the library promises the
+// same rounding, not just results that are close. Inputs span several orders of
+// magnitude and signs; results that are NaN on both sides count as equal.
+//
+//   g++ -std=c++17 -O2 vecmath_test.cpp -o vecmath_test
+//
+//   vecmath_test [--cases N] [--seed S]
+//
+// Build it with the flags the renderer is built with: under -ffast-math or FMA
+// contraction (-ffp-contract=fast) the two sides may round differently. The exit code
+// is 1 if any result differs.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include "vecmath.h"
+
+// olcEngine3D's helpers as they were
+struct legacyMath
+{
+    vec3d vectorAdd(vec3d& v1, vec3d& v2)
+    {
+        return { v1.x + v2.x, v1.y + v2.y, v1.z + v2.z };
+    }
+
+    vec3d vectorSub(vec3d& v1, vec3d& v2)
+    {
+        return { v1.x - v2.x, v1.y - v2.y, v1.z - v2.z };
+    }
+
+    vec3d vectorMul(vec3d& v, float k)
+    {
+        return { v.x * k, v.y * k, v.z * k };
+    }
+
+    vec3d vectorDiv(vec3d& v, float k)
+    {
+        return { v.x / k, v.y / k, v.z / k };
+    }
+
+    float vectorDot(vec3d& v1, vec3d& v2)
+    {
+        return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z;
+    }
+
+    vec3d vectorCross(vec3d& v1, vec3d& v2)
+    {
+        vec3d v;
+
+        v.x = v1.y * v2.z - v1.z * v2.y;
+        v.y = v1.z * v2.x - v1.x * v2.z;
+        v.z = v1.x * v2.y - v1.y * v2.x;
+
+        return v;
+    }
+
+    float vectorLen(vec3d& v)
+    {
+        return sqrtf(vectorDot(v, v));
+    }
+
+    vec3d vectorNorm(vec3d& v)
+    {
+        float len = vectorLen(v);
+
+        return { v.x / len, v.y / len, v.z / len };
+    }
+
+    vec3d vectorIntersectPlane(vec3d& planePoint, vec3d& planeNormal, vec3d& lineStart, vec3d& lineEnd)
+    {
+        planeNormal = vectorNorm(planeNormal);
+
+        float planeD = -vectorDot(planeNormal, planePoint);
+        float ad = vectorDot(lineStart, planeNormal);
+        float bd = vectorDot(lineEnd, planeNormal);
+        float tt = (-planeD - ad) / (bd - ad);
+
+        vec3d lineStartToEnd = vectorSub(lineEnd, lineStart);
+        vec3d lineToIntersect = vectorMul(lineStartToEnd, tt);
+
+        return vectorAdd(lineStart, lineToIntersect);
+    }
+
+    mat4x4 matrixIden()
+    {
+        mat4x4 matrix;
+
+        matrix.m[0][0] = 1.0f;
+        matrix.m[1][1] = 1.0f;
+        matrix.m[2][2] = 1.0f;
+        matrix.m[3][3] = 1.0f;
+
+        return matrix;
+    }
+
+    mat4x4 matrixRotX(float fAngleRad)
+    {
+        mat4x4 matrix;
+
+        matrix.m[0][0] = 1.0f;
+        matrix.m[1][1] = cosf(fAngleRad);
+        matrix.m[1][2] = sinf(fAngleRad);
+        matrix.m[2][1] = -sinf(fAngleRad);
+        matrix.m[2][2] = cosf(fAngleRad);
+        matrix.m[3][3] = 1.0f;
+
+        return matrix;
+    }
+
+    mat4x4 matrixRotY(float fAngleRad)
+    {
+        mat4x4 matrix;
+
+        matrix.m[0][0] = cosf(fAngleRad);
+        matrix.m[0][2] = sinf(fAngleRad);
+        matrix.m[2][0] = -sinf(fAngleRad);
+        matrix.m[1][1] = 1.0f;
+        matrix.m[2][2] = cosf(fAngleRad);
+        matrix.m[3][3] = 1.0f;
+
+        return matrix;
+    }
+
+    mat4x4 matrixRotZ(float fAngleRad)
+    {
+        mat4x4 matrix;
+
+        matrix.m[0][0] = cosf(fAngleRad);
+        matrix.m[0][1] = sinf(fAngleRad);
+        matrix.m[1][0] = -sinf(fAngleRad);
+        matrix.m[1][1] = cosf(fAngleRad);
+        matrix.m[2][2] = 1.0f;
+        matrix.m[3][3] = 1.0f;
+
+        return matrix;
+    }
+
+    mat4x4 matrixTrans(float x, float y, float z)
+    {
+        mat4x4 matrix;
+
+        matrix.m[0][0] = 1.0f;
+        matrix.m[1][1] = 1.0f;
+        matrix.m[2][2] = 1.0f;
+        matrix.m[3][3] = 1.0f;
+        matrix.m[3][0] = x;
+        matrix.m[3][1] = y;
+        matrix.m[3][2] = z;
+
+        return matrix;
+    }
+
+    mat4x4 matrixProj(float fFovDeg, float fAspectRatio, float fNear, float fFar)
+    {
+        float fFovRad = 1.0f / tanf(fFovDeg * 0.5f / 180.0f * 3.14159f);
+
+        mat4x4 matrix;
+
+        matrix.m[0][0] = fAspectRatio * fFovRad;
+        matrix.m[1][1] = fFovRad;
+        matrix.m[2][2] = fFar / (fFar - fNear);
+        matrix.m[3][2] = (-fFar * fNear) / (fFar - fNear);
+        matrix.m[2][3] = 1.0f;
+        matrix.m[3][3] = 0.0f;
+
+        return matrix;
+    }
+
+    vec3d matvecMult(mat4x4& m, vec3d &i)
+    {
+        vec3d v;
+
+        v.x = i.x * m.m[0][0] + i.y * m.m[1][0] + i.z * m.m[2][0] + i.w * m.m[3][0];
+        v.y = i.x * m.m[0][1] + i.y * m.m[1][1] + i.z * m.m[2][1] + i.w * m.m[3][1];
+        v.z = i.x * m.m[0][2] + i.y * m.m[1][2] + i.z * m.m[2][2] + i.w * m.m[3][2];
+        v.w = i.x * m.m[0][3] + i.y * m.m[1][3] + i.z * m.m[2][3] + i.w * m.m[3][3];
+
+        return v;
+    }
+
+    mat4x4 matrixMult(mat4x4& m1, mat4x4& m2)
+    {
+        mat4x4 matrix;
+
+        for (int c = 0; c < 4; c++)
+            for (int r = 0; r < 4; r++)
+                matrix.m[r][c] = m1.m[r][0] * m2.m[0][c] + m1.m[r][1] * m2.m[1][c] + m1.m[r][2] * m2.m[2][c] + m1.m[r][3] * m2.m[3][c];
+
+        return matrix;
+    }
+
+    mat4x4 matrixPointAt(vec3d& pos, vec3d& target, vec3d& up)
+    {
+        vec3d newForward = vectorSub(target, pos);
+        newForward = vectorNorm(newForward);
+
+        vec3d overlap = vectorMul(newForward, vectorDot(up, newForward));
+        vec3d newUp = vectorSub(up, overlap);
+        newUp = vectorNorm(newUp);
+
+        vec3d newRight = vectorCross(newUp, newForward);
+
+        mat4x4 matrix;
+
+        matrix.m[0][0] = newRight.x;	matrix.m[0][1] = newRight.y;	matrix.m[0][2] = newRight.z;	matrix.m[0][3] = 0.0f;
+        matrix.m[1][0] = newUp.x;		matrix.m[1][1] = newUp.y;		matrix.m[1][2] = newUp.z;		matrix.m[1][3] = 0.0f;
+        matrix.m[2][0] = newForward.x;	matrix.m[2][1] = newForward.y;	matrix.m[2][2] = newForward.z;	matrix.m[2][3] = 0.0f;
+        matrix.m[3][0] = pos.x;			matrix.m[3][1] = pos.y;			matrix.m[3][2] = pos.z;			matrix.m[3][3] = 1.0f;
+
+        return matrix;
+    }
+
+    mat4x4 matrixInv(mat4x4 & m)
+    {
+            mat4x4 matrix;
+
+            matrix.m[0][0] = m.m[0][0]; matrix.m[0][1] = m.m[1][0]; matrix.m[0][2] = m.m[2][0]; matrix.m[0][3] = 0.0f;
+            matrix.m[1][0] = m.m[0][1]; matrix.m[1][1] = m.m[1][1]; matrix.m[1][2] = m.m[2][1]; matrix.m[1][3] = 0.0f;
+            matrix.m[2][0] = m.m[0][2]; matrix.m[2][1] = m.m[1][2]; matrix.m[2][2] = m.m[2][2]; matrix.m[2][3] = 0.0f;
+            matrix.m[3][0] = -(m.m[3][0] * matrix.m[0][0] + m.m[3][1] * matrix.m[1][0] + m.m[3][2] * matrix.m[2][0]);
+            matrix.m[3][1] = -(m.m[3][0] * matrix.m[0][1] + m.m[3][1] * matrix.m[1][1] + m.m[3][2] * matrix.m[2][1]);
+            matrix.m[3][2] = -(m.m[3][0] * matrix.m[0][2] + m.m[3][1] * matrix.m[1][2] + m.m[3][2] * matrix.m[2][2]);
+            matrix.m[3][3] = 1.0f;
+
+            return matrix;
+    }
+};
+
+
+static uint64_t nState;
+
+static uint32_t next32()
+{
+    // xorshift64*
+    nState ^= nState >> 12;
+    nState ^= nState << 25;
+    nState ^= nState >> 27;
+    return (uint32_t)((nState * 2685821657736338717ull) >> 32);
+}
+
+// in [lo, hi)
+static float uniform(float lo, float hi)
+{
+    return lo + (hi - lo) * (float)(next32() >> 8) / 16777216.0f;
+}
+
+// either sign, magnitudes from 1e-3 to 1e3
+static float anyFloat()
+{
+    static const float scale[] = { 1e-3f, 1e-2f, 0.1f, 1.0f, 10.0f, 100.0f, 1e3f };
+    return uniform(-1.0f, 1.0f) * scale[next32() % 7];
+}
+
+static vec3d anyVec()
+{
+    vec3d v;
+    v.x = anyFloat();
+    v.y = anyFloat();
+    v.z = anyFloat();
+    // w is 1 for points, anything after a projection
+    v.w = next32() % 4 == 0 ? anyFloat() : 1.0f;
+    return v;
+}
+
+static mat4x4 anyMat()
+{
+    mat4x4 m;
+    for (int r = 0; r < 4; r++)
+        for (int c = 0; c < 4; c++)
+            m.m[r][c] = anyFloat();
+    return m;
+}
+
+static bool sameFloats(const float* a, const float* b, int n)
+{
+    for (int i = 0; i < n; i++)
+        if (memcmp(&a[i], &b[i], sizeof(float)) != 0 && !(std::isnan(a[i]) && std::isnan(b[i])))
+            return false;
+    return true;
+}
+
+static bool same(float a, float b) { return sameFloats(&a, &b, 1); }
+static bool same(const vec3d& a, const vec3d& b) { return sameFloats(&a.x, &b.x, 4); }
+static bool same(const mat4x4& a, const mat4x4& b) { return sameFloats(&a.m[0][0], &b.m[0][0], 16); }
+
+struct checkCount
+{
+    const char* sName;
+    uint64_t nCases = 0;
+    uint64_t nDiffer = 0;
+};
+
+int main(int argc, char** argv)
+{
+    uint64_t nCases = 200000;
+    uint64_t nSeed = 0x5eed;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--cases") == 0 && i + 1 < argc) nCases = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) nSeed = strtoull(argv[++i], nullptr, 0);
+        else
+        {
+            fprintf(stderr, "usage: %s [--cases N] [--seed S]\n", argv[0]);
+            return 2;
+        }
+    }
+    nState = nSeed ? nSeed : 1;
+
+    legacyMath old;
+    std::vector<checkCount> checks;
+    auto check = [&](const char* sName, bool bSame)
+    {
+        if (checks.empty() || strcmp(checks.back().sName, sName) != 0)
+            checks.push_back({ sName });
+        checks.back().nCases++;
+        if (!bSame && checks.back().nDiffer++ == 0)
+            printf("FAIL  %s differs first at case %llu (seed 0x%llx)\n", sName,
+                (unsigned long long)checks.back().nCases - 1, (unsigned long long)nSeed);
+    };
+
+    for (uint64_t n = 0; n < nCases; n++)
+    {
+        vec3d a = anyVec(), b = anyVec();
+        check("vectorAdd", same(vectorAdd(a, b), old.vectorAdd(a, b)));
+    }
+    for (uint64_t n = 0; n < nCases; n++)
+    {
+        vec3d a = anyVec(), b = anyVec();
+        check("vectorSub", same(vectorSub(a, b), old.vectorSub(a, b)));
+    }
+    for (uint64_t n = 0; n < nCases; n++)
+    {
+        vec3d a = anyVec();
+        float k = anyFloat();
+        check("vectorMul", same(vectorMul(a, k), old.vectorMul(a, k)));
+    }
+    for (uint64_t n = 0; n < nCases; n++)
+    {
+        vec3d a = anyVec();
+        float k = anyFloat();
+        check("vectorDiv", same(vectorDiv(a, k), old.vectorDiv(a, k)));
+    }
+    for (uint64_t n = 0; n < nCases; n++)
+    {
+        // the old code's multiply then add
+        vec3d a = anyVec(), b = anyVec();
+        float k = anyFloat();
+        vec3d ab = old.vectorMul(b, k);
+        check("vectorMulAdd", same(vectorMulAdd(a, b, k), old.vectorAdd(a, ab)));
+    }
+    for (uint64_t n = 0; n < nCases; n++)
+    {
+        vec3d a = anyVec(), b = anyVec();
+        check("vectorDot", same(vectorDot(a, b), old.vectorDot(a, b)));
+    }
+    for (uint64_t n = 0; n < nCases; n++)
+    {
+        vec3d a = anyVec(), b = anyVec();
+        check("vectorCross", same(vectorCross(a, b), old.vectorCross(a, b)));
+    }
+    for (uint64_t n = 0; n < nCases; n++)
+    {
+        vec3d a = anyVec();
+        check("vectorLen", same(vectorLen(a), old.vectorLen(a)));
+    }
+    for (uint64_t n = 0; n < nCases; n++)
+    {
+        vec3d a = anyVec();
+        check("vectorNorm", same(vectorNorm(a), old.vectorNorm(a)));
+    }
+    for (uint64_t n = 0; n < nCases; n++)
+    {
+        // the old one normalised the caller's normal in place, so it gets a copy
+        vec3d point = anyVec(), normal = anyVec(), start = anyVec(), end = anyVec();
+        vec3d normalOld = normal;
+        check("vectorIntersectPlane", same(vectorIntersectPlane(point, normal, start, end),
+            old.vectorIntersectPlane(point, normalOld, start, end)));
+    }
+    check("matrixIden", same(matrixIden(), old.matrixIden()));
+    for (uint64_t n = 0; n < nCases; n++)
+    {
+        float fAngle = uniform(-20.0f, 20.0f);
+        check("matrixRotX", same(matrixRotX(fAngle), old.matrixRotX(fAngle)));
+    }
+    for (uint64_t n = 0; n < nCases; n++)
+    {
+        float fAngle = uniform(-20.0f, 20.0f);
+        check("matrixRotY", same(matrixRotY(fAngle), old.matrixRotY(fAngle)));
+    }
+    for (uint64_t n = 0; n < nCases; n++)
+    {
+        float fAngle = uniform(-20.0f, 20.0f);
+        check("matrixRotZ", same(matrixRotZ(fAngle), old.matrixRotZ(fAngle)));
+    }
+    for (uint64_t n = 0; n < nCases; n++)
+    {
+        float x = anyFloat(), y = anyFloat(), z = anyFloat();
+        check("matrixTrans", same(matrixTrans(x, y, z), old.matrixTrans(x, y, z)));
+    }
+    for (uint64_t n = 0; n < nCases; n++)
+    {
+        float fFov = uniform(10.0f, 170.0f), fAspect = uniform(0.2f, 3.0f);
+        float fNear = uniform(0.01f, 1.0f), fFar = fNear + uniform(1.0f, 1000.0f);
+        check("matrixProj", same(matrixProj(fFov, fAspect, fNear, fFar), old.matrixProj(fFov, fAspect, fNear, fFar)));
+    }
+    for (uint64_t n = 0; n < nCases; n++)
+    {
+        mat4x4 m = anyMat();
+        vec3d v = anyVec();
+        check("matvecMult", same(matvecMult(m, v), old.matvecMult(m, v)));
+    }
+    for (uint64_t n = 0; n < nCases; n++)
+    {
+        mat4x4 m1 = anyMat(), m2 = anyMat();
+        check("matrixMult", same(matrixMult(m1, m2), old.matrixMult(m1, m2)));
+    }
+    for (uint64_t n = 0; n < nCases; n++)
+    {
+        vec3d pos = anyVec(), target = anyVec(), up = anyVec();
+        check("matrixPointAt", same(matrixPointAt(pos, target, up), old.matrixPointAt(pos, target, up)));
+    }
+    for (uint64_t n = 0; n < nCases; n++)
+    {
+        // a camera matrix, what the renderer inverts, and arbitrary ones
+        mat4x4 m;
+        if (n & 1)
+            m = anyMat();
+        else
+        {
+            vec3d pos = anyVec(), target = anyVec(), up = anyVec();
+            m = matrixPointAt(pos, target, up);
+        }
+        check("matrixInv", same(matrixInv(m), old.matrixInv(m)));
+    }
+
+    uint64_t nTotal = 0, nDiffer = 0;
+    for (const checkCount& c : checks)
+    {
+        printf("%-22s %10llu cases  %llu differ\n", c.sName, (unsigned long long)c.nCases, (unsigned long long)c.nDiffer);
+        nTotal += c.nCases;
+        nDiffer += c.nDiffer;
+    }
+#ifdef VECMATH_SSE2
+    const char* sPath = "SSE2";
+#else
+    const char* sPath = "scalar";
+#endif
+    printf("vecmath_test: %llu cases (%s), %llu differ: %s\n", (unsigned long long)nTotal, sPath,
+        (unsigned long long)nDiffer, nDiffer ? "FAILED" : "passed");
+    return nDiffer ? 1 : 0;
+}